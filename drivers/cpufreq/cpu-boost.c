@@ -16,11 +16,17 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/notifier.h>
+#include <linux/cpu.h>
 #include <linux/cpufreq.h>
 #include <linux/sched.h>
 #include <linux/jiffies.h>
 #include <linux/kthread.h>
 #include <linux/moduleparam.h>
+#include <linux/input.h>
+#include <linux/slab.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpu_boost.h>
 
 struct cpu_sync {
 	struct task_struct *thread;
@@ -41,6 +47,51 @@ module_param(boost_ms, uint, 0664);
 
 static unsigned int sync_threshold;
 module_param(sync_threshold, uint, 0664);
+
+/*
+ * Event driven boosts.  Each client has its own frequency and duration,
+ * a client with either set to zero is disabled.  A kick while the
+ * client is boosted only extends the boost.
+ */
+struct boost_client {
+	const char *name;
+	unsigned int freq;
+	unsigned int ms;
+	unsigned long expires;
+	bool active;
+};
+
+static struct boost_client boost_clients[CPU_BOOST_CLIENTS] = {
+	[CPU_BOOST_INPUT]	= { .name = "input" },
+	[CPU_BOOST_BINDER]	= { .name = "binder" },
+	[CPU_BOOST_FORK]	= { .name = "fork" },
+	[CPU_BOOST_EXEC]	= { .name = "exec" },
+	[CPU_BOOST_USER]	= { .name = "user" },
+};
+
+#define boost_client_param(_name, _client)				\
+	module_param_named(_name##_boost_freq,				\
+			   boost_clients[_client].freq, uint, 0664);	\
+	module_param_named(_name##_boost_ms,				\
+			   boost_clients[_client].ms, uint, 0664)
+
+boost_client_param(input, CPU_BOOST_INPUT);
+boost_client_param(binder, CPU_BOOST_BINDER);
+boost_client_param(fork, CPU_BOOST_FORK);
+boost_client_param(exec, CPU_BOOST_EXEC);
+boost_client_param(user, CPU_BOOST_USER);
+
+/* protects the client state */
+static DEFINE_SPINLOCK(boost_lock);
+/* serializes the policy updates */
+static DEFINE_MUTEX(boost_update_mutex);
+/* highest frequency among the boosted clients */
+static unsigned int boost_freq;
+static struct work_struct boost_start_work;
+static struct delayed_work boost_end_work;
+
+static ATOMIC_NOTIFIER_HEAD(cpu_boost_notifier_list);
+
 /*
  * The CPUFREQ_ADJUST notifier is used to override the current policy min to
  * make sure policy min >= boost_min. The cpufreq framework then does the job
@@ -51,15 +102,17 @@ static int boost_adjust_notify(struct notifier_block *nb, unsigned long val, voi
 	struct cpufreq_policy *policy = data;
 	unsigned int cpu = policy->cpu;
 	struct cpu_sync *s = &per_cpu(sync_info, cpu);
-	unsigned int min = s->boost_min;
+	unsigned int floor = max(s->boost_min, boost_freq);
 
 	if (val != CPUFREQ_ADJUST)
 		return NOTIFY_OK;
 
-	if (min == 0)
+	if (floor == 0)
 		return NOTIFY_OK;
 
-	cpufreq_verify_within_limits(policy, min, UINT_MAX);
+	/* A boost must not lift the thermal or user imposed maximum */
+	floor = min(floor, policy->max);
+	cpufreq_verify_within_limits(policy, floor, UINT_MAX);
 
 	return NOTIFY_OK;
 }
@@ -152,6 +205,190 @@ static struct notifier_block boost_migration_nb = {
 	.notifier_call = boost_migration_notify,
 };
 
+/*
+ * Expire the clients whose boost ran out and bring the policies in line
+ * with what the remaining ones ask for.
+ */
+static void boost_update(void)
+{
+	unsigned long now = jiffies, next = 0, flags;
+	unsigned int freq = 0;
+	bool pending = false;
+	int i, cpu;
+
+	mutex_lock(&boost_update_mutex);
+
+	spin_lock_irqsave(&boost_lock, flags);
+	for (i = 0; i < CPU_BOOST_CLIENTS; i++) {
+		struct boost_client *c = &boost_clients[i];
+
+		if (!c->active)
+			continue;
+		if (!time_before(now, c->expires)) {
+			c->active = false;
+			trace_cpu_unboost(c->name);
+			continue;
+		}
+		freq = max(freq, c->freq);
+		if (!pending || time_before(c->expires, next))
+			next = c->expires;
+		pending = true;
+	}
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	if (freq != boost_freq) {
+		boost_freq = freq;
+		trace_cpu_boost_floor(freq);
+		get_online_cpus();
+		for_each_online_cpu(cpu)
+			cpufreq_update_policy(cpu);
+		put_online_cpus();
+	}
+
+	if (pending)
+		queue_delayed_work(boost_rem_wq, &boost_end_work, next - now);
+
+	mutex_unlock(&boost_update_mutex);
+}
+
+static void do_boost_start(struct work_struct *work)
+{
+	/* a new client may expire before the one the work waits for */
+	cancel_delayed_work_sync(&boost_end_work);
+	boost_update();
+}
+
+static void do_boost_end(struct work_struct *work)
+{
+	boost_update();
+}
+
+/**
+ * cpu_boost_kick - report a latency sensitive event
+ * @client: the kind of event
+ *
+ * Boosts the policy minimum to the client's boost frequency for the
+ * client's boost duration and tells the registered notifiers.  Callable
+ * from any context.
+ */
+void cpu_boost_kick(enum cpu_boost_client client)
+{
+	struct boost_client *c = &boost_clients[client];
+	unsigned long expires, flags;
+	bool start;
+
+	atomic_notifier_call_chain(&cpu_boost_notifier_list, client, NULL);
+
+	if (!c->freq || !c->ms || !boost_rem_wq)
+		return;
+
+	expires = jiffies + msecs_to_jiffies(c->ms);
+
+	spin_lock_irqsave(&boost_lock, flags);
+	start = !c->active;
+	if (start || time_after(expires, c->expires))
+		c->expires = expires;
+	c->active = true;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	if (start) {
+		trace_cpu_boost(c->name, c->freq, c->ms);
+		queue_work(boost_rem_wq, &boost_start_work);
+	}
+}
+EXPORT_SYMBOL_GPL(cpu_boost_kick);
+
+int cpu_boost_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&cpu_boost_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(cpu_boost_register_notifier);
+
+int cpu_boost_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&cpu_boost_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(cpu_boost_unregister_notifier);
+
+#ifdef CONFIG_INPUT
+/*
+ * One input handler for all the boost users, kicking the input client
+ * at the end of each touch report.
+ */
+static void boost_input_event(struct input_handle *handle, unsigned int type,
+			      unsigned int code, int value)
+{
+	if (type == EV_SYN && code == SYN_REPORT)
+		cpu_boost_kick(CPU_BOOST_INPUT);
+}
+
+static int boost_input_connect(struct input_handler *handler,
+			       struct input_dev *dev,
+			       const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpu-boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void boost_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id boost_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	}, /* multi-touch touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	}, /* touchpad */
+	{ },
+};
+
+static struct input_handler boost_input_handler = {
+	.event		= boost_input_event,
+	.connect	= boost_input_connect,
+	.disconnect	= boost_input_disconnect,
+	.name		= "cpu-boost",
+	.id_table	= boost_input_ids,
+};
+#endif
+
 static int cpu_boost_init(void)
 {
 	int cpu;
@@ -159,6 +396,9 @@ static int cpu_boost_init(void)
 
 	cpufreq_register_notifier(&boost_adjust_nb, CPUFREQ_POLICY_NOTIFIER);
 
+	INIT_WORK(&boost_start_work, do_boost_start);
+	INIT_DELAYED_WORK(&boost_end_work, do_boost_end);
+
 	boost_rem_wq = alloc_workqueue("cpuboost_rem_wq", WQ_HIGHPRI, 0);
 	if (!boost_rem_wq)
 		return -EFAULT;
@@ -173,6 +413,11 @@ static int cpu_boost_init(void)
 	}
 	atomic_notifier_chain_register(&migration_notifier_head, &boost_migration_nb);
 
+#ifdef CONFIG_INPUT
+	if (input_register_handler(&boost_input_handler))
+		pr_warn("failed to register input handler\n");
+#endif
+
 	return 0;
 }
 late_initcall(cpu_boost_init);
@@ -0,0 +1,327 @@
+/*
+ * drivers/cpufreq/cpu-hotplug.c
+ *
+ * Run queue driven cpu hotplug, independent of the cpufreq governor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "cpu-hotplug: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/moduleparam.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpu_hotplug_mgr.h>
+
+/*
+ * Every sample_ms the manager computes the average run queue depth of
+ * the system and the load of every online cpu since the last sample.
+ *
+ * A cpu is added when there are more than nr_up_threshold / 100
+ * runnable tasks per online cpu and the busiest cpu is at least
+ * load_up_threshold percent busy, for up_samples samples in a row.
+ * Enough cpus are added at once to bring the depth per cpu back under
+ * the threshold, as long as the time spent in cpu_up() stays within
+ * up_latency_budget_us.
+ *
+ * A cpu is removed when the remaining cpus would have less than
+ * nr_down_threshold / 100 runnable tasks each and the least loaded cpu
+ * is below load_down_threshold percent, for down_samples samples in a
+ * row.  Only one cpu goes at a time, and only one that has been online
+ * for min_online_ms.
+ *
+ * The gap between the up and down thresholds and the sample counts are
+ * the hysteresis that keeps cpus from bouncing.
+ */
+static int enabled;
+static unsigned int sample_ms = 50;
+static unsigned int min_cpus = 1;
+static unsigned int max_cpus = NR_CPUS;
+static unsigned int nr_up_threshold = 125;
+static unsigned int nr_down_threshold = 50;
+static unsigned int load_up_threshold = 80;
+static unsigned int load_down_threshold = 30;
+static unsigned int up_samples = 2;
+static unsigned int down_samples = 20;
+static unsigned int min_online_ms = 1000;
+static unsigned int up_latency_budget_us = 10000;
+
+module_param(sample_ms, uint, 0664);
+module_param(min_cpus, uint, 0664);
+module_param(max_cpus, uint, 0664);
+module_param(nr_up_threshold, uint, 0664);
+module_param(nr_down_threshold, uint, 0664);
+module_param(load_up_threshold, uint, 0664);
+module_param(load_down_threshold, uint, 0664);
+module_param(up_samples, uint, 0664);
+module_param(down_samples, uint, 0664);
+module_param(min_online_ms, uint, 0664);
+module_param(up_latency_budget_us, uint, 0664);
+
+struct hotplug_cpu_info {
+	u64 prev_idle;
+	u64 prev_wall;
+	u64 prev_nr_sum;
+	unsigned long online_since;
+	bool sampled;		/* prev_* are valid */
+	unsigned int load;
+};
+
+static DEFINE_PER_CPU(struct hotplug_cpu_info, hotplug_info);
+
+static struct delayed_work hotplug_work;
+static DEFINE_MUTEX(hotplug_mgr_mutex);
+static u64 prev_sample_ns;
+static unsigned int up_count, down_count;
+
+/* last measured cpu_up() latency, readable for tuning the budget */
+static unsigned int up_latency_us;
+module_param(up_latency_us, uint, 0444);
+
+bool cpu_hotplug_mgr_enabled(void)
+{
+	return enabled;
+}
+EXPORT_SYMBOL_GPL(cpu_hotplug_mgr_enabled);
+
+static unsigned int hotplug_max_cpus(void)
+{
+	return clamp(max_cpus, 1U, num_present_cpus());
+}
+
+static unsigned int hotplug_min_cpus(void)
+{
+	return clamp(min_cpus, 1U, hotplug_max_cpus());
+}
+
+/*
+ * Bring cpus online until @want are online or the latency budget is
+ * spent.  Returns the number of cpus brought up.
+ */
+static int hotplug_cpus_up(unsigned int want)
+{
+	unsigned int spent = 0;
+	int cpu, up = 0;
+
+	for_each_present_cpu(cpu) {
+		ktime_t start;
+
+		if (num_online_cpus() >= want || spent > up_latency_budget_us)
+			break;
+		if (cpu_online(cpu))
+			continue;
+
+		start = ktime_get();
+		if (cpu_up(cpu))
+			continue;
+		up_latency_us = ktime_to_us(ktime_sub(ktime_get(), start));
+		trace_cpu_hotplug_mgr_up_latency(cpu, up_latency_us);
+		spent += up_latency_us;
+		up++;
+	}
+
+	return up;
+}
+
+/* The least loaded secondary cpu that has been up long enough, or -1 */
+static int hotplug_down_victim(void)
+{
+	unsigned long hold = msecs_to_jiffies(min_online_ms);
+	unsigned int min_load = UINT_MAX;
+	int cpu, victim = -1;
+
+	for_each_online_cpu(cpu) {
+		struct hotplug_cpu_info *info = &per_cpu(hotplug_info, cpu);
+
+		if (cpu == 0 || !info->sampled)
+			continue;
+		if (time_before(jiffies, info->online_since + hold))
+			continue;
+		if (info->load < min_load) {
+			min_load = info->load;
+			victim = cpu;
+		}
+	}
+
+	return victim;
+}
+
+static void hotplug_decide(void)
+{
+	unsigned int online = num_online_cpus();
+	unsigned int nr_avg = 0, max_load = 0, min_load = 100;
+	u64 now_ns, delta_ns, nr_delta = 0;
+	const char *reason = "hold";
+	int change = 0;
+	int cpu;
+
+	now_ns = ktime_to_ns(ktime_get());
+	delta_ns = now_ns - prev_sample_ns;
+	prev_sample_ns = now_ns;
+
+	for_each_present_cpu(cpu) {
+		struct hotplug_cpu_info *info = &per_cpu(hotplug_info, cpu);
+		u64 nr_sum = sched_nr_running_sum(cpu);
+		u64 idle, wall;
+		unsigned int idle_time, wall_time;
+
+		nr_delta += nr_sum - info->prev_nr_sum;
+		info->prev_nr_sum = nr_sum;
+
+		if (!cpu_online(cpu)) {
+			info->sampled = false;
+			continue;
+		}
+
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		if (!info->sampled) {
+			/* just came up, start measuring from here */
+			info->prev_idle = idle;
+			info->prev_wall = wall;
+			info->online_since = jiffies;
+			info->sampled = true;
+			info->load = 100;
+			continue;
+		}
+
+		wall_time = (unsigned int)(wall - info->prev_wall);
+		idle_time = (unsigned int)(idle - info->prev_idle);
+		info->prev_wall = wall;
+		info->prev_idle = idle;
+
+		if (!wall_time || wall_time < idle_time)
+			info->load = 0;
+		else
+			info->load = 100 * (wall_time - idle_time) / wall_time;
+
+		max_load = max(max_load, info->load);
+		min_load = min(min_load, info->load);
+	}
+
+	if (delta_ns)
+		nr_avg = div64_u64(nr_delta * 100, delta_ns);
+
+	if (online < hotplug_min_cpus()) {
+		up_count = down_count = 0;
+		change = hotplug_cpus_up(hotplug_min_cpus());
+		reason = "min_cpus";
+	} else if (online > hotplug_max_cpus()) {
+		up_count = down_count = 0;
+		cpu = hotplug_down_victim();
+		if (cpu > 0 && !cpu_down(cpu))
+			change = -1;
+		reason = "max_cpus";
+	} else if (online < hotplug_max_cpus() &&
+		   nr_avg > nr_up_threshold * online &&
+		   max_load >= load_up_threshold) {
+		down_count = 0;
+		reason = "up_pending";
+		if (++up_count >= up_samples) {
+			unsigned int want;
+
+			want = DIV_ROUND_UP(nr_avg, max(nr_up_threshold, 1U));
+			want = clamp(want, online + 1, hotplug_max_cpus());
+			change = hotplug_cpus_up(want);
+			reason = num_online_cpus() < want ? "up_budget" : "up";
+			up_count = 0;
+		}
+	} else if (online > hotplug_min_cpus() &&
+		   nr_avg < nr_down_threshold * (online - 1) &&
+		   min_load < load_down_threshold) {
+		up_count = 0;
+		reason = "down_pending";
+		if (++down_count >= down_samples) {
+			cpu = hotplug_down_victim();
+			if (cpu < 0) {
+				reason = "min_online";
+			} else if (!cpu_down(cpu)) {
+				change = -1;
+				reason = "down";
+				down_count = 0;
+			}
+		}
+	} else {
+		up_count = down_count = 0;
+	}
+
+	trace_cpu_hotplug_mgr_decision(online, nr_avg, max_load, min_load,
+				       change, reason);
+}
+
+static void hotplug_work_fn(struct work_struct *work)
+{
+	mutex_lock(&hotplug_mgr_mutex);
+	if (enabled) {
+		hotplug_decide();
+		queue_delayed_work(system_freezable_wq, &hotplug_work,
+				   msecs_to_jiffies(max(sample_ms, 10U)));
+	}
+	mutex_unlock(&hotplug_mgr_mutex);
+}
+
+static void hotplug_mgr_start(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct hotplug_cpu_info *info = &per_cpu(hotplug_info, cpu);
+
+		info->sampled = false;
+		info->prev_nr_sum = sched_nr_running_sum(cpu);
+	}
+	prev_sample_ns = ktime_to_ns(ktime_get());
+	up_count = down_count = 0;
+
+	queue_delayed_work(system_freezable_wq, &hotplug_work,
+			   msecs_to_jiffies(sample_ms));
+}
+
+static int set_enabled(const char *val, const struct kernel_param *kp)
+{
+	int old = enabled;
+	int ret;
+
+	mutex_lock(&hotplug_mgr_mutex);
+	ret = param_set_bool(val, kp);
+	if (!ret && enabled && !old && hotplug_work.work.func)
+		hotplug_mgr_start();
+	mutex_unlock(&hotplug_mgr_mutex);
+
+	/* a disabled manager stops at its next sample */
+	return ret;
+}
+
+static struct kernel_param_ops enabled_ops = {
+	.set = set_enabled,
+	.get = param_get_bool,
+};
+module_param_cb(enabled, &enabled_ops, &enabled, 0664);
+
+static int __init cpu_hotplug_mgr_init(void)
+{
+	INIT_DELAYED_WORK_DEFERRABLE(&hotplug_work, hotplug_work_fn);
+
+	mutex_lock(&hotplug_mgr_mutex);
+	if (enabled)
+		hotplug_mgr_start();
+	mutex_unlock(&hotplug_mgr_mutex);
+
+	return 0;
+}
+late_initcall(cpu_hotplug_mgr_init);
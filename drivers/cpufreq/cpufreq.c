@@ -30,9 +30,15 @@
 #include <linux/mutex.h>
 #include <linux/syscore_ops.h>
 #include <linux/cpumask.h>
+#include <linux/ktime.h>
 
 #include <trace/events/power.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq.h>
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpufreq_target);
+
 #ifdef CONFIG_OMAP4430_TOP_CPU
 #ifdef CONFIG_MACH_SAMSUNG_ESPRESSO_10
 #define BootSpeed 1216000
@@ -1385,8 +1391,15 @@ int __cpufreq_driver_target(struct cpufreq_policy *policy,
 {
 	int retval = -EINVAL;
 
-	if (cpu_online(policy->cpu) && cpufreq_driver->target)
+	if (cpu_online(policy->cpu) && cpufreq_driver->target) {
+		unsigned int old_freq = policy->cur;
+		ktime_t start = ktime_get();
+
 		retval = cpufreq_driver->target(policy, target_freq, relation);
+		trace_cpufreq_target(policy, target_freq, relation, old_freq,
+				     retval,
+				     ktime_to_ns(ktime_sub(ktime_get(), start)));
+	}
 
 	return retval;
 }
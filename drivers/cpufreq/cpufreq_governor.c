@@ -0,0 +1,404 @@
+/*
+ * drivers/cpufreq/cpufreq_governor.c
+ *
+ * CPUFREQ governors common code
+ *
+ * The demand based governors (ondemand, conservative, pegasusq and
+ * hotplug) used to carry their own copies of the idle accounting, the
+ * deferrable sampling work and the governor start/stop handling.  They
+ * now only provide the policy and share everything else from here.
+ *
+ * Copyright (C)  2001 Russell King
+ *           (C)  2003 Venkatesh Pallipadi <venkatesh.pallipadi@intel.com>.
+ *                     Jun Nakajima <jun.nakajima@intel.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/kernel_stat.h>
+#include <linux/mutex.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+
+#include "cpufreq_governor.h"
+
+static inline cputime64_t get_cpu_idle_time_jiffy(unsigned int cpu,
+							cputime64_t *wall)
+{
+	cputime64_t idle_time;
+	cputime64_t cur_wall_time;
+	cputime64_t busy_time;
+
+	cur_wall_time = jiffies64_to_cputime64(get_jiffies_64());
+	busy_time = cputime64_add(kstat_cpu(cpu).cpustat.user,
+			kstat_cpu(cpu).cpustat.system);
+
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.irq);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.softirq);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.steal);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.nice);
+
+	idle_time = cputime64_sub(cur_wall_time, busy_time);
+	if (wall)
+		*wall = (cputime64_t)jiffies_to_usecs(cur_wall_time);
+
+	return (cputime64_t)jiffies_to_usecs(idle_time);
+}
+
+cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall)
+{
+	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
+
+	if (idle_time == -1ULL)
+		return get_cpu_idle_time_jiffy(cpu, wall);
+
+	return idle_time;
+}
+EXPORT_SYMBOL_GPL(get_cpu_idle_time);
+
+cputime64_t get_cpu_iowait_time(unsigned int cpu, cputime64_t *wall)
+{
+	u64 iowait_time = get_cpu_iowait_time_us(cpu, wall);
+
+	if (iowait_time == -1ULL)
+		return 0;
+
+	return iowait_time;
+}
+EXPORT_SYMBOL_GPL(get_cpu_iowait_time);
+
+static inline struct workqueue_struct *dbs_wq(struct dbs_data *dbs_data)
+{
+	return dbs_data->wq ? dbs_data->wq : system_wq;
+}
+
+/*
+ * Take the idle, iowait and nice counters of every cpu in the policy of
+ * @cdbs, store the load each one saw since the last call in its
+ * cpu_dbs_common_info and return the highest of them.
+ */
+unsigned int dbs_check_cpu(struct dbs_data *dbs_data,
+			   struct cpu_dbs_common_info *cdbs)
+{
+	struct dbs_tuners_common *tuners = &dbs_data->tuners;
+	struct cpufreq_policy *policy = cdbs->cur_policy;
+	unsigned int max_load = 0;
+	unsigned int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpu_dbs_common_info *j_cdbs;
+		cputime64_t cur_wall_time, cur_idle_time, cur_iowait_time;
+		unsigned int idle_time, wall_time, iowait_time;
+		unsigned int load;
+
+		j_cdbs = dbs_data->get_cpu_cdbs(j);
+
+		cur_idle_time = get_cpu_idle_time(j, &cur_wall_time);
+		cur_iowait_time = get_cpu_iowait_time(j, &cur_wall_time);
+
+		wall_time = (unsigned int) cputime64_sub(cur_wall_time,
+				j_cdbs->prev_cpu_wall);
+		j_cdbs->prev_cpu_wall = cur_wall_time;
+
+		idle_time = (unsigned int) cputime64_sub(cur_idle_time,
+				j_cdbs->prev_cpu_idle);
+		j_cdbs->prev_cpu_idle = cur_idle_time;
+
+		iowait_time = (unsigned int) cputime64_sub(cur_iowait_time,
+				j_cdbs->prev_cpu_iowait);
+		j_cdbs->prev_cpu_iowait = cur_iowait_time;
+
+		if (tuners->ignore_nice) {
+			cputime64_t cur_nice;
+			unsigned long cur_nice_jiffies;
+
+			cur_nice = cputime64_sub(kstat_cpu(j).cpustat.nice,
+					 j_cdbs->prev_cpu_nice);
+			/*
+			 * Assumption: nice time between sampling periods will
+			 * be less than 2^32 jiffies for 32 bit sys
+			 */
+			cur_nice_jiffies = (unsigned long)
+					cputime64_to_jiffies64(cur_nice);
+
+			j_cdbs->prev_cpu_nice = kstat_cpu(j).cpustat.nice;
+			idle_time += jiffies_to_usecs(cur_nice_jiffies);
+		}
+
+		/*
+		 * Waiting for disk IO is an indication that you're
+		 * performance critical, and not that the system is actually
+		 * idle. So subtract the iowait time from the cpu idle time
+		 * if the user asked for it.
+		 */
+		if (tuners->io_is_busy && idle_time >= iowait_time)
+			idle_time -= iowait_time;
+
+		if (unlikely(!wall_time || wall_time < idle_time)) {
+			j_cdbs->load = 0;
+			continue;
+		}
+
+		load = 100 * (wall_time - idle_time) / wall_time;
+		j_cdbs->load = load;
+
+		if (load > max_load)
+			max_load = load;
+	}
+
+	policy->load = max_load;
+	return max_load;
+}
+EXPORT_SYMBOL_GPL(dbs_check_cpu);
+
+/*
+ * Jiffies until the next sample, @rate_mult sampling periods from now.
+ * We want all CPUs to do sampling nearly on the same jiffy.
+ */
+unsigned int dbs_sampling_delay(struct dbs_data *dbs_data,
+				unsigned int rate_mult)
+{
+	int delay = usecs_to_jiffies(dbs_data->tuners.sampling_rate * rate_mult);
+
+	if (num_online_cpus() > 1)
+		delay -= jiffies % delay;
+
+	return delay;
+}
+EXPORT_SYMBOL_GPL(dbs_sampling_delay);
+
+static void dbs_timer(struct work_struct *work)
+{
+	struct cpu_dbs_common_info *cdbs =
+		container_of(work, struct cpu_dbs_common_info, work.work);
+	struct dbs_data *dbs_data = cdbs->dbs_data;
+	unsigned int delay;
+
+	mutex_lock(&cdbs->timer_mutex);
+	delay = dbs_data->gov_dbs_timer(cdbs);
+	queue_delayed_work_on(cdbs->cpu, dbs_wq(dbs_data), &cdbs->work, delay);
+	mutex_unlock(&cdbs->timer_mutex);
+}
+
+static inline void dbs_timer_init(struct dbs_data *dbs_data,
+				  struct cpu_dbs_common_info *cdbs)
+{
+	unsigned int delay = dbs_sampling_delay(dbs_data, 1);
+
+	INIT_DELAYED_WORK_DEFERRABLE(&cdbs->work, dbs_timer);
+	queue_delayed_work_on(cdbs->cpu, dbs_wq(dbs_data), &cdbs->work,
+			      delay + dbs_data->start_delay);
+}
+
+static inline void dbs_timer_exit(struct cpu_dbs_common_info *cdbs)
+{
+	cancel_delayed_work_sync(&cdbs->work);
+}
+
+/* Restart idle accounting of every online cpu from the current counters */
+static void dbs_reset_prev_counters(struct dbs_data *dbs_data)
+{
+	unsigned int j;
+
+	for_each_online_cpu(j) {
+		struct cpu_dbs_common_info *cdbs = dbs_data->get_cpu_cdbs(j);
+
+		cdbs->prev_cpu_idle = get_cpu_idle_time(j,
+						&cdbs->prev_cpu_wall);
+		cdbs->prev_cpu_iowait = get_cpu_iowait_time(j, NULL);
+		if (dbs_data->tuners.ignore_nice)
+			cdbs->prev_cpu_nice = kstat_cpu(j).cpustat.nice;
+	}
+}
+
+/* Called when the first policy starts using the governor */
+static int dbs_init(struct dbs_data *dbs_data, struct cpufreq_policy *policy)
+{
+	unsigned int latency;
+	int rc;
+
+	/* policy latency is in nS. Convert it to uS first */
+	latency = policy->cpuinfo.transition_latency / 1000;
+	if (latency == 0)
+		latency = 1;
+	/* Bring kernel and HW constraints together */
+	dbs_data->min_sampling_rate = max(dbs_data->min_sampling_rate,
+			MIN_LATENCY_MULTIPLIER * latency);
+	dbs_data->tuners.sampling_rate = max(dbs_data->min_sampling_rate,
+			latency * LATENCY_MULTIPLIER);
+
+	if (dbs_data->gov_init) {
+		rc = dbs_data->gov_init(policy);
+		if (rc)
+			return rc;
+	}
+
+	rc = sysfs_create_group(cpufreq_global_kobject, dbs_data->attr_group);
+	if (rc && dbs_data->gov_exit)
+		dbs_data->gov_exit();
+
+	return rc;
+}
+
+int cpufreq_governor_dbs(struct dbs_data *dbs_data,
+			 struct cpufreq_policy *policy, unsigned int event)
+{
+	unsigned int cpu = policy->cpu;
+	struct cpu_dbs_common_info *cdbs = dbs_data->get_cpu_cdbs(cpu);
+	unsigned int j;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if ((!cpu_online(cpu)) || (!policy->cur))
+			return -EINVAL;
+
+		mutex_lock(&dbs_data->mutex);
+
+		if (dbs_data->enable == 0) {
+			rc = dbs_init(dbs_data, policy);
+			if (rc) {
+				mutex_unlock(&dbs_data->mutex);
+				return rc;
+			}
+		}
+		dbs_data->enable++;
+
+		for_each_cpu(j, policy->cpus) {
+			struct cpu_dbs_common_info *j_cdbs;
+
+			j_cdbs = dbs_data->get_cpu_cdbs(j);
+			j_cdbs->cpu = j;
+			j_cdbs->cur_policy = policy;
+			j_cdbs->dbs_data = dbs_data;
+			j_cdbs->load = 0;
+
+			j_cdbs->prev_cpu_idle = get_cpu_idle_time(j,
+						&j_cdbs->prev_cpu_wall);
+			j_cdbs->prev_cpu_iowait = get_cpu_iowait_time(j, NULL);
+			if (dbs_data->tuners.ignore_nice)
+				j_cdbs->prev_cpu_nice =
+						kstat_cpu(j).cpustat.nice;
+		}
+
+		mutex_init(&cdbs->timer_mutex);
+		if (dbs_data->gov_start)
+			dbs_data->gov_start(cdbs);
+		mutex_unlock(&dbs_data->mutex);
+
+		dbs_timer_init(dbs_data, cdbs);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		dbs_timer_exit(cdbs);
+
+		mutex_lock(&dbs_data->mutex);
+		if (dbs_data->gov_stop)
+			dbs_data->gov_stop(cdbs);
+		mutex_destroy(&cdbs->timer_mutex);
+
+		if (--dbs_data->enable == 0) {
+			sysfs_remove_group(cpufreq_global_kobject,
+					   dbs_data->attr_group);
+			if (dbs_data->gov_exit)
+				dbs_data->gov_exit();
+		}
+		mutex_unlock(&dbs_data->mutex);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&cdbs->timer_mutex);
+		if (policy->max < cdbs->cur_policy->cur)
+			__cpufreq_driver_target(cdbs->cur_policy,
+				policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > cdbs->cur_policy->cur)
+			__cpufreq_driver_target(cdbs->cur_policy,
+				policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&cdbs->timer_mutex);
+		break;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_governor_dbs);
+
+/************************** sysfs interface ************************/
+
+ssize_t dbs_store_sampling_rate(struct dbs_data *dbs_data,
+				const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&dbs_data->mutex);
+	dbs_data->tuners.sampling_rate = max(input,
+					     dbs_data->min_sampling_rate);
+	mutex_unlock(&dbs_data->mutex);
+
+	return count;
+}
+EXPORT_SYMBOL_GPL(dbs_store_sampling_rate);
+
+ssize_t dbs_store_ignore_nice(struct dbs_data *dbs_data,
+			      const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	if (input > 1)
+		input = 1;
+
+	mutex_lock(&dbs_data->mutex);
+	if (input != dbs_data->tuners.ignore_nice) {
+		dbs_data->tuners.ignore_nice = input;
+		/* we need to re-evaluate prev_cpu_idle */
+		dbs_reset_prev_counters(dbs_data);
+	}
+	mutex_unlock(&dbs_data->mutex);
+
+	return count;
+}
+EXPORT_SYMBOL_GPL(dbs_store_ignore_nice);
+
+/*
+ * A corner case exists when switching io_is_busy at run-time: comparing idle
+ * times from a non-io_is_busy period to an io_is_busy period (or vice-versa)
+ * will misrepresent the actual change in system idleness.  We ignore this
+ * corner case: enabling io_is_busy might cause freq increase and disabling
+ * might cause freq decrease, which probably matches the original intent.
+ */
+ssize_t dbs_store_io_is_busy(struct dbs_data *dbs_data,
+			     const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&dbs_data->mutex);
+	dbs_data->tuners.io_is_busy = !!input;
+	mutex_unlock(&dbs_data->mutex);
+
+	return count;
+}
+EXPORT_SYMBOL_GPL(dbs_store_io_is_busy);
+
+MODULE_AUTHOR("Venkatesh Pallipadi <venkatesh.pallipadi@intel.com>");
+MODULE_DESCRIPTION("CPUfreq policy governor common code");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,173 @@
+/*
+ * drivers/cpufreq/cpufreq_governor.h
+ *
+ * Header file for CPUFreq governors common code
+ *
+ * Copyright (C)  2001 Russell King
+ *           (C)  2003 Venkatesh Pallipadi <venkatesh.pallipadi@intel.com>.
+ *                     Jun Nakajima <jun.nakajima@intel.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _CPUFREQ_GOVERNOR_H
+#define _CPUFREQ_GOVERNOR_H
+
+#include <linux/cpufreq.h>
+#include <linux/kobject.h>
+#include <linux/mutex.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+
+/*
+ * The polling frequency of the demand based governors depends on the
+ * capability of the processor.  Default polling frequency is 1000 times
+ * the transition latency of the processor.  The governors will work on
+ * any processor with transition latency <= 10mS, using appropriate
+ * sampling rate.
+ * For CPUs with transition latency > 10mS (mostly drivers with
+ * CPUFREQ_ETERNAL) these governors will not work.
+ * All times here are in uS.
+ */
+#define MIN_SAMPLING_RATE_RATIO			(2)
+#define LATENCY_MULTIPLIER			(1000)
+#define MIN_LATENCY_MULTIPLIER			(100)
+#define TRANSITION_LATENCY_LIMIT		(10 * 1000 * 1000)
+
+struct dbs_data;
+
+/*
+ * Per cpu sampling state.  Every governor built on the common code
+ * embeds one of these in its own per cpu data and hands it out through
+ * dbs_data->get_cpu_cdbs().
+ */
+struct cpu_dbs_common_info {
+	int cpu;
+	cputime64_t prev_cpu_idle;
+	cputime64_t prev_cpu_iowait;
+	cputime64_t prev_cpu_wall;
+	cputime64_t prev_cpu_nice;
+	/* load over the last sampling period in percent, set by dbs_check_cpu */
+	unsigned int load;
+	struct cpufreq_policy *cur_policy;
+	struct dbs_data *dbs_data;
+	struct delayed_work work;
+	/*
+	 * percpu mutex that serializes governor limit change with
+	 * dbs_timer invocation. We do not want dbs_timer to run
+	 * when user is changing the governor or limits.
+	 */
+	struct mutex timer_mutex;
+};
+
+/* Tunables every demand based governor exports */
+struct dbs_tuners_common {
+	unsigned int sampling_rate;
+	unsigned int ignore_nice;
+	unsigned int io_is_busy;
+};
+
+/*
+ * One instance per governor.  The common code owns the sampling work,
+ * the idle accounting and the governor start/stop/limits handling; the
+ * governor only supplies the frequency (and hotplug) policy.
+ */
+struct dbs_data {
+	struct attribute_group *attr_group;
+	struct dbs_tuners_common tuners;
+	unsigned int min_sampling_rate;
+	/* workqueue the sampling work runs on, system_wq if NULL */
+	struct workqueue_struct *wq;
+	/* extra delay before the first sample, in jiffies */
+	unsigned int start_delay;
+
+	struct cpu_dbs_common_info *(*get_cpu_cdbs)(int cpu);
+	/*
+	 * Called from the sampling work with cdbs->timer_mutex held.
+	 * Returns the number of jiffies until the next sample.
+	 */
+	unsigned int (*gov_dbs_timer)(struct cpu_dbs_common_info *cdbs);
+	/* optional, called when the first policy starts / last one stops */
+	int (*gov_init)(struct cpufreq_policy *policy);
+	void (*gov_exit)(void);
+	/* optional, called for each policy before sampling starts / after it stops */
+	void (*gov_start)(struct cpu_dbs_common_info *cdbs);
+	void (*gov_stop)(struct cpu_dbs_common_info *cdbs);
+
+	unsigned int enable;	/* number of policies using this governor */
+	/* protects enable and the common tunables */
+	struct mutex mutex;
+};
+
+#define define_get_cpu_dbs_routines(_dbs_info)				\
+static struct cpu_dbs_common_info *get_cpu_cdbs(int cpu)		\
+{									\
+	return &per_cpu(_dbs_info, cpu).cdbs;				\
+}
+
+/*
+ * Sysfs files for the tunables in struct dbs_tuners_common.  The
+ * governor lists sampling_rate_min, sampling_rate, ignore_nice_load and
+ * io_is_busy in its own attribute group.
+ */
+#define declare_dbs_common_attrs(_dbs_data)				\
+static ssize_t show_sampling_rate_min(struct kobject *kobj,		\
+				      struct attribute *attr, char *buf) \
+{									\
+	return sprintf(buf, "%u\n", (_dbs_data).min_sampling_rate);	\
+}									\
+static ssize_t show_sampling_rate(struct kobject *kobj,		\
+				  struct attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", (_dbs_data).tuners.sampling_rate);	\
+}									\
+static ssize_t store_sampling_rate(struct kobject *a,			\
+		struct attribute *b, const char *buf, size_t count)	\
+{									\
+	return dbs_store_sampling_rate(&(_dbs_data), buf, count);	\
+}									\
+static ssize_t show_ignore_nice_load(struct kobject *kobj,		\
+				     struct attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", (_dbs_data).tuners.ignore_nice);	\
+}									\
+static ssize_t store_ignore_nice_load(struct kobject *a,		\
+		struct attribute *b, const char *buf, size_t count)	\
+{									\
+	return dbs_store_ignore_nice(&(_dbs_data), buf, count);	\
+}									\
+static ssize_t show_io_is_busy(struct kobject *kobj,			\
+			       struct attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", (_dbs_data).tuners.io_is_busy);	\
+}									\
+static ssize_t store_io_is_busy(struct kobject *a,			\
+		struct attribute *b, const char *buf, size_t count)	\
+{									\
+	return dbs_store_io_is_busy(&(_dbs_data), buf, count);		\
+}									\
+define_one_global_ro(sampling_rate_min);				\
+define_one_global_rw(sampling_rate);					\
+define_one_global_rw(ignore_nice_load);					\
+define_one_global_rw(io_is_busy)
+
+cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall);
+cputime64_t get_cpu_iowait_time(unsigned int cpu, cputime64_t *wall);
+
+unsigned int dbs_check_cpu(struct dbs_data *dbs_data,
+			   struct cpu_dbs_common_info *cdbs);
+unsigned int dbs_sampling_delay(struct dbs_data *dbs_data,
+				unsigned int rate_mult);
+int cpufreq_governor_dbs(struct dbs_data *dbs_data,
+			 struct cpufreq_policy *policy, unsigned int event);
+
+ssize_t dbs_store_sampling_rate(struct dbs_data *dbs_data,
+				const char *buf, size_t count);
+ssize_t dbs_store_ignore_nice(struct dbs_data *dbs_data,
+			      const char *buf, size_t count);
+ssize_t dbs_store_io_is_busy(struct dbs_data *dbs_data,
+			     const char *buf, size_t count);
+
+#endif /* _CPUFREQ_GOVERNOR_H */
@@ -30,6 +30,8 @@
 #include <linux/err.h>
 #include <linux/slab.h>
 
+#include "cpufreq_governor.h"
+
 /* greater than 80% avg load across online CPUs increases frequency */
 #define DEFAULT_UP_FREQ_MIN_LOAD			(80)
 
@@ -48,8 +50,7 @@
 /* default number of sampling periods to average before hotplug-out decision */
 #define DEFAULT_HOTPLUG_OUT_SAMPLING_PERIODS		(20)
 
-static void do_dbs_timer(struct work_struct *work);
-static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
+static int hp_cpufreq_governor_dbs(struct cpufreq_policy *policy,
 		unsigned int event);
 
 #ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_HOTPLUG
@@ -57,39 +58,29 @@ static
 #endif
 struct cpufreq_governor cpufreq_gov_hotplug = {
        .name         = "hotplug",
-       .governor     = cpufreq_governor_dbs,
+       .governor     = hp_cpufreq_governor_dbs,
        .owner        = THIS_MODULE,
 };
 
 struct cpu_dbs_info_s {
-	cputime64_t prev_cpu_idle;
-	cputime64_t prev_cpu_wall;
-	cputime64_t prev_cpu_nice;
-	struct cpufreq_policy *cur_policy;
-	struct delayed_work work;
+	struct cpu_dbs_common_info cdbs;
 	struct cpufreq_frequency_table *freq_table;
-	int cpu;
-	/*
-	 * percpu mutex that serializes governor limit change with
-	 * do_dbs_timer invocation. We do not want do_dbs_timer to run
-	 * when user is changing the governor or limits.
-	 */
-	struct mutex timer_mutex;
 };
 static DEFINE_PER_CPU(struct cpu_dbs_info_s, hp_cpu_dbs_info);
 
-static unsigned int dbs_enable;	/* number of CPUs using this policy */
+define_get_cpu_dbs_routines(hp_cpu_dbs_info);
+
+static struct dbs_data hp_dbs_data;
 
 /*
  * dbs_mutex protects data in dbs_tuners_ins from concurrent changes on
- * different CPUs. It protects dbs_enable in governor start/stop.
+ * different CPUs.
  */
 static DEFINE_MUTEX(dbs_mutex);
 
 static struct workqueue_struct	*khotplug_wq;
 
 static struct dbs_tuners {
-	unsigned int sampling_rate;
 	unsigned int up_threshold;
 	unsigned int down_differential;
 	unsigned int down_threshold;
@@ -97,48 +88,19 @@ static struct dbs_tuners {
 	unsigned int hotplug_out_sampling_periods;
 	unsigned int hotplug_load_index;
 	unsigned int *hotplug_load_history;
-	unsigned int ignore_nice;
-	unsigned int io_is_busy;
 } dbs_tuners_ins = {
-	.sampling_rate =		DEFAULT_SAMPLING_PERIOD,
 	.up_threshold =			DEFAULT_UP_FREQ_MIN_LOAD,
 	.down_differential =            DEFAULT_FREQ_DOWN_DIFFERENTIAL,
 	.down_threshold =		DEFAULT_DOWN_FREQ_MAX_LOAD,
 	.hotplug_in_sampling_periods =	DEFAULT_HOTPLUG_IN_SAMPLING_PERIODS,
 	.hotplug_out_sampling_periods =	DEFAULT_HOTPLUG_OUT_SAMPLING_PERIODS,
 	.hotplug_load_index =		0,
-	.ignore_nice =			0,
-	.io_is_busy =			0,
 };
 
-/*
- * A corner case exists when switching io_is_busy at run-time: comparing idle
- * times from a non-io_is_busy period to an io_is_busy period (or vice-versa)
- * will misrepresent the actual change in system idleness.  We ignore this
- * corner case: enabling io_is_busy might cause freq increase and disabling
- * might cause freq decrease, which probably matches the original intent.
- */
-static inline cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall)
-{
-        u64 idle_time;
-        u64 iowait_time;
-
-        /* cpufreq-hotplug always assumes CONFIG_NO_HZ */
-        idle_time = get_cpu_idle_time_us(cpu, wall);
-
-	/* add time spent doing I/O to idle time */
-        if (dbs_tuners_ins.io_is_busy) {
-                iowait_time = get_cpu_iowait_time_us(cpu, wall);
-                /* cpufreq-hotplug always assumes CONFIG_NO_HZ */
-                if (iowait_time != -1ULL && idle_time >= iowait_time)
-                        idle_time -= iowait_time;
-        }
-
-        return idle_time;
-}
-
 /************************** sysfs interface ************************/
 
+declare_dbs_common_attrs(hp_dbs_data);
+
 /* cpufreq_hotplug Governor Tunables */
 #define show_one(file_name, object)					\
 static ssize_t show_##file_name						\
@@ -147,30 +109,11 @@ static ssize_t show_##file_name						\
 	return sprintf(buf, "%u\n", dbs_tuners_ins.object);		\
 }
 
-show_one(sampling_rate, sampling_rate);
 show_one(up_threshold, up_threshold);
 show_one(down_differential, down_differential);
 show_one(down_threshold, down_threshold);
 show_one(hotplug_in_sampling_periods, hotplug_in_sampling_periods);
 show_one(hotplug_out_sampling_periods, hotplug_out_sampling_periods);
-show_one(ignore_nice_load, ignore_nice);
-show_one(io_is_busy, io_is_busy);
-
-static ssize_t store_sampling_rate(struct kobject *a, struct attribute *b,
-				   const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-	mutex_lock(&dbs_mutex);
-	dbs_tuners_ins.sampling_rate = input;
-	mutex_unlock(&dbs_mutex);
-
-	return count;
-}
 
 static ssize_t store_up_threshold(struct kobject *a, struct attribute *b,
 				  const char *buf, size_t count)
@@ -323,70 +266,14 @@ out:
 	return ret;
 }
 
-static ssize_t store_ignore_nice_load(struct kobject *a, struct attribute *b,
-				      const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-
-	unsigned int j;
-
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-	if (input > 1)
-		input = 1;
-
-	mutex_lock(&dbs_mutex);
-	if (input == dbs_tuners_ins.ignore_nice) { /* nothing to do */
-		mutex_unlock(&dbs_mutex);
-		return count;
-	}
-	dbs_tuners_ins.ignore_nice = input;
-
-	/* we need to re-evaluate prev_cpu_idle */
-	for_each_online_cpu(j) {
-		struct cpu_dbs_info_s *dbs_info;
-		dbs_info = &per_cpu(hp_cpu_dbs_info, j);
-		dbs_info->prev_cpu_idle = get_cpu_idle_time(j,
-						&dbs_info->prev_cpu_wall);
-		if (dbs_tuners_ins.ignore_nice)
-			dbs_info->prev_cpu_nice = kstat_cpu(j).cpustat.nice;
-
-	}
-	mutex_unlock(&dbs_mutex);
-
-	return count;
-}
-
-static ssize_t store_io_is_busy(struct kobject *a, struct attribute *b,
-				   const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-	mutex_lock(&dbs_mutex);
-	dbs_tuners_ins.io_is_busy = !!input;
-	mutex_unlock(&dbs_mutex);
-
-	return count;
-}
-
-define_one_global_rw(sampling_rate);
 define_one_global_rw(up_threshold);
 define_one_global_rw(down_differential);
 define_one_global_rw(down_threshold);
 define_one_global_rw(hotplug_in_sampling_periods);
 define_one_global_rw(hotplug_out_sampling_periods);
-define_one_global_rw(ignore_nice_load);
-define_one_global_rw(io_is_busy);
 
 static struct attribute *dbs_attributes[] = {
+	&sampling_rate_min.attr,
 	&sampling_rate.attr,
 	&up_threshold.attr,
 	&down_differential.attr,
@@ -405,7 +292,7 @@ static struct attribute_group dbs_attr_group = {
 
 /************************** sysfs end ************************/
 
-static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
+static void hp_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 {
 	/* combined load of all enabled CPUs */
 	unsigned int total_load = 0;
@@ -424,46 +311,15 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	struct cpufreq_policy *policy;
 	unsigned int i, j;
 
-	policy = this_dbs_info->cur_policy;
+	policy = this_dbs_info->cdbs.cur_policy;
 
 	/*
 	 * cpu load accounting
 	 * get highest load, total load and average load across all CPUs
 	 */
-	for_each_cpu(j, policy->cpus) {
-		unsigned int load;
-		unsigned int idle_time, wall_time;
-		cputime64_t cur_wall_time, cur_idle_time;
-		struct cpu_dbs_info_s *j_dbs_info;
-
-		j_dbs_info = &per_cpu(hp_cpu_dbs_info, j);
-
-		/* update both cur_idle_time and cur_wall_time */
-		cur_idle_time = get_cpu_idle_time(j, &cur_wall_time);
-
-		/* how much wall time has passed since last iteration? */
-		wall_time = (unsigned int) cputime64_sub(cur_wall_time,
-				j_dbs_info->prev_cpu_wall);
-		j_dbs_info->prev_cpu_wall = cur_wall_time;
-
-		/* how much idle time has passed since last iteration? */
-		idle_time = (unsigned int) cputime64_sub(cur_idle_time,
-				j_dbs_info->prev_cpu_idle);
-		j_dbs_info->prev_cpu_idle = cur_idle_time;
-
-		if (unlikely(!wall_time || wall_time < idle_time))
-			continue;
-
-		/* load is the percentage of time not spent in idle */
-		load = 100 * (wall_time - idle_time) / wall_time;
-
-		/* keep track of combined load across all CPUs */
-		total_load += load;
-
-		/* keep track of highest single load across all CPUs */
-		if (load > max_load)
-			max_load = load;
-	}
+	max_load = dbs_check_cpu(&hp_dbs_data, &this_dbs_info->cdbs);
+	for_each_cpu(j, policy->cpus)
+		total_load += get_cpu_cdbs(j)->load;
 
 	/* use the max load in the OPP freq change policy */
 	max_load_freq = max_load * policy->cur;
@@ -503,10 +359,11 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 
 	/* check if auxiliary CPU is needed based on avg_load */
 	if (avg_load > dbs_tuners_ins.up_threshold) {
-		if (num_online_cpus() < 2 && hotplug_in_avg_load > dbs_tuners_ins.up_threshold) {
-			mutex_unlock(&this_dbs_info->timer_mutex);
+		if (num_online_cpus() < 2 && !cpu_hotplug_mgr_enabled() &&
+		    hotplug_in_avg_load > dbs_tuners_ins.up_threshold) {
+			mutex_unlock(&this_dbs_info->cdbs.timer_mutex);
 			cpu_up(1);
-			mutex_lock(&this_dbs_info->timer_mutex);
+			mutex_lock(&this_dbs_info->cdbs.timer_mutex);
 			goto out;
 		}
 	}
@@ -522,10 +379,11 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	/* check for frequency decrease */
 	if (avg_load < dbs_tuners_ins.down_threshold) {
 		if (policy->cur == policy->min) {
-			if (num_online_cpus() > 1 && hotplug_out_avg_load < dbs_tuners_ins.down_threshold) {
-				mutex_unlock(&this_dbs_info->timer_mutex);
+			if (num_online_cpus() > 1 && !cpu_hotplug_mgr_enabled() &&
+			    hotplug_out_avg_load < dbs_tuners_ins.down_threshold) {
+				mutex_unlock(&this_dbs_info->cdbs.timer_mutex);
 				cpu_down(1);
-				mutex_lock(&this_dbs_info->timer_mutex);
+				mutex_lock(&this_dbs_info->cdbs.timer_mutex);
 			}
 			goto out;
 		}
@@ -552,116 +410,74 @@ out:
 	return;
 }
 
-static void do_dbs_timer(struct work_struct *work)
+static unsigned int hp_dbs_timer(struct cpu_dbs_common_info *cdbs)
 {
-	struct cpu_dbs_info_s *dbs_info = container_of(work, struct cpu_dbs_info_s, work.work);
-	unsigned int cpu = dbs_info->cpu;
+	struct cpu_dbs_info_s *dbs_info =
+		container_of(cdbs, struct cpu_dbs_info_s, cdbs);
 
-	/* We want all related CPUs to do sampling nearly on same jiffy */
-	int delay = usecs_to_jiffies(dbs_tuners_ins.sampling_rate);
+	hp_check_cpu(dbs_info);
 
-	mutex_lock(&dbs_info->timer_mutex);
-	dbs_check_cpu(dbs_info);
-	queue_delayed_work_on(cpu, khotplug_wq, &dbs_info->work, delay);
-	mutex_unlock(&dbs_info->timer_mutex);
+	return dbs_sampling_delay(&hp_dbs_data, 1);
 }
 
-static inline void dbs_timer_init(struct cpu_dbs_info_s *dbs_info)
+static int hp_init(struct cpufreq_policy *policy)
 {
-	/* We want all related CPUs to do sampling nearly on same jiffy */
-	int delay = usecs_to_jiffies(dbs_tuners_ins.sampling_rate);
-	delay -= jiffies % delay;
+	unsigned int i, max_periods;
 
-	INIT_DELAYED_WORK_DEFERRABLE(&dbs_info->work, do_dbs_timer);
-	queue_delayed_work_on(dbs_info->cpu, khotplug_wq, &dbs_info->work, delay);
+	hp_dbs_data.tuners.sampling_rate = max(hp_dbs_data.min_sampling_rate,
+					       DEFAULT_SAMPLING_PERIOD);
+
+	mutex_lock(&dbs_mutex);
+	max_periods = max(dbs_tuners_ins.hotplug_in_sampling_periods,
+			dbs_tuners_ins.hotplug_out_sampling_periods);
+	dbs_tuners_ins.hotplug_load_history = kmalloc((sizeof(unsigned int) * max_periods), GFP_KERNEL);
+	if (!dbs_tuners_ins.hotplug_load_history) {
+		mutex_unlock(&dbs_mutex);
+		WARN_ON(1);
+		return -ENOMEM;
+	}
+	for (i = 0; i < max_periods; i++)
+		dbs_tuners_ins.hotplug_load_history[i] = 50;
+	dbs_tuners_ins.hotplug_load_index = 0;
+	mutex_unlock(&dbs_mutex);
+
+	return 0;
 }
 
-static inline void dbs_timer_exit(struct cpu_dbs_info_s *dbs_info)
+static void hp_exit(void)
 {
-	cancel_delayed_work_sync(&dbs_info->work);
+	/*
+	 * **  BIG CAVEAT:    Stopping the governor with CPU1 offline will
+	 * result in it remaining offline until the user onlines it again.
+	 */
+	mutex_lock(&dbs_mutex);
+	kfree(dbs_tuners_ins.hotplug_load_history);
+	dbs_tuners_ins.hotplug_load_history = NULL;
+	mutex_unlock(&dbs_mutex);
 }
 
-static int cpufreq_governor_dbs(struct cpufreq_policy *policy, unsigned int event)
+static void hp_start(struct cpu_dbs_common_info *cdbs)
 {
-	unsigned int cpu = policy->cpu;
-	struct cpu_dbs_info_s *this_dbs_info;
-	unsigned int i, j, max_periods;
-	int rc;
-
-	this_dbs_info = &per_cpu(hp_cpu_dbs_info, cpu);
-
-	switch (event) {
-	case CPUFREQ_GOV_START:
-		if ((!cpu_online(cpu)) || (!policy->cur))
-			return -EINVAL;
-
-		mutex_lock(&dbs_mutex);
-		dbs_enable++;
-		for_each_cpu(j, policy->cpus) {
-			struct cpu_dbs_info_s *j_dbs_info;
-			j_dbs_info = &per_cpu(hp_cpu_dbs_info, j);
-			j_dbs_info->cur_policy = policy;
-
-			j_dbs_info->prev_cpu_idle = get_cpu_idle_time(j,
-						&j_dbs_info->prev_cpu_wall);
-			if (dbs_tuners_ins.ignore_nice) {
-				j_dbs_info->prev_cpu_nice = kstat_cpu(j).cpustat.nice;
-			}
-
-			max_periods = max(DEFAULT_HOTPLUG_IN_SAMPLING_PERIODS, DEFAULT_HOTPLUG_OUT_SAMPLING_PERIODS);
-			dbs_tuners_ins.hotplug_load_history = kmalloc((sizeof(unsigned int) * max_periods), GFP_KERNEL);
-			if (!dbs_tuners_ins.hotplug_load_history) {
-				WARN_ON(1);
-				return -ENOMEM;
-			}
-			for (i = 0; i < max_periods; i++)
-				dbs_tuners_ins.hotplug_load_history[i] = 50;
-		}
-		this_dbs_info->cpu = cpu;
-		this_dbs_info->freq_table = cpufreq_frequency_get_table(cpu);
-		/*
-		 * Start the timerschedule work, when this governor
-		 * is used for first time
-		 */
-		if (dbs_enable == 1) {
-			rc = sysfs_create_group(cpufreq_global_kobject, &dbs_attr_group);
-			if (rc) {
-				mutex_unlock(&dbs_mutex);
-				return rc;
-			}
-		}
-		mutex_unlock(&dbs_mutex);
+	struct cpu_dbs_info_s *dbs_info =
+		container_of(cdbs, struct cpu_dbs_info_s, cdbs);
 
-		mutex_init(&this_dbs_info->timer_mutex);
-		dbs_timer_init(this_dbs_info);
-		break;
+	dbs_info->freq_table = cpufreq_frequency_get_table(cdbs->cpu);
+}
 
-	case CPUFREQ_GOV_STOP:
-		dbs_timer_exit(this_dbs_info);
+static struct dbs_data hp_dbs_data = {
+	.attr_group = &dbs_attr_group,
+	.get_cpu_cdbs = get_cpu_cdbs,
+	.gov_dbs_timer = hp_dbs_timer,
+	.gov_init = hp_init,
+	.gov_exit = hp_exit,
+	.gov_start = hp_start,
+	.mutex = __MUTEX_INITIALIZER(hp_dbs_data.mutex),
+};
 
-		mutex_lock(&dbs_mutex);
-		mutex_destroy(&this_dbs_info->timer_mutex);
-		dbs_enable--;
-		mutex_unlock(&dbs_mutex);
-		if (!dbs_enable)
-			sysfs_remove_group(cpufreq_global_kobject, &dbs_attr_group);
-		kfree(dbs_tuners_ins.hotplug_load_history);
-		/*
-		 * **  BIG CAVEAT:    Stopping the governor with CPU1 offline will
-		 * result in it remaining offline until the user onlines it again.
-		 */
-		break;
-
-	case CPUFREQ_GOV_LIMITS:
-		mutex_lock(&this_dbs_info->timer_mutex);
-		if (policy->max < this_dbs_info->cur_policy->cur)
-			__cpufreq_driver_target(this_dbs_info->cur_policy, policy->max, CPUFREQ_RELATION_H);
-		else if (policy->min > this_dbs_info->cur_policy->cur)
-			__cpufreq_driver_target(this_dbs_info->cur_policy, policy->min, CPUFREQ_RELATION_L);
-		mutex_unlock(&this_dbs_info->timer_mutex);
-		break;
-	}
-	return 0;
+static int hp_cpufreq_governor_dbs(struct cpufreq_policy *policy,
+				   unsigned int event)
+{
+	return cpufreq_governor_dbs(&hp_dbs_data, policy, event);
 }
 
 static int __init cpufreq_gov_dbs_init(void)
@@ -684,6 +500,8 @@ static int __init cpufreq_gov_dbs_init(void)
 		pr_err("Creation of khotplug failed\n");
 		return -EFAULT;
 	}
+	hp_dbs_data.wq = khotplug_wq;
+
 	err = cpufreq_register_governor(&cpufreq_gov_hotplug);
 	if (err)
 		destroy_workqueue(khotplug_wq);
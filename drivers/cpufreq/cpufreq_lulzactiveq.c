@@ -34,6 +34,8 @@
 #include <linux/suspend.h>
 #include <linux/slab.h>
 
+#include "cpufreq_governor.h"
+
 //a hack to make comparisons easier while having different structs in pegasusq and lulzactiveq
 #define hotplug_history hotplug_lulzq_history
 #define dvfs_workqueue dvfs_lulzq_workqueue
@@ -43,8 +45,6 @@
 
 #define LULZACTIVE_TUNER "gokhanmoral-robertobsc"
 
-static atomic_t active_count = ATOMIC_INIT(0);
-
 #ifdef MODULE
 #include <linux/kallsyms.h>
 static int (*gm_cpu_up)(unsigned int cpu);
@@ -61,6 +61,8 @@ static int (*gm_wake_up_process)(struct task_struct *tsk);
 #endif
 
 struct cpufreq_lulzactive_cpuinfo {
+	/* hotplug sampling, run by the common dbs code */
+	struct cpu_dbs_common_info cdbs;
 	struct timer_list cpu_timer;
 	int timer_idlecancel;
 	u64 time_in_idle;
@@ -79,20 +81,16 @@ struct cpufreq_lulzactive_cpuinfo {
 	unsigned int lulzfreq_table_size;
 	unsigned int target_freq;
 	int governor_enabled;
-	int cpu;
-	struct delayed_work work;
 	struct work_struct up_work;
 	struct work_struct down_work;
-	/*
-	 * percpu mutex that serializes governor limit change with
-	 * do_dbs_timer invocation. We do not want do_dbs_timer to run
-	 * when user is changing the governor or limits.
-	 */
-	struct mutex timer_mutex;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_lulzactive_cpuinfo, cpuinfo);
 
+define_get_cpu_dbs_routines(cpuinfo);
+
+static struct dbs_data lq_dbs_data;
+
 /* Workqueues handle frequency scaling */
 static struct task_struct *up_task;
 static struct workqueue_struct *down_wq;
@@ -334,7 +332,6 @@ struct cpufreq_governor cpufreq_gov_lulzactive = {
 
 struct workqueue_struct *dvfs_workqueue;
 static struct dbs_tuners {
-    unsigned int  hotplug_sampling_rate;
 	unsigned int cpu_up_rate;
 	unsigned int cpu_down_rate;
 	unsigned int up_nr_cpus;
@@ -342,10 +339,7 @@ static struct dbs_tuners {
 	unsigned int min_cpu_lock;
 	atomic_t hotplug_lock;
 	unsigned int dvfs_debug;
-	unsigned int ignore_nice;
-
 } dbs_tuners_ins = {
-	.hotplug_sampling_rate=DEF_SAMPLING_RATE,
 	.cpu_up_rate = DEF_CPU_UP_RATE,
 	.cpu_down_rate = DEF_CPU_DOWN_RATE,
 	.up_nr_cpus = DEF_UP_NR_CPUS,
@@ -353,9 +347,6 @@ static struct dbs_tuners {
 	.min_cpu_lock = DEF_MIN_CPU_LOCK,
 	.hotplug_lock = ATOMIC_INIT(0),
 	.dvfs_debug = 0,
-	.ignore_nice = 0,
-#ifdef CONFIG_HAS_EARLYSUSPEND
-#endif
 };
 
 static unsigned int get_lulzfreq_table_size(struct cpufreq_lulzactive_cpuinfo *pcpu) {
@@ -465,7 +456,7 @@ static void cpufreq_lulzactive_timer(unsigned long data)
 	if (delta_time < 1000)
 		goto rearm;
 
-	if (dbs_tuners_ins.ignore_nice) {
+	if (lq_dbs_data.tuners.ignore_nice) {
 
 		cur_nice = cputime64_sub(kstat_cpu(data).cpustat.nice,
 					 pcpu->idle_prev_cpu_nice);
@@ -495,7 +486,7 @@ static void cpufreq_lulzactive_timer(unsigned long data)
 	delta_time = (unsigned int) cputime64_sub(pcpu->timer_run_time,
 						  pcpu->freq_change_time);
 
-	if (dbs_tuners_ins.ignore_nice) {
+	if (lq_dbs_data.tuners.ignore_nice) {
 
 		cur_nice = cputime64_sub(kstat_cpu(data).cpustat.nice,
 					 pcpu->freq_change_prev_cpu_nice);
@@ -622,7 +613,7 @@ static void cpufreq_lulzactive_timer(unsigned long data)
 
 		pcpu->freq_change_time_in_idle = get_cpu_idle_time_us(data, &pcpu->freq_change_time);
 
-		if (dbs_tuners_ins.ignore_nice)
+		if (lq_dbs_data.tuners.ignore_nice)
 			pcpu->freq_change_prev_cpu_nice = kstat_cpu(data).cpustat.nice;
 	}
 
@@ -726,7 +717,7 @@ rearm:
 
 		pcpu->time_in_idle = get_cpu_idle_time_us(
 			data, &pcpu->idle_exit_time);
-		if (dbs_tuners_ins.ignore_nice)
+		if (lq_dbs_data.tuners.ignore_nice)
 			pcpu->idle_prev_cpu_nice = kstat_cpu(data).cpustat.nice;
 		mod_timer(&pcpu->cpu_timer,
 			  jiffies + get_jiffies_normalized(timer_rate));
@@ -766,7 +757,7 @@ static void cpufreq_lulzactive_idle_start(void)
 			pcpu->time_in_idle = get_cpu_idle_time_us(
 				smp_processor_id(), &pcpu->idle_exit_time);
 			pcpu->timer_idlecancel = 0;
-			if (dbs_tuners_ins.ignore_nice)
+			if (lq_dbs_data.tuners.ignore_nice)
 				pcpu->idle_prev_cpu_nice = kstat_cpu(smp_processor_id()).cpustat.nice;
 			mod_timer(&pcpu->cpu_timer,
 				  jiffies + get_jiffies_normalized(timer_rate));
@@ -819,7 +810,7 @@ static void cpufreq_lulzactive_idle_end(void)
 			get_cpu_idle_time_us(smp_processor_id(),
 					     &pcpu->idle_exit_time);
 		pcpu->timer_idlecancel = 0;
-		if (dbs_tuners_ins.ignore_nice)
+		if (lq_dbs_data.tuners.ignore_nice)
 			pcpu->idle_prev_cpu_nice = kstat_cpu(smp_processor_id()).cpustat.nice;
 		mod_timer(&pcpu->cpu_timer,
 			  jiffies + get_jiffies_normalized(timer_rate));
@@ -1242,7 +1233,7 @@ static void apply_hotplug_lock(void)
 	pr_debug("%s online %d possible %d lock %d flag %d %d\n",
 		 __func__, online, possible, lock, flag, (int)abs(flag));
 
-	queue_work_on(dbs_info->cpu, dvfs_workqueue, work);
+	queue_work_on(dbs_info->cdbs.cpu, dvfs_workqueue, work);
 }
 
 int cpufreq_lulzactiveq_cpu_lock(int num_core)
@@ -1293,7 +1284,7 @@ void cpufreq_lulzactiveq_min_cpu_lock(unsigned int num_core)
 	flag = (int)num_core - online;
 	if (flag <= 0)
 		return;
-	queue_work_on(dbs_info->cpu, dvfs_workqueue, &dbs_info->up_work);
+	queue_work_on(dbs_info->cdbs.cpu, dvfs_workqueue, &dbs_info->up_work);
 }
 
 void cpufreq_lulzactiveq_min_cpu_unlock(void)
@@ -1311,7 +1302,7 @@ void cpufreq_lulzactiveq_min_cpu_unlock(void)
 	flag = lock - online;
 	if (flag >= 0)
 		return;
-	queue_work_on(dbs_info->cpu, dvfs_workqueue, &dbs_info->down_work);
+	queue_work_on(dbs_info->cdbs.cpu, dvfs_workqueue, &dbs_info->down_work);
 }
 
 /*
@@ -1339,7 +1330,15 @@ static ssize_t show_##file_name						\
 	return sprintf(buf, "%u\n", dbs_tuners_ins.object);		\
 }
 
-show_one(hotplug_sampling_rate,hotplug_sampling_rate);
+declare_dbs_common_attrs(lq_dbs_data);
+
+/* hotplug_sampling_rate is the old name of sampling_rate */
+static ssize_t show_hotplug_sampling_rate(struct kobject *kobj,
+					  struct attribute *attr, char *buf)
+{
+	return show_sampling_rate(kobj, attr, buf);
+}
+
 show_one(cpu_up_rate, cpu_up_rate);
 show_one(cpu_down_rate, cpu_down_rate);
 #ifndef CONFIG_CPU_EXYNOS4210
@@ -1348,7 +1347,6 @@ show_one(up_nr_cpus, up_nr_cpus);
 show_one(max_cpu_lock, max_cpu_lock);
 show_one(min_cpu_lock, min_cpu_lock);
 show_one(dvfs_debug, dvfs_debug);
-show_one(ignore_nice_load, ignore_nice);
 static ssize_t show_hotplug_lock(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
@@ -1433,15 +1431,7 @@ define_one_global_rw(hotplug_rq_4_0);
 static ssize_t store_hotplug_sampling_rate(struct kobject *a, struct attribute *b,
 				const char *buf, size_t count)
 {
-	unsigned int input;
-	int ret;
-
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-    dbs_tuners_ins.hotplug_sampling_rate = input; //, MIN_SAMPLING_RATE);
-	return count;
+	return store_sampling_rate(a, b, buf, count);
 }
 static ssize_t store_cpu_up_rate(struct kobject *a, struct attribute *b,
 				 const char *buf, size_t count)
@@ -1552,26 +1542,6 @@ static ssize_t store_dvfs_debug(struct kobject *a, struct attribute *b,
 	dbs_tuners_ins.dvfs_debug = input > 0;
 	return count;
 }
-static ssize_t store_ignore_nice_load(struct kobject *a, struct attribute *b,
-				      const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-	if (input > 1)
-		input = 1;
-
-	if (input == dbs_tuners_ins.ignore_nice) { /* nothing to do */
-		return count;
-	}
-	dbs_tuners_ins.ignore_nice = input;
-
-	return count;
-}
 
 define_one_global_rw(hotplug_sampling_rate);
 #ifndef CONFIG_CPU_EXYNOS4210
@@ -1583,7 +1553,6 @@ define_one_global_rw(hotplug_lock);
 define_one_global_rw(dvfs_debug);
 define_one_global_rw(cpu_up_rate);
 define_one_global_rw(cpu_down_rate);
-define_one_global_rw(ignore_nice_load);
 
 static struct attribute *lulzactive_attributes[] = {
 	&hispeed_freq_attr.attr,
@@ -1596,9 +1565,12 @@ static struct attribute *lulzactive_attributes[] = {
 	&screen_off_min_step_attr.attr,
 	&debug_mode_attr.attr,
 	&ignore_nice_load.attr,
+	&io_is_busy.attr,
 
     /*hotplug attributes*/
 
+	&sampling_rate.attr,
+	&sampling_rate_min.attr,
     &hotplug_sampling_rate.attr,
 	&cpu_up_rate.attr,
 	&cpu_down_rate.attr,
@@ -1835,71 +1807,105 @@ static int check_down(void)
 	return 0;
 }
 
-static void dbs_check_cpu(struct cpufreq_lulzactive_cpuinfo *this_dbs_info)
+static void lq_check_cpu(struct cpufreq_lulzactive_cpuinfo *this_dbs_info)
 {
 	struct cpufreq_policy *policy;
 	int num_hist = hotplug_history->num_hist;
 	int max_hotplug_rate = MAX_HOTPLUG_RATE;
+	unsigned int j;
 
-	policy = this_dbs_info->policy;
+	policy = this_dbs_info->cdbs.cur_policy;
+
+	/*
+	 * Frequency is chosen by the per-cpu timers; the common load is
+	 * only kept for the hotplug debug output.
+	 */
+	dbs_check_cpu(&lq_dbs_data, &this_dbs_info->cdbs);
 
 	hotplug_history->usage[num_hist].freq = policy->cur;
 	hotplug_history->usage[num_hist].rq_avg = get_nr_run_avg();
+	for_each_cpu(j, policy->cpus)
+		hotplug_history->usage[num_hist].load[j] =
+			get_cpu_cdbs(j)->load;
 	++hotplug_history->num_hist;
 
-	/* Check for CPU hotplug */
-	if (check_up()) {
-		queue_work_on(this_dbs_info->cpu, dvfs_workqueue,
+	/* Check for CPU hotplug, unless the hotplug manager owns it */
+	if (cpu_hotplug_mgr_enabled()) {
+		hotplug_history->num_hist = 0;
+	} else if (check_up()) {
+		queue_work_on(this_dbs_info->cdbs.cpu, dvfs_workqueue,
 			      &this_dbs_info->up_work);
 	} else if (check_down()) {
-		queue_work_on(this_dbs_info->cpu, dvfs_workqueue,
+		queue_work_on(this_dbs_info->cdbs.cpu, dvfs_workqueue,
 			      &this_dbs_info->down_work);
 	}
 	if (hotplug_history->num_hist  == max_hotplug_rate)
 		hotplug_history->num_hist = 0;
 }
 
-static void do_dbs_timer(struct work_struct *work)
+static unsigned int lq_dbs_timer(struct cpu_dbs_common_info *cdbs)
 {
-    struct cpufreq_lulzactive_cpuinfo *dbs_info =
-            container_of(work, struct cpufreq_lulzactive_cpuinfo, work.work);
-	unsigned int cpu = dbs_info->cpu;
-	int delay;
+	struct cpufreq_lulzactive_cpuinfo *dbs_info =
+		container_of(cdbs, struct cpufreq_lulzactive_cpuinfo, cdbs);
 
-	mutex_lock(&dbs_info->timer_mutex);
+	lq_check_cpu(dbs_info);
 
-	dbs_check_cpu(dbs_info);
-	/* We want all CPUs to do sampling nearly on
-	 * same jiffy
-	 */
-    delay = usecs_to_jiffies(dbs_tuners_ins.hotplug_sampling_rate);
+	return dbs_sampling_delay(&lq_dbs_data, 1);
+}
 
-	if (num_online_cpus() > 1)
-		delay -= jiffies % delay;
+static int lq_init(struct cpufreq_policy *policy)
+{
+	lq_dbs_data.min_sampling_rate = MIN_SAMPLING_RATE;
+	lq_dbs_data.tuners.sampling_rate = DEF_SAMPLING_RATE;
+	lq_dbs_data.tuners.io_is_busy = 0;
 
-	queue_delayed_work_on(cpu, dvfs_workqueue, &dbs_info->work, delay);
-	mutex_unlock(&dbs_info->timer_mutex);
+	start_lulzactiveq();
+	return 0;
 }
-static inline void hotplug_timer_init(struct cpufreq_lulzactive_cpuinfo *dbs_info)
+
+static void lq_exit(void)
 {
-	/* We want all CPUs to do sampling nearly on same jiffy */
-	int delay = usecs_to_jiffies(DEF_START_DELAY * 1000 * 1000
-            + dbs_tuners_ins.hotplug_sampling_rate);
-	if (num_online_cpus() > 1)
-		delay -= jiffies % delay;
+	stop_lulzactiveq();
+}
+
+static void lq_start(struct cpu_dbs_common_info *cdbs)
+{
+	struct cpufreq_lulzactive_cpuinfo *dbs_info =
+		container_of(cdbs, struct cpufreq_lulzactive_cpuinfo, cdbs);
+
+	hotplug_history->num_hist = 0;
+	start_rq_work();
 
-	INIT_DELAYED_WORK_DEFERRABLE(&dbs_info->work, do_dbs_timer);
 	INIT_WORK(&dbs_info->up_work, cpu_up_work);
 	INIT_WORK(&dbs_info->down_work, cpu_down_work);
+}
+
+static void lq_stop(struct cpu_dbs_common_info *cdbs)
+{
+	struct cpufreq_lulzactive_cpuinfo *dbs_info =
+		container_of(cdbs, struct cpufreq_lulzactive_cpuinfo, cdbs);
+
+	cancel_work_sync(&dbs_info->up_work);
+	cancel_work_sync(&dbs_info->down_work);
 
-	queue_delayed_work_on(dbs_info->cpu, dvfs_workqueue,
-			      &dbs_info->work, delay + 2 * HZ);
+	stop_rq_work();
 }
 
+static struct dbs_data lq_dbs_data = {
+	.attr_group = &lulzactive_attr_group,
+	.get_cpu_cdbs = get_cpu_cdbs,
+	.gov_dbs_timer = lq_dbs_timer,
+	.gov_init = lq_init,
+	.gov_exit = lq_exit,
+	.gov_start = lq_start,
+	.gov_stop = lq_stop,
+	.start_delay = (DEF_START_DELAY + 2) * HZ,
+	.mutex = __MUTEX_INITIALIZER(lq_dbs_data.mutex),
+};
+
 static int cpufreq_governor_lulzactive(struct cpufreq_policy *policy,
 		unsigned int event)
 {
-	int rc;
 	unsigned int j;
 	struct cpufreq_lulzactive_cpuinfo *pcpu;
 	struct cpufreq_frequency_table *freq_table;
@@ -1909,10 +1915,6 @@ static int cpufreq_governor_lulzactive(struct cpufreq_policy *policy,
 		if (!cpu_online(policy->cpu))
 			return -EINVAL;
 
-        /* init works and timer of each cpu */
-
-        hotplug_history->num_hist = 0;
-        start_rq_work();
 		freq_table =
 			cpufreq_frequency_get_table(policy->cpu);
 
@@ -1931,7 +1933,7 @@ static int cpufreq_governor_lulzactive(struct cpufreq_policy *policy,
 
 			// fix invalid screen_off_min_step
 			fix_screen_off_min_step(pcpu);
-			if (dbs_tuners_ins.ignore_nice) {
+			if (lq_dbs_data.tuners.ignore_nice) {
 				pcpu->freq_change_prev_cpu_nice =
 					kstat_cpu(j).cpustat.nice;
 			}
@@ -1940,33 +1942,14 @@ static int cpufreq_governor_lulzactive(struct cpufreq_policy *policy,
 		if (!hispeed_freq)
 			hispeed_freq = policy->max;
 
-		/*  starting hotplug */
-		pcpu = &per_cpu(cpuinfo, policy->cpu);
-		pcpu->cpu = policy->cpu;
-		mutex_init(&pcpu->timer_mutex);
-		hotplug_timer_init (pcpu);
 		/*
-		 * Do not register the idle hook and create sysfs
-		 * entries if we have already done so.
+		 * Hotplug sampling, the up task, the idle hook and the
+		 * sysfs entries are started by the common code; the
+		 * latter three only for the first policy.
 		 */
-		if (atomic_inc_return(&active_count) > 1)
-			return 0;
-        start_lulzactiveq();
-
-		rc = sysfs_create_group(cpufreq_global_kobject,
-				&lulzactive_attr_group);
-		if (rc)
-			return rc;
-
-		break;
+		return cpufreq_governor_dbs(&lq_dbs_data, policy, event);
 
 	case CPUFREQ_GOV_STOP:
-		/* finish works from each cpu */
-		pcpu = &per_cpu(cpuinfo, policy->cpu);
-		cancel_delayed_work_sync(&pcpu->work);
-		cancel_work_sync(&pcpu->up_work);
-		cancel_work_sync(&pcpu->down_work);
-		mutex_destroy(&pcpu->timer_mutex);
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
 			pcpu->governor_enabled = 0;
@@ -1983,23 +1966,12 @@ static int cpufreq_governor_lulzactive(struct cpufreq_policy *policy,
 		}
 
 		flush_work(&freq_scale_down_work);
-        stop_rq_work();
-		if (atomic_dec_return(&active_count) > 0)
-			return 0;
 
-		sysfs_remove_group(cpufreq_global_kobject,
-				&lulzactive_attr_group);
-        stop_lulzactiveq();
-		break;
+		/* timers are gone, the up task can go with the last policy */
+		return cpufreq_governor_dbs(&lq_dbs_data, policy, event);
 
 	case CPUFREQ_GOV_LIMITS:
-		if (policy->max < policy->cur)
-			__cpufreq_driver_target(policy,
-					policy->max, CPUFREQ_RELATION_H);
-		else if (policy->min > policy->cur)
-			__cpufreq_driver_target(policy,
-					policy->min, CPUFREQ_RELATION_L);
-		break;
+		return cpufreq_governor_dbs(&lq_dbs_data, policy, event);
 	}
 	return 0;
 }
@@ -2126,6 +2098,7 @@ static int __init cpufreq_lulzactive_init(void)
 		ret = -ENOMEM;
 		goto err_freeuptask;
 	}
+	lq_dbs_data.wq = dvfs_workqueue;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
@@ -31,6 +31,8 @@
 #include <linux/suspend.h>
 #include <linux/reboot.h>
 
+#include "cpufreq_governor.h"
+
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #undef CONFIG_HAS_EARLYSUSPEND
 #endif
@@ -202,61 +204,36 @@ static int hotplug_freq[4][2] = {
 	{800000, 0}
 };
 
-static unsigned int min_sampling_rate;
-
-static void do_dbs_timer(struct work_struct *work);
-static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
-				unsigned int event);
+static int pq_cpufreq_governor_dbs(struct cpufreq_policy *policy,
+				   unsigned int event);
 
 #ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_PEGASUSQ
 static
 #endif
 struct cpufreq_governor cpufreq_gov_pegasusq = {
 	.name                   = "pegasusq",
-	.governor               = cpufreq_governor_dbs,
+	.governor               = pq_cpufreq_governor_dbs,
 	.owner                  = THIS_MODULE,
 };
 
-/* Sampling types */
-enum {DBS_NORMAL_SAMPLE, DBS_SUB_SAMPLE};
-
 struct cpu_dbs_info_s {
-	cputime64_t prev_cpu_idle;
-	cputime64_t prev_cpu_iowait;
-	cputime64_t prev_cpu_wall;
-	cputime64_t prev_cpu_nice;
-	struct cpufreq_policy *cur_policy;
-	struct delayed_work work;
+	struct cpu_dbs_common_info cdbs;
 	struct work_struct up_work;
 	struct work_struct down_work;
-	struct cpufreq_frequency_table *freq_table;
 	unsigned int rate_mult;
-	int cpu;
-	/*
-	 * percpu mutex that serializes governor limit change with
-	 * do_dbs_timer invocation. We do not want do_dbs_timer to run
-	 * when user is changing the governor or limits.
-	 */
-	struct mutex timer_mutex;
 };
 static DEFINE_PER_CPU(struct cpu_dbs_info_s, od_cpu_dbs_info);
 
-struct workqueue_struct *dvfs_workqueue;
+define_get_cpu_dbs_routines(od_cpu_dbs_info);
 
-static unsigned int dbs_enable;	/* number of CPUs using this policy */
+static struct dbs_data pq_dbs_data;
 
-/*
- * dbs_mutex protects dbs_enable in governor start/stop.
- */
-static DEFINE_MUTEX(dbs_mutex);
+struct workqueue_struct *dvfs_workqueue;
 
 static struct dbs_tuners {
-	unsigned int sampling_rate;
 	unsigned int up_threshold;
 	unsigned int down_differential;
-	unsigned int ignore_nice;
 	unsigned int sampling_down_factor;
-	unsigned int io_is_busy;
 	/* pegasusq tuners */
 	unsigned int freq_step;
 	unsigned int cpu_up_rate;
@@ -279,8 +256,6 @@ static struct dbs_tuners {
 	.up_threshold = DEF_FREQUENCY_UP_THRESHOLD,
 	.sampling_down_factor = DEF_SAMPLING_DOWN_FACTOR,
 	.down_differential = DEF_FREQUENCY_DOWN_DIFFERENTIAL,
-	.ignore_nice = 0,
-	.io_is_busy = 1,
 	.freq_step = DEF_FREQ_STEP,
 	.cpu_up_rate = DEF_CPU_UP_RATE,
 	.cpu_down_rate = DEF_CPU_DOWN_RATE,
@@ -322,7 +297,7 @@ static void apply_hotplug_lock(void)
 
 	work = flag > 0 ? &dbs_info->up_work : &dbs_info->down_work;
 
-	queue_work_on(dbs_info->cpu, dvfs_workqueue, work);
+	queue_work_on(dbs_info->cdbs.cpu, dvfs_workqueue, work);
 }
 
 int cpufreq_pegasusq_cpu_lock(int num_core)
@@ -373,7 +348,7 @@ void cpufreq_pegasusq_min_cpu_lock(unsigned int num_core)
 	flag = (int)num_core - online;
 	if (flag <= 0)
 		return;
-	queue_work_on(dbs_info->cpu, dvfs_workqueue, &dbs_info->up_work);
+	queue_work_on(dbs_info->cdbs.cpu, dvfs_workqueue, &dbs_info->up_work);
 }
 
 void cpufreq_pegasusq_min_cpu_unlock(void)
@@ -391,7 +366,7 @@ void cpufreq_pegasusq_min_cpu_unlock(void)
 	flag = lock - online;
 	if (flag >= 0)
 		return;
-	queue_work_on(dbs_info->cpu, dvfs_workqueue, &dbs_info->down_work);
+	queue_work_on(dbs_info->cdbs.cpu, dvfs_workqueue, &dbs_info->down_work);
 }
 
 /*
@@ -411,56 +386,9 @@ struct cpu_usage_history {
 
 struct cpu_usage_history *hotplug_history;
 
-static inline cputime64_t get_cpu_idle_time_jiffy(unsigned int cpu, cputime64_t *wall)
-{
-	cputime64_t idle_time;
-	cputime64_t cur_wall_time;
-	cputime64_t busy_time;
-
-	cur_wall_time = jiffies64_to_cputime64(get_jiffies_64());
-	busy_time = cputime64_add(kstat_cpu(cpu).cpustat.user,
-				  kstat_cpu(cpu).cpustat.system);
-
-	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.irq);
-	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.softirq);
-	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.steal);
-	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.nice);
-
-	idle_time = cputime64_sub(cur_wall_time, busy_time);
-	if (wall)
-		*wall = (cputime64_t)jiffies_to_usecs(cur_wall_time);
-
-	return (cputime64_t)jiffies_to_usecs(idle_time);
-}
-
-static inline cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall)
-{
-	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
-
-	if (idle_time == -1ULL)
-		return get_cpu_idle_time_jiffy(cpu, wall);
-
-	return idle_time;
-}
-
-static inline cputime64_t get_cpu_iowait_time(unsigned int cpu, cputime64_t *wall)
-{
-	u64 iowait_time = get_cpu_iowait_time_us(cpu, wall);
-
-	if (iowait_time == -1ULL)
-		return 0;
-
-	return iowait_time;
-}
-
 /************************** sysfs interface ************************/
 
-static ssize_t show_sampling_rate_min(struct kobject *kobj, struct attribute *attr, char *buf)
-{
-	return sprintf(buf, "%u\n", min_sampling_rate);
-}
-
-define_one_global_ro(sampling_rate_min);
+declare_dbs_common_attrs(pq_dbs_data);
 
 /* cpufreq_pegasusq Governor Tunables */
 #define show_one(file_name, object)					\
@@ -469,11 +397,8 @@ static ssize_t show_##file_name						\
 {									\
 	return sprintf(buf, "%u\n", dbs_tuners_ins.object);		\
 }
-show_one(sampling_rate, sampling_rate);
-show_one(io_is_busy, io_is_busy);
 show_one(up_threshold, up_threshold);
 show_one(sampling_down_factor, sampling_down_factor);
-show_one(ignore_nice_load, ignore_nice);
 show_one(down_differential, down_differential);
 show_one(freq_step, freq_step);
 show_one(cpu_up_rate, cpu_up_rate);
@@ -554,32 +479,6 @@ define_one_global_rw(hotplug_rq_3_0);
 define_one_global_rw(hotplug_rq_3_1);
 define_one_global_rw(hotplug_rq_4_0);
 
-static ssize_t store_sampling_rate(struct kobject *a, struct attribute *b,
-				   const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-	dbs_tuners_ins.sampling_rate = max(input, min_sampling_rate);
-	return count;
-}
-
-static ssize_t store_io_is_busy(struct kobject *a, struct attribute *b,
-				const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-	dbs_tuners_ins.io_is_busy = !!input;
-	return count;
-}
-
 static ssize_t store_up_threshold(struct kobject *a, struct attribute *b,
 				  const char *buf, size_t count)
 {
@@ -616,38 +515,6 @@ static ssize_t store_sampling_down_factor(struct kobject *a,
 	return count;
 }
 
-static ssize_t store_ignore_nice_load(struct kobject *a, struct attribute *b,
-				      const char *buf, size_t count)
-{
-	unsigned int input;
-	int ret;
-
-	unsigned int j;
-
-	ret = sscanf(buf, "%u", &input);
-	if (ret != 1)
-		return -EINVAL;
-
-	if (input > 1)
-		input = 1;
-
-	if (input == dbs_tuners_ins.ignore_nice) { /* nothing to do */
-		return count;
-	}
-	dbs_tuners_ins.ignore_nice = input;
-
-	/* we need to re-evaluate prev_cpu_idle */
-	for_each_online_cpu(j) {
-		struct cpu_dbs_info_s *dbs_info;
-		dbs_info = &per_cpu(od_cpu_dbs_info, j);
-		dbs_info->prev_cpu_idle =
-			get_cpu_idle_time(j, &dbs_info->prev_cpu_wall);
-		if (dbs_tuners_ins.ignore_nice)
-			dbs_info->prev_cpu_nice = kstat_cpu(j).cpustat.nice;
-	}
-	return count;
-}
-
 static ssize_t store_down_differential(struct kobject *a, struct attribute *b,
 				       const char *buf, size_t count)
 {
@@ -831,11 +698,8 @@ static ssize_t store_freq_for_responsiveness(struct kobject *a, struct attribute
 	return count;
 }
 
-define_one_global_rw(sampling_rate);
-define_one_global_rw(io_is_busy);
 define_one_global_rw(up_threshold);
 define_one_global_rw(sampling_down_factor);
-define_one_global_rw(ignore_nice_load);
 define_one_global_rw(down_differential);
 define_one_global_rw(freq_step);
 define_one_global_rw(cpu_up_rate);
@@ -1094,7 +958,7 @@ static int check_down(void)
 	return 0;
 }
 
-static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
+static void pq_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 {
 	unsigned int max_load_freq;
 
@@ -1108,9 +972,8 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	/* add total_load, avg_load to get average load */
 	unsigned int total_load = 0;
 	unsigned int avg_load = 0;
-	int load_each[4] = {-1, -1, -1, -1};
 	int rq_avg = 0;
-	policy = this_dbs_info->cur_policy;
+	policy = this_dbs_info->cdbs.cur_policy;
 
 	hotplug_history->usage[num_hist].freq = policy->cur;
 	hotplug_history->usage[num_hist].rq_avg = get_nr_run_avg();
@@ -1120,65 +983,18 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 
 	++hotplug_history->num_hist;
 
+	dbs_check_cpu(&pq_dbs_data, &this_dbs_info->cdbs);
+
 	/* Get Absolute Load - in terms of freq */
 	max_load_freq = 0;
 
 	for_each_cpu(j, policy->cpus) {
-		struct cpu_dbs_info_s *j_dbs_info;
-		cputime64_t cur_wall_time, cur_idle_time, cur_iowait_time;
-		cputime64_t prev_wall_time, prev_idle_time, prev_iowait_time;
-		unsigned int idle_time, wall_time, iowait_time;
 		unsigned int load, load_freq;
 		int freq_avg;
 
-		j_dbs_info = &per_cpu(od_cpu_dbs_info, j);
-		prev_wall_time = j_dbs_info->prev_cpu_wall;
-		prev_idle_time = j_dbs_info->prev_cpu_idle;
-		prev_iowait_time = j_dbs_info->prev_cpu_iowait;
-
-		cur_idle_time = get_cpu_idle_time(j, &cur_wall_time);
-		cur_iowait_time = get_cpu_iowait_time(j, &cur_wall_time);
-
-		wall_time = (unsigned int) cputime64_sub(cur_wall_time,
-							 prev_wall_time);
-		j_dbs_info->prev_cpu_wall = cur_wall_time;
-
-		idle_time = (unsigned int) cputime64_sub(cur_idle_time,
-							 prev_idle_time);
-		j_dbs_info->prev_cpu_idle = cur_idle_time;
-
-		iowait_time = (unsigned int) cputime64_sub(cur_iowait_time,
-							   prev_iowait_time);
-		j_dbs_info->prev_cpu_iowait = cur_iowait_time;
-
-		if (dbs_tuners_ins.ignore_nice) {
-			cputime64_t cur_nice;
-			unsigned long cur_nice_jiffies;
-
-			cur_nice = cputime64_sub(kstat_cpu(j).cpustat.nice,
-						 j_dbs_info->prev_cpu_nice);
-			/*
-			 * Assumption: nice time between sampling periods will
-			 * be less than 2^32 jiffies for 32 bit sys
-			 */
-			cur_nice_jiffies = (unsigned long)
-				cputime64_to_jiffies64(cur_nice);
-
-			j_dbs_info->prev_cpu_nice = kstat_cpu(j).cpustat.nice;
-			idle_time += jiffies_to_usecs(cur_nice_jiffies);
-		}
-
-		if (dbs_tuners_ins.io_is_busy && idle_time >= iowait_time)
-			idle_time -= iowait_time;
-
-		if (unlikely(!wall_time || wall_time < idle_time))
-			continue;
-
-		load = 100 * (wall_time - idle_time) / wall_time;
+		load = get_cpu_cdbs(j)->load;
 
 		/* keep load of each CPUs and combined load across all CPUs */
-		if (cpu_online(j))
-			load_each[j] = load;
 		total_load += load;
 
 		hotplug_history->usage[num_hist].load[j] = load;
@@ -1195,12 +1011,14 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	avg_load = total_load / num_online_cpus();
 	hotplug_history->usage[num_hist].avg_load = avg_load;
 
-	/* Check for CPU hotplug */
-	if (check_up()) {
-		queue_work_on(this_dbs_info->cpu, dvfs_workqueue,
+	/* Check for CPU hotplug, unless the hotplug manager owns it */
+	if (cpu_hotplug_mgr_enabled()) {
+		hotplug_history->num_hist = 0;
+	} else if (check_up()) {
+		queue_work_on(this_dbs_info->cdbs.cpu, dvfs_workqueue,
 			      &this_dbs_info->up_work);
 	} else if (check_down()) {
-		queue_work_on(this_dbs_info->cpu, dvfs_workqueue,
+		queue_work_on(this_dbs_info->cdbs.cpu, dvfs_workqueue,
 			      &this_dbs_info->down_work);
 	}
 	if (hotplug_history->num_hist  == max_hotplug_rate)
@@ -1280,50 +1098,14 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	}
 }
 
-static void do_dbs_timer(struct work_struct *work)
+static unsigned int pq_dbs_timer(struct cpu_dbs_common_info *cdbs)
 {
 	struct cpu_dbs_info_s *dbs_info =
-		container_of(work, struct cpu_dbs_info_s, work.work);
-	unsigned int cpu = dbs_info->cpu;
-	int delay;
+		container_of(cdbs, struct cpu_dbs_info_s, cdbs);
 
-	mutex_lock(&dbs_info->timer_mutex);
+	pq_check_cpu(dbs_info);
 
-	dbs_check_cpu(dbs_info);
-	/* We want all CPUs to do sampling nearly on
-	 * same jiffy
-	 */
-	delay = usecs_to_jiffies(dbs_tuners_ins.sampling_rate
-				 * dbs_info->rate_mult);
-
-	if (num_online_cpus() > 1)
-		delay -= jiffies % delay;
-
-	queue_delayed_work_on(cpu, dvfs_workqueue, &dbs_info->work, delay);
-	mutex_unlock(&dbs_info->timer_mutex);
-}
-
-static inline void dbs_timer_init(struct cpu_dbs_info_s *dbs_info)
-{
-	/* We want all CPUs to do sampling nearly on same jiffy */
-	int delay = usecs_to_jiffies(DEF_START_DELAY * 1000 * 1000
-				     + dbs_tuners_ins.sampling_rate);
-	if (num_online_cpus() > 1)
-		delay -= jiffies % delay;
-
-	INIT_DELAYED_WORK_DEFERRABLE(&dbs_info->work, do_dbs_timer);
-	INIT_WORK(&dbs_info->up_work, cpu_up_work);
-	INIT_WORK(&dbs_info->down_work, cpu_down_work);
-
-	queue_delayed_work_on(dbs_info->cpu, dvfs_workqueue,
-			      &dbs_info->work, delay + 2 * HZ);
-}
-
-static inline void dbs_timer_exit(struct cpu_dbs_info_s *dbs_info)
-{
-	cancel_delayed_work_sync(&dbs_info->work);
-	cancel_work_sync(&dbs_info->up_work);
-	cancel_work_sync(&dbs_info->down_work);
+	return dbs_sampling_delay(&pq_dbs_data, dbs_info->rate_mult);
 }
 
 static int reboot_notifier_call(struct notifier_block *this,
@@ -1348,9 +1130,9 @@ static void cpufreq_pegasusq_early_suspend(struct early_suspend *h)
 		atomic_read(&g_hotplug_lock);
 #endif
 	prev_freq_step = dbs_tuners_ins.freq_step;
-	prev_sampling_rate = dbs_tuners_ins.sampling_rate;
+	prev_sampling_rate = pq_dbs_data.tuners.sampling_rate;
 	dbs_tuners_ins.freq_step = 10;
-	dbs_tuners_ins.sampling_rate = 200000;
+	pq_dbs_data.tuners.sampling_rate = 200000;
 #if EARLYSUSPEND_HOTPLUGLOCK
 	atomic_set(&g_hotplug_lock,
 	    (dbs_tuners_ins.min_cpu_lock) ? dbs_tuners_ins.min_cpu_lock : 1);
@@ -1365,7 +1147,7 @@ static void cpufreq_pegasusq_late_resume(struct early_suspend *h)
 #endif
 	dbs_tuners_ins.early_suspend = -1;
 	dbs_tuners_ins.freq_step = prev_freq_step;
-	dbs_tuners_ins.sampling_rate = prev_sampling_rate;
+	pq_dbs_data.tuners.sampling_rate = prev_sampling_rate;
 #if EARLYSUSPEND_HOTPLUGLOCK
 	apply_hotplug_lock();
 	start_rq_work();
@@ -1373,116 +1155,69 @@ static void cpufreq_pegasusq_late_resume(struct early_suspend *h)
 }
 #endif
 
-static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
-				unsigned int event)
+static int pq_init(struct cpufreq_policy *policy)
 {
-	unsigned int cpu = policy->cpu;
-	struct cpu_dbs_info_s *this_dbs_info;
-	unsigned int j;
-	int rc;
-
-	this_dbs_info = &per_cpu(od_cpu_dbs_info, cpu);
+	pq_dbs_data.min_sampling_rate = MIN_SAMPLING_RATE;
+	pq_dbs_data.tuners.sampling_rate = DEF_SAMPLING_RATE;
+	pq_dbs_data.tuners.io_is_busy = 0;
 
-	switch (event) {
-	case CPUFREQ_GOV_START:
-		if ((!cpu_online(cpu)) || (!policy->cur))
-			return -EINVAL;
-
-		dbs_tuners_ins.max_freq = policy->max;
-		dbs_tuners_ins.min_freq = policy->min;
-		hotplug_history->num_hist = 0;
-		start_rq_work();
-
-		mutex_lock(&dbs_mutex);
-
-		dbs_enable++;
-		for_each_cpu(j, policy->cpus) {
-			struct cpu_dbs_info_s *j_dbs_info;
-			j_dbs_info = &per_cpu(od_cpu_dbs_info, j);
-			j_dbs_info->cur_policy = policy;
-
-			j_dbs_info->prev_cpu_idle = get_cpu_idle_time(j,
-				&j_dbs_info->prev_cpu_wall);
-			if (dbs_tuners_ins.ignore_nice) {
-				j_dbs_info->prev_cpu_nice =
-					kstat_cpu(j).cpustat.nice;
-			}
-		}
-		this_dbs_info->cpu = cpu;
-		this_dbs_info->rate_mult = 1;
-		/*
-		 * Start the timerschedule work, when this governor
-		 * is used for first time
-		 */
-		if (dbs_enable == 1) {
-			rc = sysfs_create_group(cpufreq_global_kobject,
-						&dbs_attr_group);
-			if (rc) {
-				mutex_unlock(&dbs_mutex);
-				return rc;
-			}
-
-			min_sampling_rate = MIN_SAMPLING_RATE;
-			dbs_tuners_ins.sampling_rate = DEF_SAMPLING_RATE;
-			dbs_tuners_ins.io_is_busy = 0;
-		}
-		mutex_unlock(&dbs_mutex);
-
-		register_reboot_notifier(&reboot_notifier);
-
-		mutex_init(&this_dbs_info->timer_mutex);
-		dbs_timer_init(this_dbs_info);
-
-#if !EARLYSUSPEND_HOTPLUGLOCK
-		register_pm_notifier(&pm_notifier);
-#endif
+	register_reboot_notifier(&reboot_notifier);
 #ifdef CONFIG_HAS_EARLYSUSPEND
-		register_early_suspend(&early_suspend);
+	register_early_suspend(&early_suspend);
 #endif
-		break;
+	return 0;
+}
 
-	case CPUFREQ_GOV_STOP:
+static void pq_exit(void)
+{
 #ifdef CONFIG_HAS_EARLYSUSPEND
-		unregister_early_suspend(&early_suspend);
+	unregister_early_suspend(&early_suspend);
 #endif
-#if !EARLYSUSPEND_HOTPLUGLOCK
-		unregister_pm_notifier(&pm_notifier);
-#endif
-
-		dbs_timer_exit(this_dbs_info);
-
-		mutex_lock(&dbs_mutex);
-		mutex_destroy(&this_dbs_info->timer_mutex);
+	unregister_reboot_notifier(&reboot_notifier);
+}
 
-		unregister_reboot_notifier(&reboot_notifier);
+static void pq_start(struct cpu_dbs_common_info *cdbs)
+{
+	struct cpu_dbs_info_s *dbs_info =
+		container_of(cdbs, struct cpu_dbs_info_s, cdbs);
 
-		dbs_enable--;
-		mutex_unlock(&dbs_mutex);
+	dbs_tuners_ins.max_freq = cdbs->cur_policy->max;
+	dbs_tuners_ins.min_freq = cdbs->cur_policy->min;
+	hotplug_history->num_hist = 0;
+	start_rq_work();
 
-		stop_rq_work();
+	dbs_info->rate_mult = 1;
+	INIT_WORK(&dbs_info->up_work, cpu_up_work);
+	INIT_WORK(&dbs_info->down_work, cpu_down_work);
+}
 
-		if (!dbs_enable)
-			sysfs_remove_group(cpufreq_global_kobject,
-					   &dbs_attr_group);
+static void pq_stop(struct cpu_dbs_common_info *cdbs)
+{
+	struct cpu_dbs_info_s *dbs_info =
+		container_of(cdbs, struct cpu_dbs_info_s, cdbs);
 
-		break;
+	cancel_work_sync(&dbs_info->up_work);
+	cancel_work_sync(&dbs_info->down_work);
 
-	case CPUFREQ_GOV_LIMITS:
-		mutex_lock(&this_dbs_info->timer_mutex);
+	stop_rq_work();
+}
 
-		if (policy->max < this_dbs_info->cur_policy->cur)
-			__cpufreq_driver_target(this_dbs_info->cur_policy,
-						policy->max,
-						CPUFREQ_RELATION_H);
-		else if (policy->min > this_dbs_info->cur_policy->cur)
-			__cpufreq_driver_target(this_dbs_info->cur_policy,
-						policy->min,
-						CPUFREQ_RELATION_L);
+static struct dbs_data pq_dbs_data = {
+	.attr_group = &dbs_attr_group,
+	.get_cpu_cdbs = get_cpu_cdbs,
+	.gov_dbs_timer = pq_dbs_timer,
+	.gov_init = pq_init,
+	.gov_exit = pq_exit,
+	.gov_start = pq_start,
+	.gov_stop = pq_stop,
+	.start_delay = (DEF_START_DELAY + 2) * HZ,
+	.mutex = __MUTEX_INITIALIZER(pq_dbs_data.mutex),
+};
 
-		mutex_unlock(&this_dbs_info->timer_mutex);
-		break;
-	}
-	return 0;
+static int pq_cpufreq_governor_dbs(struct cpufreq_policy *policy,
+				   unsigned int event)
+{
+	return cpufreq_governor_dbs(&pq_dbs_data, policy, event);
 }
 
 static int __init cpufreq_gov_dbs_init(void)
@@ -1504,6 +1239,7 @@ static int __init cpufreq_gov_dbs_init(void)
 		ret = -ENOMEM;
 		goto err_queue;
 	}
+	pq_dbs_data.wq = dvfs_workqueue;
 
 	ret = cpufreq_register_governor(&cpufreq_gov_pegasusq);
 	if (ret)
@@ -0,0 +1,490 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The 'sched' governor picks frequencies from the scheduler's
+ * utilization tracking instead of sampling idle time on a timer.  The
+ * scheduler reports a cpu's utilization at enqueue, dequeue and tick,
+ * and rt activity from the rt tick, with its runqueue lock held.
+ * Utilization is the fraction of time busy at the current frequency,
+ * so the new frequency is scaled from policy->cur.  A cpu running rt
+ * tasks asks for policy->max.  The decision is made there but the
+ * frequency change itself is handed to a kthread: a per-cpu hrtimer
+ * armed from scheduler context wakes it, since waking a task directly
+ * under a runqueue lock could deadlock.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/cpufreq.h>
+#include <linux/hrtimer.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+static atomic_t active_count = ATOMIC_INIT(0);
+
+struct cpufreq_sched_cpuinfo {
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned long util;
+	unsigned long util_stamp;
+	/* last rt tick, 0 once the rt tasks are gone */
+	unsigned long rt_stamp;
+	int governor_enabled;
+
+	/* only used on policy->cpu */
+	spinlock_t lock;
+	unsigned int target_freq;
+	u64 target_set_time;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_cpuinfo, cpuinfo);
+static DEFINE_PER_CPU(struct hrtimer, kick_timer);
+
+/* The kthread applies pending frequency changes */
+static struct task_struct *speedchange_task;
+static cpumask_t speedchange_cpumask;
+static spinlock_t speedchange_cpumask_lock;
+static struct mutex set_speed_lock;
+
+/*
+ * Utilization, in percent of capacity, that the chosen frequency
+ * should be loaded to.
+ */
+#define DEFAULT_TARGET_LOAD 80
+static unsigned long target_load;
+
+/* Minimum time between two frequency raises, and two drops */
+#define DEFAULT_UP_RATE_LIMIT (500)
+static unsigned long up_rate_limit_us;
+#define DEFAULT_DOWN_RATE_LIMIT (20 * USEC_PER_MSEC)
+static unsigned long down_rate_limit_us;
+
+/*
+ * A cpu that hasn't reported for this long is idle without a tick and
+ * doesn't get a say in the frequency of its policy.
+ */
+#define UTIL_STALE_JIFFIES 2
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+static unsigned int cpufreq_sched_policy_freq(struct cpufreq_policy *policy,
+		struct cpufreq_frequency_table *freq_table)
+{
+	unsigned long util = 0;
+	unsigned int freq, index, j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_sched_cpuinfo *pjcpu = &per_cpu(cpuinfo, j);
+
+		if (pjcpu->rt_stamp &&
+		    !time_after(jiffies, pjcpu->rt_stamp + UTIL_STALE_JIFFIES)) {
+			policy->load = 100;
+			return policy->max;
+		}
+		if (time_after(jiffies, pjcpu->util_stamp + UTIL_STALE_JIFFIES))
+			continue;
+		if (pjcpu->util > util)
+			util = pjcpu->util;
+	}
+
+	/*
+	 * util is how busy the cpu was at the frequency it ran at, not a
+	 * share of its capacity at policy->max.
+	 */
+	policy->load = util * 100 / SCHED_LOAD_SCALE;
+	freq = div_u64((u64)policy->cur * util * 100,
+		       SCHED_LOAD_SCALE * target_load);
+
+	if (cpufreq_frequency_table_target(policy, freq_table, freq,
+					   CPUFREQ_RELATION_L, &index))
+		return policy->cur;
+
+	return freq_table[index].frequency;
+}
+
+static enum hrtimer_restart cpufreq_sched_kick_timer(struct hrtimer *timer)
+{
+	struct task_struct *task = ACCESS_ONCE(speedchange_task);
+
+	if (task)
+		wake_up_process(task);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Queue policy_cpu for the kthread.  Runs under a runqueue lock, so
+ * wake the kthread from a timer on this cpu rather than directly.
+ */
+static void cpufreq_sched_kick(unsigned int policy_cpu)
+{
+	struct hrtimer *timer = &__get_cpu_var(kick_timer);
+
+	spin_lock(&speedchange_cpumask_lock);
+	cpumask_set_cpu(policy_cpu, &speedchange_cpumask);
+	spin_unlock(&speedchange_cpumask_lock);
+
+	if (!hrtimer_is_queued(timer))
+		__hrtimer_start_range_ns(timer, ns_to_ktime(0), 0,
+					 HRTIMER_MODE_REL_PINNED, 0);
+}
+
+static void cpufreq_sched_update(struct cpufreq_sched_cpuinfo *pcpu)
+{
+	struct cpufreq_sched_cpuinfo *ppol;
+	unsigned int freq;
+	u64 now;
+
+	ppol = &per_cpu(cpuinfo, pcpu->policy->cpu);
+	spin_lock(&ppol->lock);
+
+	freq = cpufreq_sched_policy_freq(pcpu->policy, ppol->freq_table);
+	if (freq == ppol->target_freq)
+		goto out;
+
+	now = ktime_to_us(ktime_get());
+	if (now - ppol->target_set_time < (freq > ppol->target_freq ?
+					   up_rate_limit_us :
+					   down_rate_limit_us))
+		goto out;
+
+	ppol->target_freq = freq;
+	ppol->target_set_time = now;
+	cpufreq_sched_kick(pcpu->policy->cpu);
+out:
+	spin_unlock(&ppol->lock);
+}
+
+void cpufreq_sched_update_util(int cpu, unsigned long util)
+{
+	struct cpufreq_sched_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+
+	if (!pcpu->governor_enabled)
+		return;
+	smp_rmb();
+
+	pcpu->util = util;
+	pcpu->util_stamp = jiffies;
+	cpufreq_sched_update(pcpu);
+}
+
+/*
+ * Fair utilization doesn't see rt tasks, and a cpu kept busy by them
+ * would stop reporting and be dropped as stale.  The rt tick keeps such
+ * a cpu at policy->max instead; short rt bursts that never see a tick
+ * don't raise the frequency.
+ */
+void cpufreq_sched_update_rt(int cpu, bool running)
+{
+	struct cpufreq_sched_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+
+	if (!pcpu->governor_enabled)
+		return;
+	smp_rmb();
+
+	if (running) {
+		pcpu->rt_stamp = jiffies;
+	} else {
+		if (!pcpu->rt_stamp)
+			return;
+		pcpu->rt_stamp = 0;
+	}
+	cpufreq_sched_update(pcpu);
+}
+
+static int cpufreq_sched_speedchange_task(void *data)
+{
+	unsigned int cpu;
+	cpumask_t tmp_mask;
+	unsigned long flags;
+	struct cpufreq_sched_cpuinfo *pcpu;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+
+		if (cpumask_empty(&speedchange_cpumask)) {
+			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+					       flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = speedchange_cpumask;
+		cpumask_clear(&speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask) {
+			unsigned int freq;
+
+			pcpu = &per_cpu(cpuinfo, cpu);
+			smp_rmb();
+
+			if (!pcpu->governor_enabled)
+				continue;
+
+			mutex_lock(&set_speed_lock);
+
+			spin_lock_irqsave(&pcpu->lock, flags);
+			freq = pcpu->target_freq;
+			spin_unlock_irqrestore(&pcpu->lock, flags);
+
+			if (freq != pcpu->policy->cur)
+				__cpufreq_driver_target(pcpu->policy, freq,
+							CPUFREQ_RELATION_L);
+			mutex_unlock(&set_speed_lock);
+		}
+	}
+
+	return 0;
+}
+
+static ssize_t show_target_load(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", target_load);
+}
+
+static ssize_t store_target_load(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (val < 1 || val > 100)
+		return -EINVAL;
+	target_load = val;
+	return count;
+}
+
+static struct global_attr target_load_attr = __ATTR(target_load, 0644,
+		show_target_load, store_target_load);
+
+static ssize_t show_up_rate_limit_us(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", up_rate_limit_us);
+}
+
+static ssize_t store_up_rate_limit_us(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	up_rate_limit_us = val;
+	return count;
+}
+
+static struct global_attr up_rate_limit_us_attr = __ATTR(up_rate_limit_us,
+		0644, show_up_rate_limit_us, store_up_rate_limit_us);
+
+static ssize_t show_down_rate_limit_us(struct kobject *kobj,
+				       struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", down_rate_limit_us);
+}
+
+static ssize_t store_down_rate_limit_us(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	down_rate_limit_us = val;
+	return count;
+}
+
+static struct global_attr down_rate_limit_us_attr = __ATTR(down_rate_limit_us,
+		0644, show_down_rate_limit_us, store_down_rate_limit_us);
+
+static struct attribute *sched_attributes[] = {
+	&target_load_attr.attr,
+	&up_rate_limit_us_attr.attr,
+	&down_rate_limit_us_attr.attr,
+	NULL,
+};
+
+static struct attribute_group sched_attr_group = {
+	.attrs = sched_attributes,
+	.name = "sched",
+};
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	int rc;
+	unsigned int j;
+	unsigned long flags;
+	struct cpufreq_sched_cpuinfo *pcpu;
+	struct cpufreq_frequency_table *freq_table;
+	struct task_struct *task;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu))
+			return -EINVAL;
+
+		freq_table = cpufreq_frequency_get_table(policy->cpu);
+		if (!freq_table)
+			return -EINVAL;
+
+		if (atomic_inc_return(&active_count) == 1) {
+			speedchange_task =
+				kthread_create(cpufreq_sched_speedchange_task,
+					       NULL, "ksched_freq");
+			if (IS_ERR(speedchange_task)) {
+				rc = PTR_ERR(speedchange_task);
+				speedchange_task = NULL;
+				atomic_dec(&active_count);
+				return rc;
+			}
+
+			sched_setscheduler_nocheck(speedchange_task,
+						   SCHED_FIFO, &param);
+			get_task_struct(speedchange_task);
+			wake_up_process(speedchange_task);
+
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&sched_attr_group);
+			if (rc)
+				pr_warn("%s: failed to create sysfs group\n",
+					__func__);
+		}
+
+		pcpu = &per_cpu(cpuinfo, policy->cpu);
+		spin_lock_irqsave(&pcpu->lock, flags);
+		pcpu->target_freq = policy->cur;
+		pcpu->target_set_time = 0;
+		spin_unlock_irqrestore(&pcpu->lock, flags);
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->policy = policy;
+			pcpu->freq_table = freq_table;
+			pcpu->util = 0;
+			pcpu->util_stamp = jiffies;
+			pcpu->rt_stamp = 0;
+			smp_wmb();
+			pcpu->governor_enabled = 1;
+		}
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->governor_enabled = 0;
+			smp_wmb();
+		}
+
+		/*
+		 * The updaters run from the scheduler with preemption
+		 * disabled; wait for any that still saw the governor
+		 * enabled, so none can kick the timer from here on.
+		 */
+		synchronize_sched();
+
+		if (atomic_dec_return(&active_count) > 0)
+			return 0;
+
+		sysfs_remove_group(cpufreq_global_kobject, &sched_attr_group);
+
+		/* hrtimer_cancel() waits for a callback still using it */
+		task = speedchange_task;
+		speedchange_task = NULL;
+		smp_wmb();
+		for_each_possible_cpu(j)
+			hrtimer_cancel(&per_cpu(kick_timer, j));
+
+		kthread_stop(task);
+		put_task_struct(task);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&set_speed_lock);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&set_speed_lock);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_sched_init(void)
+{
+	unsigned int i;
+
+	target_load = DEFAULT_TARGET_LOAD;
+	up_rate_limit_us = DEFAULT_UP_RATE_LIMIT;
+	down_rate_limit_us = DEFAULT_DOWN_RATE_LIMIT;
+
+	for_each_possible_cpu(i) {
+		struct hrtimer *timer = &per_cpu(kick_timer, i);
+
+		spin_lock_init(&per_cpu(cpuinfo, i).lock);
+		hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		timer->function = cpufreq_sched_kick_timer;
+	}
+
+	spin_lock_init(&speedchange_cpumask_lock);
+	mutex_init(&set_speed_lock);
+
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
+
+MODULE_DESCRIPTION("'cpufreq_sched' - A cpufreq governor driven by "
+	"scheduler utilization");
+MODULE_LICENSE("GPL");
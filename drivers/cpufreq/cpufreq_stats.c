@@ -20,10 +20,34 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/ktime.h>
 #include <asm/cputime.h>
 
+#include <trace/events/cpufreq.h>
+
 static spinlock_t cpufreq_stats_lock;
 
+#ifdef CONFIG_CPU_FREQ_STAT_DEBUGFS
+/* transition latency buckets: <16us, <32us, ... <8192us, >=8192us */
+#define LAT_BUCKETS		11
+#define LAT_BUCKET_SHIFT	4
+/* governor requests kept in the decision log */
+#define NR_DECISIONS		128
+
+struct cpufreq_decision {
+	u64 time;		/* ns */
+	unsigned int load;
+	unsigned int old;
+	unsigned int requested;
+	unsigned int granted;
+	unsigned int latency_us;
+	int ret;
+};
+#endif
+
 #define CPUFREQ_STATDEVICE_ATTR(_name, _mode, _show) \
 static struct freq_attr _attr_##_name = {\
 	.attr = {.name = __stringify(_name), .mode = _mode, }, \
@@ -42,6 +66,14 @@ struct cpufreq_stats {
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
 #endif
+#ifdef CONFIG_CPU_FREQ_STAT_DEBUGFS
+	unsigned int *lat_hist;		/* [new state][LAT_BUCKETS] */
+	unsigned int *req_table;	/* [requested state][granted state] */
+	unsigned int clamped;		/* requests the driver did not grant */
+	unsigned int nr_decisions;
+	struct cpufreq_decision *decisions;
+	struct dentry *debugfs_dir;
+#endif
 };
 
 static DEFINE_PER_CPU(struct cpufreq_stats *, cpufreq_stats_table);
@@ -165,17 +197,247 @@ static int freq_table_get_index(struct cpufreq_stats *stat, unsigned int freq)
 	return -1;
 }
 
+#ifdef CONFIG_CPU_FREQ_STAT_DEBUGFS
+static struct dentry *cpufreq_stats_debugfs_root;
+
+/*
+ * Called by the cpufreq core after every call into the driver's
+ * target().  The request is resolved against the frequency table the
+ * same way the driver does it, so it only counts as clamped when the
+ * driver settled on something else, e.g. because of a thermal or
+ * screen off limit.
+ */
+static void cpufreq_stats_target_probe(void *data,
+		struct cpufreq_policy *policy, unsigned int target_freq,
+		unsigned int relation, unsigned int old_freq, int ret,
+		u64 latency_ns)
+{
+	struct cpufreq_frequency_table *table;
+	struct cpufreq_stats *stat;
+	struct cpufreq_decision *d;
+	unsigned int latency_us = div_u64(latency_ns, NSEC_PER_USEC);
+	unsigned int requested = target_freq;
+	unsigned int index, bucket;
+	int req_index, new_index;
+
+	table = cpufreq_frequency_get_table(policy->cpu);
+	if (table && !cpufreq_frequency_table_target(policy, table,
+				target_freq, relation, &index))
+		requested = table[index].frequency;
+
+	spin_lock(&cpufreq_stats_lock);
+	stat = per_cpu(cpufreq_stats_table, policy->cpu);
+	if (!stat || !stat->decisions)
+		goto out;
+
+	req_index = freq_table_get_index(stat, requested);
+	new_index = freq_table_get_index(stat, policy->cur);
+	if (req_index != -1 && new_index != -1)
+		stat->req_table[req_index * stat->max_state + new_index]++;
+	if (requested != policy->cur)
+		stat->clamped++;
+
+	if (policy->cur != old_freq && new_index != -1) {
+		bucket = fls(latency_us >> LAT_BUCKET_SHIFT);
+		if (bucket >= LAT_BUCKETS)
+			bucket = LAT_BUCKETS - 1;
+		stat->lat_hist[new_index * LAT_BUCKETS + bucket]++;
+	}
+
+	d = &stat->decisions[stat->nr_decisions++ % NR_DECISIONS];
+	d->time = ktime_to_ns(ktime_get());
+	d->load = policy->load;
+	d->old = old_freq;
+	d->requested = target_freq;
+	d->granted = policy->cur;
+	d->latency_us = latency_us;
+	d->ret = ret;
+out:
+	spin_unlock(&cpufreq_stats_lock);
+}
+
+/*
+ * The files carry the cpu rather than the stats, which go away on
+ * hotplug.  Returns with cpufreq_stats_lock held.
+ */
+static struct cpufreq_stats *cpufreq_stats_lock_seq(struct seq_file *m)
+{
+	struct cpufreq_stats *stat;
+
+	spin_lock(&cpufreq_stats_lock);
+	stat = per_cpu(cpufreq_stats_table, (unsigned long)m->private);
+	if (stat && !stat->decisions)
+		stat = NULL;
+	return stat;
+}
+
+static int cpufreq_stats_latency_hist_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_stats *stat = cpufreq_stats_lock_seq(m);
+	char label[16];
+	int i, j;
+
+	if (!stat)
+		goto out;
+
+	seq_printf(m, "%9s:", "us");
+	for (j = 0; j < LAT_BUCKETS; j++) {
+		if (j == LAT_BUCKETS - 1)
+			snprintf(label, sizeof(label), ">=%u",
+				 1 << (j - 1 + LAT_BUCKET_SHIFT));
+		else
+			snprintf(label, sizeof(label), "<%u",
+				 1 << (j + LAT_BUCKET_SHIFT));
+		seq_printf(m, " %7s", label);
+	}
+	seq_printf(m, "\n");
+
+	for (i = 0; i < stat->state_num; i++) {
+		seq_printf(m, "%9u:", stat->freq_table[i]);
+		for (j = 0; j < LAT_BUCKETS; j++)
+			seq_printf(m, " %7u",
+				   stat->lat_hist[i * LAT_BUCKETS + j]);
+		seq_printf(m, "\n");
+	}
+out:
+	spin_unlock(&cpufreq_stats_lock);
+	return 0;
+}
+
+static int cpufreq_stats_requests_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_stats *stat = cpufreq_stats_lock_seq(m);
+	int i, j;
+
+	if (!stat)
+		goto out;
+
+	seq_printf(m, "Requested : Granted\n");
+	seq_printf(m, "          : ");
+	for (j = 0; j < stat->state_num; j++)
+		seq_printf(m, "%9u ", stat->freq_table[j]);
+	seq_printf(m, "\n");
+
+	for (i = 0; i < stat->state_num; i++) {
+		seq_printf(m, "%9u : ", stat->freq_table[i]);
+		for (j = 0; j < stat->state_num; j++)
+			seq_printf(m, "%9u ",
+				   stat->req_table[i * stat->max_state + j]);
+		seq_printf(m, "\n");
+	}
+	seq_printf(m, "clamped: %u\n", stat->clamped);
+out:
+	spin_unlock(&cpufreq_stats_lock);
+	return 0;
+}
+
+static int cpufreq_stats_decisions_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_stats *stat = cpufreq_stats_lock_seq(m);
+	unsigned int i, first = 0;
+
+	if (!stat)
+		goto out;
+
+	seq_printf(m, "%16s %4s %9s %9s %9s %8s %4s\n", "time_ns", "load",
+		   "old", "requested", "granted", "latency", "ret");
+
+	if (stat->nr_decisions > NR_DECISIONS)
+		first = stat->nr_decisions - NR_DECISIONS;
+	for (i = first; i != stat->nr_decisions; i++) {
+		struct cpufreq_decision *d = &stat->decisions[i % NR_DECISIONS];
+
+		seq_printf(m, "%16llu %4u %9u %9u %9u %8u %4d\n",
+			   (unsigned long long)d->time, d->load, d->old,
+			   d->requested, d->granted, d->latency_us, d->ret);
+	}
+out:
+	spin_unlock(&cpufreq_stats_lock);
+	return 0;
+}
+
+#define CPUFREQ_STATS_DEBUGFS_FOPS(_name) \
+static int cpufreq_stats_##_name##_open(struct inode *inode, \
+					struct file *file) \
+{ \
+	return single_open(file, cpufreq_stats_##_name##_show, \
+			   inode->i_private); \
+} \
+static const struct file_operations cpufreq_stats_##_name##_fops = { \
+	.open = cpufreq_stats_##_name##_open, \
+	.read = seq_read, \
+	.llseek = seq_lseek, \
+	.release = single_release, \
+};
+
+CPUFREQ_STATS_DEBUGFS_FOPS(latency_hist);
+CPUFREQ_STATS_DEBUGFS_FOPS(requests);
+CPUFREQ_STATS_DEBUGFS_FOPS(decisions);
+
+static void cpufreq_stats_debugfs_create(struct cpufreq_stats *stat)
+{
+	void *cpu = (void *)(unsigned long)stat->cpu;
+	char name[16];
+
+	if (!cpufreq_stats_debugfs_root)
+		return;
+
+	snprintf(name, sizeof(name), "cpu%u", stat->cpu);
+	stat->debugfs_dir = debugfs_create_dir(name,
+					       cpufreq_stats_debugfs_root);
+	if (!stat->debugfs_dir)
+		return;
+
+	debugfs_create_file("latency_hist", 0444, stat->debugfs_dir, cpu,
+			    &cpufreq_stats_latency_hist_fops);
+	debugfs_create_file("requests", 0444, stat->debugfs_dir, cpu,
+			    &cpufreq_stats_requests_fops);
+	debugfs_create_file("decisions", 0444, stat->debugfs_dir, cpu,
+			    &cpufreq_stats_decisions_fops);
+}
+
+static void cpufreq_stats_debugfs_remove(struct cpufreq_stats *stat)
+{
+	debugfs_remove_recursive(stat->debugfs_dir);
+	kfree(stat->decisions);
+}
+
+static void cpufreq_stats_debugfs_init(void)
+{
+	cpufreq_stats_debugfs_root = debugfs_create_dir("cpufreq_stats", NULL);
+	register_trace_cpufreq_target(cpufreq_stats_target_probe, NULL);
+}
+
+/* after the tables are gone, they own the per cpu directories */
+static void cpufreq_stats_debugfs_exit(void)
+{
+	unregister_trace_cpufreq_target(cpufreq_stats_target_probe, NULL);
+	tracepoint_synchronize_unregister();
+	debugfs_remove_recursive(cpufreq_stats_debugfs_root);
+}
+#else
+static inline void cpufreq_stats_debugfs_create(struct cpufreq_stats *stat) {}
+static inline void cpufreq_stats_debugfs_remove(struct cpufreq_stats *stat) {}
+static inline void cpufreq_stats_debugfs_init(void) {}
+static inline void cpufreq_stats_debugfs_exit(void) {}
+#endif
+
 /* should be called late in the CPU removal sequence so that the stats
  * memory is still available in case someone tries to use it.
  */
 static void cpufreq_stats_free_table(unsigned int cpu)
 {
 	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, cpu);
+
+	spin_lock(&cpufreq_stats_lock);
+	per_cpu(cpufreq_stats_table, cpu) = NULL;
+	spin_unlock(&cpufreq_stats_lock);
+
 	if (stat) {
+		cpufreq_stats_debugfs_remove(stat);
 		kfree(stat->time_in_state);
 		kfree(stat);
 	}
-	per_cpu(cpufreq_stats_table, cpu) = NULL;
 }
 
 /* must be called early in the CPU removal sequence (before
@@ -198,6 +460,7 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	struct cpufreq_policy *data;
 	unsigned int alloc_size;
 	unsigned int cpu = policy->cpu;
+	void *decisions = NULL;
 	if (per_cpu(cpufreq_stats_table, cpu))
 		return -EBUSY;
 	stat = kzalloc(sizeof(struct cpufreq_stats), GFP_KERNEL);
@@ -228,6 +491,10 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	alloc_size += count * count * sizeof(int);
+#endif
+#ifdef CONFIG_CPU_FREQ_STAT_DEBUGFS
+	alloc_size += count * count * sizeof(int);
+	alloc_size += count * LAT_BUCKETS * sizeof(int);
 #endif
 	stat->max_state = count;
 	stat->time_in_state = kzalloc(alloc_size, GFP_KERNEL);
@@ -239,6 +506,16 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table = stat->freq_table + count;
+#endif
+#ifdef CONFIG_CPU_FREQ_STAT_DEBUGFS
+	stat->req_table = stat->freq_table + count;
+#ifdef CONFIG_CPU_FREQ_STAT_DETAILS
+	stat->req_table += count * count;
+#endif
+	stat->lat_hist = stat->req_table + count * count;
+	/* if this fails only the sysfs statistics are kept */
+	decisions = kcalloc(NR_DECISIONS, sizeof(struct cpufreq_decision),
+			    GFP_KERNEL);
 #endif
 	j = 0;
 	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
@@ -252,7 +529,12 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
+#ifdef CONFIG_CPU_FREQ_STAT_DEBUGFS
+	stat->decisions = decisions;
+#endif
 	spin_unlock(&cpufreq_stats_lock);
+	if (decisions)
+		cpufreq_stats_debugfs_create(stat);
 	cpufreq_cpu_put(data);
 	return 0;
 error_out:
@@ -385,16 +667,20 @@ static int __init cpufreq_stats_init(void)
 	unsigned int cpu;
 
 	spin_lock_init(&cpufreq_stats_lock);
+	cpufreq_stats_debugfs_init();
 	ret = cpufreq_register_notifier(&notifier_policy_block,
 				CPUFREQ_POLICY_NOTIFIER);
-	if (ret)
+	if (ret) {
+		cpufreq_stats_debugfs_exit();
 		return ret;
+	}
 
 	ret = cpufreq_register_notifier(&notifier_trans_block,
 				CPUFREQ_TRANSITION_NOTIFIER);
 	if (ret) {
 		cpufreq_unregister_notifier(&notifier_policy_block,
 				CPUFREQ_POLICY_NOTIFIER);
+		cpufreq_stats_debugfs_exit();
 		return ret;
 	}
 
@@ -416,6 +702,7 @@ static void __exit cpufreq_stats_exit(void)
 	for_each_online_cpu(cpu) {
 		cpufreq_stats_free_table(cpu);
 	}
+	cpufreq_stats_debugfs_exit();
 }
 
 MODULE_AUTHOR("Zou Nan hai <nanhai.zou@intel.com>");
@@ -42,6 +42,42 @@ static void cpuidle_kick_cpus(void) {}
 
 static int __cpuidle_register_device(struct cpuidle_device *dev);
 
+/*
+ * Judge the state we just left against the residency we actually got:
+ * too deep if we woke before its break even time, too shallow if a
+ * deeper state the latency constraint allowed would have broken even.
+ * States are assumed to be ordered from shallow to deep.
+ */
+static void cpuidle_account_residency(struct cpuidle_device *dev,
+				      struct cpuidle_state *state)
+{
+	unsigned int residency = dev->last_residency;
+	int latency_req;
+	int i;
+
+	if (!(state->flags & CPUIDLE_FLAG_TIME_VALID))
+		return;
+
+	if (residency < state->target_residency) {
+		state->too_deep++;
+		return;
+	}
+
+	latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	for (i = state - dev->states + 1; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (s->exit_latency > latency_req)
+			break;
+		if (s->target_residency <= residency) {
+			state->too_shallow++;
+			break;
+		}
+	}
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -110,6 +146,7 @@ static void cpuidle_idle_call(void)
 
 	target_state->time += (unsigned long long)dev->last_residency;
 	target_state->usage++;
+	cpuidle_account_residency(dev, target_state);
 
 	/* give the governor an opportunity to reflect on the outcome */
 	if (cpuidle_curr_governor->reflect)
@@ -236,6 +273,8 @@ int cpuidle_enable_device(struct cpuidle_device *dev)
 	for (i = 0; i < dev->state_count; i++) {
 		dev->states[i].usage = 0;
 		dev->states[i].time = 0;
+		dev->states[i].too_deep = 0;
+		dev->states[i].too_shallow = 0;
 	}
 	dev->last_residency = 0;
 	dev->last_state = NULL;
@@ -0,0 +1,377 @@
+/*
+ * predict.c - an idle governor that predicts the idle length
+ *
+ * Based on the menu governor by Adam Belay and Arjan van de Ven.
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+
+#define INTERVALS	8
+#define IRQ_SLOTS	8
+#define IRQ_MIN_HITS	3
+#define MAX_INTERVAL_US	USEC_PER_SEC
+#define STDDEV_THRESH	400
+
+/*
+ * Concepts behind the predict governor
+ *
+ * Like menu, predict picks the lowest power state whose target_residency
+ * fits the idle period it expects and whose exit latency is acceptable.
+ * The difference is in how the idle period is expected.  menu scales the
+ * time to the next timer by a running correction factor, which averages
+ * over every kind of wakeup and mispredicts idles that a short periodic
+ * timer or device cuts off.  predict instead takes the earliest of three
+ * independent guesses:
+ *
+ * 1) The next timer event, as the tick code knows it.  This is an upper
+ *    bound unless something other than a timer wakes the cpu.
+ *
+ * 2) The typical recent idle length.  The last 8 idle periods of the cpu
+ *    are kept, and if they are clustered closely enough once the longest
+ *    ones are thrown out, their average is used.  This catches wakeups
+ *    that repeat but do not come from a single source.
+ *
+ * 3) The next interrupt.  Every interrupt handled on the cpu updates a
+ *    small table of recent sources with a running average of the time
+ *    between two occurrences and of how much that time varies.  A source
+ *    seen often enough and regular enough is expected again one average
+ *    interval after it last fired; one that is already late is ignored.
+ *
+ * Whether a decision worked out is visible, for every governor, in the
+ * too_deep and too_shallow counters of each state in sysfs.
+ */
+
+struct predict_irq {
+	unsigned int	irq;
+	unsigned int	hits;
+	u64		last_ns;
+	unsigned int	avg_us;		/* average interval */
+	unsigned int	dev_us;		/* average deviation from avg_us */
+};
+
+struct predict_device {
+	int		enabled;
+	int		needs_update;
+	int		last_state_idx;
+
+	unsigned int	timer_us;
+	unsigned int	predicted_us;
+	unsigned int	exit_us;
+	unsigned int	intervals[INTERVALS];
+	int		interval_ptr;
+	struct predict_irq irqs[IRQ_SLOTS];
+};
+
+static DEFINE_PER_CPU(struct predict_device, predict_devices);
+
+static void predict_update(struct cpuidle_device *dev);
+
+/**
+ * cpuidle_predict_irq - records an interrupt for the next idle prediction
+ * @irq: the interrupt being handled
+ *
+ * Called for every interrupt with interrupts disabled on the local cpu.
+ */
+void cpuidle_predict_irq(unsigned int irq)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	struct predict_irq *slot, *victim = &data->irqs[0];
+	unsigned int interval, diff;
+	u64 now;
+	int i;
+
+	if (!data->enabled)
+		return;
+
+	now = local_clock();
+
+	for (i = 0; i < IRQ_SLOTS; i++) {
+		slot = &data->irqs[i];
+		if (slot->hits && slot->irq == irq)
+			goto found;
+		if (slot->last_ns < victim->last_ns)
+			victim = slot;
+	}
+
+	/* new source, take over the one silent for longest */
+	victim->irq = irq;
+	victim->hits = 1;
+	victim->last_ns = now;
+	return;
+
+found:
+	if (now - slot->last_ns > (u64)MAX_INTERVAL_US * NSEC_PER_USEC) {
+		/* too long ago to say anything about the next one */
+		slot->hits = 1;
+		slot->last_ns = now;
+		return;
+	}
+
+	interval = div_u64(now - slot->last_ns, NSEC_PER_USEC);
+	slot->last_ns = now;
+
+	if (slot->hits == 1) {
+		slot->avg_us = interval;
+		slot->dev_us = interval / 2;
+	} else {
+		diff = abs((int)(interval - slot->avg_us));
+		slot->avg_us = (3 * slot->avg_us + interval) / 4;
+		slot->dev_us = (3 * slot->dev_us + diff) / 4;
+	}
+
+	if (slot->hits < IRQ_MIN_HITS)
+		slot->hits++;
+}
+
+/*
+ * Time until the earliest regular interrupt source is due again, or
+ * UINT_MAX if there is none.
+ */
+static unsigned int predict_next_irq(struct predict_device *data)
+{
+	unsigned int next_us = UINT_MAX;
+	u64 now = local_clock();
+	int i;
+
+	for (i = 0; i < IRQ_SLOTS; i++) {
+		struct predict_irq *slot = &data->irqs[i];
+		u64 elapsed;
+
+		if (slot->hits < IRQ_MIN_HITS)
+			continue;
+		if (slot->dev_us * 4 > slot->avg_us)
+			continue;
+
+		elapsed = div_u64(now - slot->last_ns, NSEC_PER_USEC);
+		if (elapsed >= slot->avg_us)
+			continue;
+
+		next_us = min(next_us, slot->avg_us - (unsigned int)elapsed);
+	}
+
+	return next_us;
+}
+
+/*
+ * Average of the recent idle periods if they are close enough to each
+ * other, or UINT_MAX.  Up to a quarter of them, the longest ones, may be
+ * thrown out as outliers; an early wakeup matters more than a late one.
+ */
+static unsigned int predict_typical_interval(struct predict_device *data)
+{
+	unsigned int thresh = UINT_MAX;
+	unsigned int max;
+	u64 avg, variance;
+	int i, divisor;
+
+	for (;;) {
+		max = 0;
+		avg = 0;
+		divisor = 0;
+		for (i = 0; i < INTERVALS; i++) {
+			unsigned int value = data->intervals[i];
+
+			if (value <= thresh) {
+				avg += value;
+				divisor++;
+				if (value > max)
+					max = value;
+			}
+		}
+		if (divisor * 4 < INTERVALS * 3)
+			return UINT_MAX;
+		avg = div_u64(avg, divisor);
+
+		variance = 0;
+		for (i = 0; i < INTERVALS; i++) {
+			unsigned int value = data->intervals[i];
+
+			if (value <= thresh) {
+				s64 diff = (s64)value - (s64)avg;
+
+				variance += diff * diff;
+			}
+		}
+		variance = div_u64(variance, divisor);
+
+		/* close enough if stddev is under 20us or a sixth of avg */
+		if (avg && (variance <= STDDEV_THRESH ||
+			    avg * avg > 36 * variance))
+			return avg;
+
+		if (!max)
+			return UINT_MAX;
+		thresh = max - 1;
+	}
+}
+
+/**
+ * predict_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int predict_select(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int power_usage = -1;
+	int i;
+	int multiplier;
+	struct timespec t;
+
+	if (data->needs_update) {
+		predict_update(dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = 0;
+	data->exit_us = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	data->timer_us = t.tv_sec * USEC_PER_SEC + t.tv_nsec / NSEC_PER_USEC;
+
+	data->predicted_us = min3(data->timer_us,
+				  predict_typical_interval(data),
+				  predict_next_irq(data));
+
+	/* as in menu, be reluctant with tasks waiting for IO on this cpu */
+	multiplier = 1 + 10 * nr_iowait_cpu(smp_processor_id());
+
+	/*
+	 * We want to default to C1 (hlt), not to busy polling
+	 * unless the timer is happening really really soon.
+	 */
+	if (data->timer_us > 5)
+		data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (s->target_residency > data->predicted_us)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+		if (s->exit_latency * multiplier > data->predicted_us)
+			continue;
+
+		if (s->power_usage < power_usage) {
+			power_usage = s->power_usage;
+			data->last_state_idx = i;
+			data->exit_us = s->exit_latency;
+		}
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * predict_reflect - records that data structures need update
+ * @dev: the CPU
+ *
+ * NOTE: it's important to be fast here because this operation will add to
+ *       the overall exit latency.
+ */
+static void predict_reflect(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	data->needs_update = 1;
+}
+
+/**
+ * predict_update - adds the last idle period to the history
+ * @dev: the CPU
+ */
+static void predict_update(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	struct cpuidle_state *target = dev->last_state;
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+
+	/*
+	 * The driver may have entered a shallower state than we asked for
+	 * and says so in last_state; without a residency measurement assume
+	 * we slept until the timer.
+	 */
+	if (!target)
+		target = &dev->states[data->last_state_idx];
+	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID)))
+		measured_us = data->timer_us;
+
+	data->intervals[data->interval_ptr++] = min_t(unsigned int,
+						      measured_us,
+						      MAX_INTERVAL_US);
+	if (data->interval_ptr >= INTERVALS)
+		data->interval_ptr = 0;
+}
+
+/**
+ * predict_enable_device - scans a CPU's states and does setup
+ * @dev: the CPU
+ */
+static int predict_enable_device(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+
+	data->enabled = 0;
+	smp_wmb();
+	memset(data, 0, sizeof(struct predict_device));
+	smp_wmb();
+	data->enabled = 1;
+
+	return 0;
+}
+
+/**
+ * predict_disable_device - stops recording interrupts for a CPU
+ * @dev: the CPU
+ */
+static void predict_disable_device(struct cpuidle_device *dev)
+{
+	per_cpu(predict_devices, dev->cpu).enabled = 0;
+}
+
+static struct cpuidle_governor predict_governor = {
+	.name =		"predict",
+	.rating =	25,
+	.enable =	predict_enable_device,
+	.disable =	predict_disable_device,
+	.select =	predict_select,
+	.reflect =	predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_predict - initializes the governor
+ */
+static int __init init_predict(void)
+{
+	return cpuidle_register_governor(&predict_governor);
+}
+
+/**
+ * exit_predict - exits the governor
+ */
+static void __exit exit_predict(void)
+{
+	cpuidle_unregister_governor(&predict_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_predict);
+module_exit(exit_predict);
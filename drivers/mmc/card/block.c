@@ -116,6 +116,7 @@ struct mmc_blk_data {
 	 */
 	unsigned int	part_curr;
 	struct device_attribute force_ro;
+	struct device_attribute num_wr_reqs_to_start_packing;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -209,6 +210,44 @@ out:
 	return ret;
 }
 
+static ssize_t
+num_wr_reqs_to_start_packing_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%u\n",
+		       md->queue.num_wr_reqs_to_start_packing);
+	mmc_blk_put(md);
+	return ret;
+}
+
+/*
+ * 0 packs every write burst the card allows, any other value is the
+ * number of consecutive writes needed before writes get packed again
+ * after a read.
+ */
+static ssize_t
+num_wr_reqs_to_start_packing_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	unsigned long value;
+	int ret;
+
+	ret = kstrtoul(buf, 0, &value);
+	if (ret)
+		goto out;
+
+	md->queue.num_wr_reqs_to_start_packing = value;
+	ret = count;
+out:
+	mmc_blk_put(md);
+	return ret;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -1247,6 +1286,103 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
+static void mmc_blk_pack_stop(struct mmc_card *card,
+			      enum mmc_packed_stop_reasons reason)
+{
+	struct mmc_packed_stats *stats = &card->pack_stats;
+
+	if (!stats->enabled)
+		return;
+
+	spin_lock(&stats->lock);
+	stats->pack_stop_reason[reason]++;
+	spin_unlock(&stats->lock);
+}
+
+static void mmc_blk_pack_account(struct mmc_card *card, int dir, u8 reqs)
+{
+	struct mmc_packed_stats *stats = &card->pack_stats;
+
+	if (!stats->enabled)
+		return;
+
+	spin_lock(&stats->lock);
+	if (reqs > MMC_PACKED_N_SINGLE) {
+		stats->packing_events[dir][min_t(u8, reqs,
+					MMC_PACKED_STATS_MAX_NUM)]++;
+		stats->packed_reqs[dir] += reqs;
+	} else {
+		stats->single_reqs[dir]++;
+	}
+	spin_unlock(&stats->lock);
+}
+
+static void mmc_blk_packed_fail_retry(struct mmc_card *card)
+{
+	struct mmc_packed_stats *stats = &card->pack_stats;
+
+	if (!stats->enabled)
+		return;
+
+	spin_lock(&stats->lock);
+	stats->packed_fail_retries++;
+	spin_unlock(&stats->lock);
+}
+
+static void mmc_blk_packed_abort(struct mmc_card *card)
+{
+	struct mmc_packed_stats *stats = &card->pack_stats;
+
+	if (!stats->enabled)
+		return;
+
+	spin_lock(&stats->lock);
+	stats->packed_aborts++;
+	spin_unlock(&stats->lock);
+}
+
+/*
+ * Write packing only pays off for sustained write streams, while packing
+ * delays any read queued behind the packed group. With adaptive packing
+ * a read turns write packing off, and it is turned back on once
+ * num_wr_reqs_to_start_packing writes have been seen in a row.
+ */
+static void mmc_blk_write_packing_control(struct mmc_queue *mq,
+					  struct request *req)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_packed_stats *stats = &card->pack_stats;
+	bool was_enabled = mq->wr_packing_enabled;
+
+	if (!(card->host->caps2 & MMC_CAP2_PACKED_WR))
+		return;
+
+	if (!mq->num_wr_reqs_to_start_packing) {
+		mq->wr_packing_enabled = true;
+		return;
+	}
+
+	if (!req || (req->cmd_flags & (REQ_FLUSH | REQ_DISCARD)))
+		return;
+
+	if (rq_data_dir(req) == READ) {
+		mq->num_of_potential_packed_wr_reqs = 0;
+		mq->wr_packing_enabled = false;
+	} else if (++mq->num_of_potential_packed_wr_reqs >=
+			mq->num_wr_reqs_to_start_packing) {
+		mq->wr_packing_enabled = true;
+	}
+
+	if (stats->enabled && was_enabled != mq->wr_packing_enabled) {
+		spin_lock(&stats->lock);
+		if (mq->wr_packing_enabled)
+			stats->wr_packing_enabled++;
+		else
+			stats->wr_packing_disabled++;
+		spin_unlock(&stats->lock);
+	}
+}
+
 static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 {
 	struct request_queue *q = mq->queue;
@@ -1259,6 +1395,7 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	u8 put_back = 0;
 	u8 max_packed_rw = 0;
 	u8 reqs = 0;
+	enum mmc_packed_stop_reasons stop = MAX_PACKED_REACHED;
 
 	mq->mqrq_cur->packed_num = MMC_PACKED_N_ZERO;
 
@@ -1276,6 +1413,9 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	if (max_packed_rw == 0)
 		goto no_packed;
 
+	if (rq_data_dir(cur) == WRITE && !mq->wr_packing_enabled)
+		goto no_packed;
+
 #ifdef CONFIG_MMC_SELECTIVE_PACKED_CMD_POLICY
 	if (rq_data_dir(cur) == READ)
 		goto no_packed;
@@ -1304,17 +1444,22 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	while (reqs < max_packed_rw - 1) {
 		/*We should stop no-more packing its nopacked_period*/
 		if ((card->host->caps2 & MMC_CAP2_ADAPT_PACKED)
-			 &&  mmc_is_nopacked_period(mq))
+			 &&  mmc_is_nopacked_period(mq)) {
+			stop = NOPACKED_PERIOD;
 			break;
+		}
 
 		spin_lock_irq(q->queue_lock);
 		next = blk_fetch_request(q);
 		spin_unlock_irq(q->queue_lock);
-		if (!next)
+		if (!next) {
+			stop = EMPTY_QUEUE;
 			break;
+		}
 
 		if (next->cmd_flags & REQ_DISCARD ||
 				next->cmd_flags & REQ_FLUSH) {
+			stop = FLUSH_OR_DISCARD;
 			put_back = 1;
 			break;
 		}
@@ -1323,11 +1468,19 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			blk_rq_pos(next)) {
 			/* if next request dose not start at end block of
 			   previous request */
+			stop = NON_SEQUENTIAL;
 			put_back = 1;
 			break;
 		}
 #endif
 		if (rq_data_dir(cur) != rq_data_dir(next)) {
+			/*
+			 * A read is waiting: finish this pack and stop
+			 * packing writes until the next write stream.
+			 */
+			if (rq_data_dir(next) == READ)
+				mmc_blk_write_packing_control(mq, next);
+			stop = WRONG_DATA_DIR;
 			put_back = 1;
 			break;
 		}
@@ -1335,18 +1488,21 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		if (mmc_req_rel_wr(next) &&
 				(md->flags & MMC_BLK_REL_WR) &&
 				!en_rel_wr) {
+			stop = REL_WRITE;
 			put_back = 1;
 			break;
 		}
 
 		req_sectors += blk_rq_sectors(next);
 		if (req_sectors > max_blk_count) {
+			stop = EXCEEDS_SECTORS;
 			put_back = 1;
 			break;
 		}
 
 		phys_segments +=  next->nr_phys_segments;
 		if (phys_segments > max_phys_segs) {
+			stop = EXCEEDS_SEGMENTS;
 			put_back = 1;
 			break;
 		}
@@ -1362,6 +1518,8 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		spin_unlock_irq(q->queue_lock);
 	}
 
+	mmc_blk_pack_stop(card, stop);
+
 	if (reqs > 0) {
 		list_add(&req->queuelist, &mq->mqrq_cur->packed_list);
 		mq->mqrq_cur->packed_num = ++reqs;
@@ -1592,8 +1750,10 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	if (!rqc && !mq->mqrq_prev->req)
 		return 0;
 
-	if (rqc)
+	if (rqc) {
 		reqs = mmc_blk_prep_packed_list(mq, rqc);
+		mmc_blk_pack_account(card, rq_data_dir(rqc), reqs);
+	}
 
 	do {
 		if (rqc) {
@@ -1633,6 +1793,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 					list_entry_rq(mq_rq->packed_list.next);
 					if (idx == i) {
 						/* retry from error index */
+						mmc_blk_packed_fail_retry(card);
 						mq_rq->packed_num -= idx;
 						mq_rq->req = prq;
 						ret = 1;
@@ -1769,6 +1930,7 @@ snd_packed_rd:
 					blk_rq_cur_bytes(req));
 		spin_unlock_irq(&md->lock);
 	} else {
+		mmc_blk_packed_abort(card);
 		while (!list_empty(&mq_rq->packed_list)) {
 			prq = list_entry_rq(mq_rq->packed_list.next);
 			list_del_init(&prq->queuelist);
@@ -1847,6 +2009,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			mmc_blk_issue_rw_rq(mq, NULL);
 		ret = mmc_blk_issue_flush(mq, req);
 	} else {
+		mmc_blk_write_packing_control(mq, req);
 		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
 
@@ -2068,6 +2231,9 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 	if (md) {
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			if (md->num_wr_reqs_to_start_packing.show)
+				device_remove_file(disk_to_dev(md->disk),
+					&md->num_wr_reqs_to_start_packing);
 
 			/* Stop new requests from getting into the queue */
 			del_gendisk(md->disk);
@@ -2105,7 +2271,31 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	md->force_ro.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(disk_to_dev(md->disk), &md->force_ro);
 	if (ret)
-		del_gendisk(md->disk);
+		goto force_ro_fail;
+
+	if (mmc_card_mmc(md->queue.card) &&
+	    (md->queue.card->host->caps2 & MMC_CAP2_PACKED_WR)) {
+		md->num_wr_reqs_to_start_packing.show =
+			num_wr_reqs_to_start_packing_show;
+		md->num_wr_reqs_to_start_packing.store =
+			num_wr_reqs_to_start_packing_store;
+		sysfs_attr_init(&md->num_wr_reqs_to_start_packing.attr);
+		md->num_wr_reqs_to_start_packing.attr.name =
+			"num_wr_reqs_to_start_packing";
+		md->num_wr_reqs_to_start_packing.attr.mode = S_IRUGO | S_IWUSR;
+		ret = device_create_file(disk_to_dev(md->disk),
+				&md->num_wr_reqs_to_start_packing);
+		if (ret)
+			goto packing_fail;
+	}
+
+	return ret;
+
+packing_fail:
+	md->num_wr_reqs_to_start_packing.show = NULL;
+	device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+force_ro_fail:
+	del_gendisk(md->disk);
 
 	return ret;
 }
@@ -199,6 +199,16 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->queue->queuedata = mq;
 	mq->nopacked_period = 0;
 
+	if (host->caps2 & MMC_CAP2_ADAPT_PACKED) {
+		mq->num_wr_reqs_to_start_packing =
+			MMC_BLK_WR_REQS_TO_START_PACKING;
+		mq->wr_packing_enabled = false;
+	} else {
+		mq->num_wr_reqs_to_start_packing = 0;
+		mq->wr_packing_enabled = true;
+	}
+	mq->num_of_potential_packed_wr_reqs = 0;
+
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	if (mmc_can_erase(card))
@@ -49,6 +49,10 @@ struct mmc_queue {
 	struct mmc_queue_req    *mqrq_prev;
 	/* Jiffies until which disable packed command. */
 	unsigned long		nopacked_period;
+	/* Adaptive write packing, see mmc_blk_write_packing_control() */
+	bool			wr_packing_enabled;
+	unsigned int		num_of_potential_packed_wr_reqs;
+	unsigned int		num_wr_reqs_to_start_packing;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
@@ -62,6 +66,12 @@ extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
 extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
+/*
+ * Number of consecutive writes after which write packing is turned on
+ * when the host asks for adaptive packing (MMC_CAP2_ADAPT_PACKED).
+ */
+#define MMC_BLK_WR_REQS_TO_START_PACKING	8
+
 #define IS_RT_CLASS_REQ(x)     \
 	 (IOPRIO_PRIO_CLASS(req_get_ioprio(x)) == IOPRIO_CLASS_RT)
 
@@ -9,9 +9,11 @@
  */
 #include <linux/debugfs.h>
 #include <linux/fs.h>
+#include <linux/math64.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
+#include <linux/uaccess.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -284,6 +286,110 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.llseek		= default_llseek,
 };
 
+static const char * const mmc_packed_stop_str[MAX_REASONS] = {
+	[EXCEEDS_SEGMENTS]	= "exceeds max segments",
+	[EXCEEDS_SECTORS]	= "exceeds max sectors",
+	[WRONG_DATA_DIR]	= "wrong data direction",
+	[FLUSH_OR_DISCARD]	= "flush or discard",
+	[EMPTY_QUEUE]		= "empty queue",
+	[REL_WRITE]		= "reliable write",
+	[NOPACKED_PERIOD]	= "nopacked period",
+	[NON_SEQUENTIAL]	= "non sequential",
+	[MAX_PACKED_REACHED]	= "max packed reached",
+};
+
+static int mmc_packing_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_packed_stats *stats = &card->pack_stats;
+	int dir, i;
+
+	spin_lock(&stats->lock);
+
+	seq_printf(s, "enabled: %d\n", stats->enabled);
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		u64 packs = 0, reqs = 0;
+
+		for (i = 2; i <= MMC_PACKED_STATS_MAX_NUM; i++) {
+			u32 events = stats->packing_events[dir][i];
+
+			if (!events)
+				continue;
+			packs += events;
+			reqs += (u64)events * i;
+			seq_printf(s, "%s: packed %d reqs - %u times\n",
+				   dir == READ ? "read" : "write", i, events);
+		}
+
+		seq_printf(s, "%s: packed reqs %u, single reqs %u, avg pack %llu.%02llu\n",
+			   dir == READ ? "read" : "write",
+			   stats->packed_reqs[dir], stats->single_reqs[dir],
+			   packs ? div64_u64(reqs, packs) : 0,
+			   packs ? div64_u64((reqs * 100), packs) % 100 : 0);
+	}
+
+	for (i = 0; i < MAX_REASONS; i++)
+		seq_printf(s, "stop: %s - %u\n", mmc_packed_stop_str[i],
+			   stats->pack_stop_reason[i]);
+
+	seq_printf(s, "fail retries: %u\n", stats->packed_fail_retries);
+	seq_printf(s, "aborts: %u\n", stats->packed_aborts);
+	seq_printf(s, "write packing enabled: %u\n",
+		   stats->wr_packing_enabled);
+	seq_printf(s, "write packing disabled: %u\n",
+		   stats->wr_packing_disabled);
+
+	spin_unlock(&stats->lock);
+
+	return 0;
+}
+
+static int mmc_packing_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_packing_stats_show, inode->i_private);
+}
+
+/*
+ * Writing 0 stops and clears the statistics, any other value clears
+ * them and starts collecting again.
+ */
+static ssize_t mmc_packing_stats_write(struct file *filp,
+				       const char __user *ubuf, size_t cnt,
+				       loff_t *ppos)
+{
+	struct mmc_card *card = ((struct seq_file *)filp->private_data)->private;
+	struct mmc_packed_stats *stats = &card->pack_stats;
+	unsigned long value;
+	int err;
+
+	err = kstrtoul_from_user(ubuf, cnt, 0, &value);
+	if (err)
+		return err;
+
+	spin_lock(&stats->lock);
+	memset(stats->packing_events, 0, sizeof(stats->packing_events));
+	memset(stats->pack_stop_reason, 0, sizeof(stats->pack_stop_reason));
+	memset(stats->packed_reqs, 0, sizeof(stats->packed_reqs));
+	memset(stats->single_reqs, 0, sizeof(stats->single_reqs));
+	stats->packed_fail_retries = 0;
+	stats->packed_aborts = 0;
+	stats->wr_packing_enabled = 0;
+	stats->wr_packing_disabled = 0;
+	stats->enabled = !!value;
+	spin_unlock(&stats->lock);
+
+	return cnt;
+}
+
+static const struct file_operations mmc_dbg_packing_stats_fops = {
+	.open		= mmc_packing_stats_open,
+	.read		= seq_read,
+	.write		= mmc_packing_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -316,6 +422,11 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && (card->host->caps2 & MMC_CAP2_PACKED_CMD))
+		if (!debugfs_create_file("packing_stats", S_IRUSR | S_IWUSR,
+					root, card, &mmc_dbg_packing_stats_fops))
+			goto err;
+
 	return;
 
 err:
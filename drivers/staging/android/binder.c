@@ -16,6 +16,7 @@
  */
 
 #include <asm/cacheflush.h>
+#include <linux/cpufreq.h>
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
@@ -1265,6 +1266,10 @@ static void binder_transaction(struct binder_proc *proc,
 	e->data_size = tr->data_size;
 	e->offsets_size = tr->offsets_size;
 
+	/* the caller blocks until the reply, so the whole round trip counts */
+	if (!reply && !(tr->flags & TF_ONE_WAY))
+		cpu_boost_kick(CPU_BOOST_BINDER);
+
 	if (reply) {
 		in_reply_to = thread->transaction_stack;
 		if (in_reply_to == NULL) {
@@ -55,6 +55,7 @@
 #include <linux/pipe_fs_i.h>
 #include <linux/oom.h>
 #include <linux/compat.h>
+#include <linux/cpufreq.h>
 
 #include <asm/uaccess.h>
 #include <asm/mmu_context.h>
@@ -1527,6 +1528,7 @@ static int do_execve_common(const char *filename,
 	current->fs->in_exec = 0;
 	current->in_execve = 0;
 	acct_update_integrals(current);
+	cpu_boost_kick(CPU_BOOST_EXEC);
 	free_bprm(bprm);
 	if (displaced)
 		put_files_struct(displaced);
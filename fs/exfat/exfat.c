@@ -353,6 +353,7 @@ INT32 ffsLookupFile(struct inode *inode, UINT8 *path, FILE_ID_T *fid)
 		fid->type = TYPE_DIR;
 		fid->rwoffset = 0;
 		fid->hint_last_off = -1;
+		fid->num_extents = 0;
 
 		fid->attr = ATTR_SUBDIR;
 		fid->flags = 0x01;
@@ -374,6 +375,7 @@ INT32 ffsLookupFile(struct inode *inode, UINT8 *path, FILE_ID_T *fid)
 		fid->type = p_fs->fs_func->get_entry_type(ep);
 		fid->rwoffset = 0;
 		fid->hint_last_off = -1;
+		fid->num_extents = 0;
 		fid->attr = p_fs->fs_func->get_entry_attr(ep);
 
 		fid->size = p_fs->fs_func->get_entry_size(ep2);
@@ -797,6 +799,7 @@ INT32 ffsTruncateFile(struct inode *inode, UINT64 old_size, UINT64 new_size)
 	p_fs->fs_func->free_cluster(sb, &clu, 0);
 
 	fid->hint_last_off = -1;
+	fid->num_extents = 0;
 	if (fid->rwoffset > fid->size) {
 		fid->rwoffset = fid->size;
 	}
@@ -1230,10 +1233,109 @@ INT32 ffsSetStat(struct inode *inode, DIR_ENTRY_T *info)
 	return FFS_SUCCESS;
 }
 
+/*
+ * Per-file cache of contiguous cluster runs, so that mapping an offset in
+ * a FAT-chained file does not walk the chain from its start every time.
+ * Entries are kept most recently used first; any operation that rewrites
+ * the chain other than appending to it empties the cache.
+ */
+static void extent_cache_touch(FILE_ID_T *fid, INT32 i)
+{
+	EXTENT_T ex = fid->extents[i];
+
+	memmove(&fid->extents[1], &fid->extents[0], i * sizeof(EXTENT_T));
+	fid->extents[0] = ex;
+}
+
+/*
+ * Find the cached cluster closest to, and not beyond, file cluster @fclu.
+ * Returns its file cluster index with the disk cluster in @dclu, or -1 if
+ * no cached run starts at or before @fclu.
+ */
+static INT32 extent_cache_lookup(FILE_ID_T *fid, UINT32 fclu, UINT32 *dclu)
+{
+	INT32 i, best = -1;
+	UINT32 end, best_end = 0;
+	EXTENT_T *ex;
+
+	for (i = 0; i < fid->num_extents; i++) {
+		ex = &fid->extents[i];
+		if (ex->fclu > fclu)
+			continue;
+
+		end = ex->fclu + ex->len - 1;
+		if (end >= fclu) {
+			*dclu = ex->dclu + (fclu - ex->fclu);
+			extent_cache_touch(fid, i);
+			return fclu;
+		}
+
+		if ((best < 0) || (end > best_end)) {
+			best = i;
+			best_end = end;
+		}
+	}
+
+	if (best < 0)
+		return -1;
+
+	ex = &fid->extents[best];
+	*dclu = ex->dclu + ex->len - 1;
+	extent_cache_touch(fid, best);
+	return best_end;
+}
+
+static void extent_cache_add(FILE_ID_T *fid, UINT32 fclu, UINT32 dclu, UINT32 len)
+{
+	INT32 i;
+	UINT32 end;
+	EXTENT_T *ex;
+
+	for (i = 0; i < fid->num_extents; i++) {
+		ex = &fid->extents[i];
+
+		/* merge with a run that overlaps or abuts on both file and disk */
+		if ((ex->fclu - fclu) != (ex->dclu - dclu))
+			continue;
+		if ((fclu > ex->fclu + ex->len) || (ex->fclu > fclu + len))
+			continue;
+
+		end = max(ex->fclu + ex->len, fclu + len);
+		if (fclu < ex->fclu) {
+			ex->fclu = fclu;
+			ex->dclu = dclu;
+		}
+		ex->len = end - ex->fclu;
+		extent_cache_touch(fid, i);
+		return;
+	}
+
+	/* replace the least recently used run once the cache is full */
+	if (fid->num_extents < EXTENT_CACHE_SIZE)
+		fid->num_extents++;
+
+	i = fid->num_extents - 1;
+	fid->extents[i].fclu = fclu;
+	fid->extents[i].dclu = dclu;
+	fid->extents[i].len = len;
+	extent_cache_touch(fid, i);
+}
+
+/* longest run a file that has to move is placed in, in clusters */
+#define ALLOC_RUN_HINT		64
+
+/*
+ * Map file cluster @clu_offset to its cluster on disk in @clu, allocating
+ * one cluster if it does not exist yet.  Both buffered and direct IO
+ * writes extend a file a cluster at a time, so contiguity comes from
+ * where that cluster is placed.
+ */
 INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 {
 	INT32 num_clusters, num_alloced, modified = FALSE;
-	UINT32 last_clu, sector;
+	INT32 fclu, cached;
+	INT32 run_len;
+	UINT32 last_clu, sector, dclu, run_fclu, run_dclu, run_clu;
 	CHAIN_T new_clu;
 	DENTRY_T *ep;
 	ENTRY_SET_CACHE_T *es = NULL;
@@ -1251,6 +1353,8 @@ INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 	*clu = last_clu = fid->start_clu;
 
 	if (fid->flags == 0x03) {
+		fclu = clu_offset;
+
 		if ((clu_offset > 0) && (*clu != CLUSTER_32(~0))) {
 			last_clu += clu_offset - 1;
 
@@ -1260,17 +1364,41 @@ INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 				*clu += clu_offset;
 		}
 	} else {
-		if ((clu_offset > 0) && (fid->hint_last_off > 0) &&
-			(clu_offset >= fid->hint_last_off)) {
-			clu_offset -= fid->hint_last_off;
-			*clu = fid->hint_last_clu;
+		fclu = 0;
+
+		if (clu_offset > 0) {
+			cached = extent_cache_lookup(fid, clu_offset, &dclu);
+
+			if ((fid->hint_last_off > 0) && (clu_offset >= fid->hint_last_off) &&
+				(fid->hint_last_off > cached)) {
+				fclu = fid->hint_last_off;
+				*clu = fid->hint_last_clu;
+			} else if (cached > 0) {
+				fclu = cached;
+				*clu = dclu;
+			}
 		}
 
-		while ((clu_offset > 0) && (*clu != CLUSTER_32(~0))) {
+		run_fclu = fclu;
+		run_dclu = *clu;
+
+		while ((fclu < clu_offset) && (*clu != CLUSTER_32(~0))) {
 			last_clu = *clu;
 			if (FAT_read(sb, *clu, clu) == -1)
 				return FFS_MEDIAERR;
-			clu_offset--;
+			fclu++;
+
+			if ((*clu != last_clu + 1) && (*clu != CLUSTER_32(~0))) {
+				run_fclu = fclu;
+				run_dclu = *clu;
+			}
+		}
+
+		if (run_dclu != CLUSTER_32(~0)) {
+			if (*clu != CLUSTER_32(~0))
+				extent_cache_add(fid, run_fclu, run_dclu, fclu - run_fclu + 1);
+			else if (fclu > run_fclu)
+				extent_cache_add(fid, run_fclu, run_dclu, fclu - run_fclu);
 		}
 	}
 
@@ -1281,6 +1409,25 @@ INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 		new_clu.size = 0;
 		new_clu.flags = fid->flags;
 
+		/*
+		 * When the file cannot continue in place, move it to a free
+		 * run as long as the file already is, so that it can keep
+		 * growing contiguously from there.
+		 */
+		run_len = 1;
+		if ((p_fs->vol_type == EXFAT) && (new_clu.dir != CLUSTER_32(~0)) &&
+			!is_free_cluster(sb, new_clu.dir))
+			run_len = min(num_clusters, ALLOC_RUN_HINT);
+
+		if (run_len > 1) {
+			run_clu = find_free_run(sb, new_clu.dir, run_len);
+			if (run_clu != CLUSTER_32(~0)) {
+				/* the file no longer continues in place */
+				new_clu.dir = run_clu;
+				new_clu.flags = 0x01;
+			}
+		}
+
 		num_alloced = p_fs->fs_func->alloc_cluster(sb, 1, &new_clu);
 		if (num_alloced < 1)
 			return FFS_FULL;
@@ -1293,6 +1440,7 @@ INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 		} else {
 			if (new_clu.flags != fid->flags) {
 				exfat_chain_cont_cluster(sb, fid->start_clu, num_clusters);
+				extent_cache_add(fid, 0, fid->start_clu, num_clusters);
 				fid->flags = 0x01;
 				modified = TRUE;
 			}
@@ -1303,6 +1451,9 @@ INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 		num_clusters += num_alloced;
 		*clu = new_clu.dir;
 
+		if (fid->flags == 0x01)
+			extent_cache_add(fid, fclu, new_clu.dir, num_alloced);
+
 		if (p_fs->vol_type == EXFAT) {
 			es = get_entry_set_in_dir(sb, &(fid->dir), fid->entry, ES_ALL_ENTRIES, &ep);
 			if (es == NULL)
@@ -1344,6 +1495,48 @@ INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 	return FFS_SUCCESS;
 }
 
+/*
+ * Count the clusters from file cluster @clu_offset (which is @clu on disk)
+ * that follow each other on disk, up to @max_clusters and the end of the
+ * file, so that a whole run can be mapped with one call.
+ */
+INT32 ffsGetClusterRun(struct inode *inode, INT32 clu_offset, UINT32 clu, INT32 max_clusters)
+{
+	INT32 num_clusters, run = 1;
+	UINT32 start = clu, next;
+	struct super_block *sb = inode->i_sb;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	FILE_ID_T *fid = &(EXFAT_I(inode)->fid);
+
+	if (EXFAT_I(inode)->mmu_private == 0)
+		return 1;
+
+	num_clusters = (INT32)((EXFAT_I(inode)->mmu_private-1) >> p_fs->cluster_size_bits) + 1;
+	if (max_clusters > num_clusters - clu_offset)
+		max_clusters = num_clusters - clu_offset;
+	if (max_clusters <= 1)
+		return 1;
+
+	if (fid->flags == 0x03)
+		return max_clusters;
+
+	while (run < max_clusters) {
+		if (FAT_read(sb, clu, &next) == -1)
+			break;
+		if (next != clu + 1)
+			break;
+		clu = next;
+		run++;
+	}
+
+	extent_cache_add(fid, clu_offset, start, run);
+
+	fid->hint_last_off = clu_offset + run - 1;
+	fid->hint_last_clu = clu;
+
+	return run;
+}
+
 INT32 ffsCreateDir(struct inode *inode, UINT8 *path, FILE_ID_T *fid)
 {
 	INT32 ret;
@@ -1762,14 +1955,32 @@ INT32 exfat_alloc_cluster(struct super_block *sb, INT32 num_alloc, CHAIN_T *p_ch
 
 	hint_clu = p_chain->dir;
 	if (hint_clu == CLUSTER_32(~0)) {
-		hint_clu = test_alloc_bitmap(sb, p_fs->clu_srch_ptr-2);
-		if (hint_clu == CLUSTER_32(~0))
-			return 0;
+		hint_clu = p_fs->clu_srch_ptr;
 	} else if (hint_clu >= p_fs->num_clusters) {
 		hint_clu = 2;
 		p_chain->flags = 0x01;
 	}
 
+	/*
+	 * Take a multi-cluster request from a single free run if there is
+	 * one, starting with the hint itself, so the chain stays contiguous.
+	 */
+	if (num_alloc > 1) {
+		new_clu = find_free_run(sb, hint_clu, num_alloc);
+		if ((new_clu != CLUSTER_32(~0)) && (new_clu != hint_clu)) {
+			/* an existing chain no longer continues in place */
+			if (p_chain->dir != CLUSTER_32(~0))
+				p_chain->flags = 0x01;
+			hint_clu = new_clu;
+		}
+	}
+
+	if (p_chain->dir == CLUSTER_32(~0)) {
+		hint_clu = test_alloc_bitmap(sb, hint_clu-2);
+		if (hint_clu == CLUSTER_32(~0))
+			return 0;
+	}
+
 	__set_sb_dirty(sb);
 
 	p_chain->dir = CLUSTER_32(~0);
@@ -1988,22 +2199,13 @@ INT32 fat_count_used_clusters(struct super_block *sb)
 
 INT32 exfat_count_used_clusters(struct super_block *sb)
 {
-	INT32 i, map_i, map_b, count = 0;
-	UINT8 k;
+	INT32 i, count;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
-	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
 
-	map_i = map_b = 0;
+	count = p_fs->num_clusters - 2;
 
-	for (i = 2; i < p_fs->num_clusters; i += 8) {
-		k = *(((UINT8 *) p_fs->vol_amap[map_i]->b_data) + map_b);
-		count += used_bit[k];
-
-		if ((++map_b) >= p_bd->sector_size) {
-			map_i++;
-			map_b = 0;
-		}
-	}
+	for (i = 0; i < p_fs->map_sectors; i++)
+		count -= p_fs->map_free[i];
 
 	return(count);
 }
@@ -2021,6 +2223,138 @@ void exfat_chain_cont_cluster(struct super_block *sb, UINT32 chain, INT32 len)
 	FAT_write(sb, chain, CLUSTER_32(~0));
 }
 
+/*
+ * The allocation bitmap is kept in memory together with a count of free
+ * clusters for each of its sectors (map_free), so that searches can pass
+ * over sectors that are completely used or completely free without
+ * looking at their bits.
+ */
+static UINT32 alloc_bitmap_sector_bits(struct super_block *sb, INT32 map_i)
+{
+	UINT32 bits, first;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	bits = p_bd->sector_size << 3;
+	first = (UINT32) map_i * bits;
+
+	if (first + bits > p_fs->num_clusters - 2)
+		return p_fs->num_clusters - 2 - first;
+	return bits;
+}
+
+static void count_alloc_bitmap_sector(struct super_block *sb, INT32 map_i)
+{
+	UINT32 bits, used = 0;
+	INT32 b;
+	UINT8 *data;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	bits = alloc_bitmap_sector_bits(sb, map_i);
+	data = (UINT8 *) p_fs->vol_amap[map_i]->b_data;
+
+	for (b = 0; b < (bits >> 3); b++)
+		used += used_bit[data[b]];
+	if (bits & 0x7)
+		used += used_bit[data[b] & ((1 << (bits & 0x7)) - 1)];
+
+	p_fs->map_free[map_i] = (UINT16) (bits - used);
+}
+
+INT32 is_free_cluster(struct super_block *sb, UINT32 clu)
+{
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	if ((clu < 2) || (clu >= p_fs->num_clusters))
+		return FALSE;
+
+	clu -= 2;
+	return !Bitmap_test((UINT8 *) p_fs->vol_amap[clu >> (p_bd->sector_size_bits + 3)]->b_data,
+				clu & ((p_bd->sector_size << 3) - 1));
+}
+
+/*
+ * Find @len free clusters in a row, looking from @hint to the end of the
+ * volume and then from its start.  Returns the first cluster of the run,
+ * or CLUSTER_32(~0) if there is no run that long.
+ *
+ * A failed search covers the whole bitmap, so remember the shortest
+ * length that failed (no_run_len) and fail longer requests straight
+ * away until clusters are freed again.
+ */
+UINT32 find_free_run(struct super_block *sb, UINT32 hint, UINT32 len)
+{
+	UINT32 c, start = 0, run = 0, bits, total, n, hint_c;
+	INT32 map_i, wrapped = FALSE;
+	UINT8 *data;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	if (p_fs->no_run_len && (len >= p_fs->no_run_len))
+		return(CLUSTER_32(~0));
+
+	bits = p_bd->sector_size << 3;
+	total = p_fs->num_clusters - 2;
+
+	if ((hint < 2) || (hint >= p_fs->num_clusters))
+		hint = 2;
+	c = hint_c = hint - 2;
+
+	for (;;) {
+		if (c >= total) {
+			if (wrapped)
+				break;
+			wrapped = TRUE;
+			c = run = 0;
+			continue;
+		}
+		if (wrapped && (c >= hint_c + len))
+			break;
+
+		map_i = c >> (p_bd->sector_size_bits + 3);
+		data = (UINT8 *) p_fs->vol_amap[map_i]->b_data;
+
+		if ((c & (bits - 1)) == 0) {
+			n = alloc_bitmap_sector_bits(sb, map_i);
+
+			if (p_fs->map_free[map_i] == 0) {
+				run = 0;
+				c += n;
+				continue;
+			}
+			if (p_fs->map_free[map_i] == n) {
+				if (run == 0)
+					start = c;
+				run += n;
+				if (run >= len)
+					return start + 2;
+				c += n;
+				continue;
+			}
+		}
+
+		if (((c & 0x7) == 0) && (data[(c & (bits - 1)) >> 3] == 0xFF)) {
+			run = 0;
+			c += 8;
+			continue;
+		}
+
+		if (Bitmap_test(data, c & (bits - 1))) {
+			run = 0;
+		} else {
+			if (run == 0)
+				start = c;
+			if (++run >= len)
+				return start + 2;
+		}
+		c++;
+	}
+
+	p_fs->no_run_len = len;
+	return(CLUSTER_32(~0));
+}
+
 INT32 load_alloc_bitmap(struct super_block *sb)
 {
 	INT32 i, j, ret;
@@ -2076,6 +2410,20 @@ INT32 load_alloc_bitmap(struct super_block *sb)
 					}
 				}
 
+				p_fs->map_free = (UINT16 *) MALLOC(sizeof(UINT16) * p_fs->map_sectors);
+				if (p_fs->map_free == NULL) {
+					for (j = 0; j < p_fs->map_sectors; j++)
+						brelse(p_fs->vol_amap[j]);
+
+					FREE(p_fs->vol_amap);
+					p_fs->vol_amap = NULL;
+					return FFS_MEMORYERR;
+				}
+
+				for (j = 0; j < p_fs->map_sectors; j++)
+					count_alloc_bitmap_sector(sb, j);
+				p_fs->no_run_len = 0;
+
 				p_fs->pbr_bh = NULL;
 				return FFS_SUCCESS;
 			}
@@ -2101,6 +2449,9 @@ void free_alloc_bitmap(struct super_block *sb)
 
 	FREE(p_fs->vol_amap);
 	p_fs->vol_amap = NULL;
+
+	FREE(p_fs->map_free);
+	p_fs->map_free = NULL;
 }
 
 INT32 set_alloc_bitmap(struct super_block *sb, UINT32 clu)
@@ -2115,6 +2466,9 @@ INT32 set_alloc_bitmap(struct super_block *sb, UINT32 clu)
 
 	sector = START_SECTOR(p_fs->map_clu) + i;
 
+	if (!Bitmap_test((UINT8 *) p_fs->vol_amap[i]->b_data, b))
+		p_fs->map_free[i]--;
+
 	Bitmap_set((UINT8 *) p_fs->vol_amap[i]->b_data, b);
 
 	return (sector_write(sb, sector, p_fs->vol_amap[i], 0));
@@ -2137,6 +2491,10 @@ INT32 clr_alloc_bitmap(struct super_block *sb, UINT32 clu)
 
 	sector = START_SECTOR(p_fs->map_clu) + i;
 
+	if (Bitmap_test((UINT8 *) p_fs->vol_amap[i]->b_data, b))
+		p_fs->map_free[i]++;
+	p_fs->no_run_len = 0;
+
 	Bitmap_clear((UINT8 *) p_fs->vol_amap[i]->b_data, b);
 
 	return (sector_write(sb, sector, p_fs->vol_amap[i], 0));
@@ -2157,7 +2515,7 @@ INT32 clr_alloc_bitmap(struct super_block *sb, UINT32 clu)
 
 UINT32 test_alloc_bitmap(struct super_block *sb, UINT32 clu)
 {
-	INT32 i, map_i, map_b;
+	INT32 i, map_i, map_b, skip;
 	UINT32 clu_base, clu_free;
 	UINT8 k, clu_mask;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
@@ -2170,15 +2528,24 @@ UINT32 test_alloc_bitmap(struct super_block *sb, UINT32 clu)
 	map_b = (clu >> 3) & p_bd->sector_size_mask;
 
 	for (i = 2; i < p_fs->num_clusters; i += 8) {
-		k = *(((UINT8 *) p_fs->vol_amap[map_i]->b_data) + map_b);
-		if (clu_mask > 0) {
-			k |= clu_mask;
+		if (p_fs->map_free[map_i] == 0) {
+			/* nothing free in the rest of this sector */
+			skip = (p_bd->sector_size - map_b - 1) << 3;
+			i += skip;
+			clu_base += skip;
+			map_b = p_bd->sector_size - 1;
 			clu_mask = 0;
-		}
-		if (k < 0xFF) {
-			clu_free = clu_base + free_bit[k];
-			if (clu_free < p_fs->num_clusters)
-				return(clu_free);
+		} else {
+			k = *(((UINT8 *) p_fs->vol_amap[map_i]->b_data) + map_b);
+			if (clu_mask > 0) {
+				k |= clu_mask;
+				clu_mask = 0;
+			}
+			if (k < 0xFF) {
+				clu_free = clu_base + free_bit[k];
+				if (clu_free < p_fs->num_clusters)
+					return(clu_free);
+			}
 		}
 		clu_base += 8;
 
@@ -4550,6 +4917,7 @@ INT32 create_dir(struct inode *inode, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, FIL
 	fid->type= TYPE_DIR;
 	fid->rwoffset = 0;
 	fid->hint_last_off = -1;
+	fid->num_extents = 0;
 
 	return FFS_SUCCESS;
 }
@@ -4590,6 +4958,7 @@ INT32 create_file(struct inode *inode, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, UI
 	fid->type= TYPE_FILE;
 	fid->rwoffset = 0;
 	fid->hint_last_off = -1;
+	fid->num_extents = 0;
 
 	return FFS_SUCCESS;
 }
@@ -420,6 +420,8 @@ extern "C" {
 		UINT32      map_clu;
 		UINT32      map_sectors;
 		struct buffer_head **vol_amap;
+		UINT16      *map_free;
+		UINT32      no_run_len;	/* no free run this long, 0 if unknown */
 
 		UINT16      **vol_utbl;
 
@@ -431,13 +433,17 @@ extern "C" {
 
 		FS_FUNC_T	*fs_func;
 
-		BUF_CACHE_T FAT_cache_array[FAT_CACHE_SIZE];
+		UINT32      FAT_cache_size;
+		UINT32      FAT_cache_hash_size;
+		BUF_CACHE_T *FAT_cache_array;
 		BUF_CACHE_T FAT_cache_lru_list;
-		BUF_CACHE_T FAT_cache_hash_list[FAT_CACHE_HASH_SIZE];
+		BUF_CACHE_T *FAT_cache_hash_list;
 
-		BUF_CACHE_T buf_cache_array[BUF_CACHE_SIZE];
+		UINT32      buf_cache_size;
+		UINT32      buf_cache_hash_size;
+		BUF_CACHE_T *buf_cache_array;
 		BUF_CACHE_T buf_cache_lru_list;
-		BUF_CACHE_T buf_cache_hash_list[BUF_CACHE_HASH_SIZE];
+		BUF_CACHE_T *buf_cache_hash_list;
 	} FS_INFO_T;
 
 #define ES_2_ENTRIES		2
@@ -473,6 +479,7 @@ extern "C" {
 	INT32 ffsGetStat(struct inode *inode, DIR_ENTRY_T *info);
 	INT32 ffsSetStat(struct inode *inode, DIR_ENTRY_T *info);
 	INT32 ffsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu);
+	INT32 ffsGetClusterRun(struct inode *inode, INT32 clu_offset, UINT32 clu, INT32 max_clusters);
 
 	INT32 ffsCreateDir(struct inode *inode, UINT8 *path, FILE_ID_T *fid);
 	INT32 ffsReadDir(struct inode *inode, DIR_ENTRY_T *dir_ent);
@@ -500,6 +507,8 @@ extern "C" {
 	INT32   set_alloc_bitmap(struct super_block *sb, UINT32 clu);
 	INT32   clr_alloc_bitmap(struct super_block *sb, UINT32 clu);
 	UINT32 test_alloc_bitmap(struct super_block *sb, UINT32 clu);
+	INT32   is_free_cluster(struct super_block *sb, UINT32 clu);
+	UINT32 find_free_run(struct super_block *sb, UINT32 hint, UINT32 len);
 	void   sync_alloc_bitmap(struct super_block *sb);
 
 	INT32  load_upcase_table(struct super_block *sb);
@@ -332,6 +332,21 @@ INT32 FsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu)
 	return(err);
 }
 
+INT32 FsGetClusterRun(struct inode *inode, INT32 clu_offset, UINT32 clu, INT32 max_clusters)
+{
+	INT32 run;
+	struct super_block *sb = inode->i_sb;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	sm_P(&(fs_struct[p_fs->drv].v_sem));
+
+	run = ffsGetClusterRun(inode, clu_offset, clu, max_clusters);
+
+	sm_V(&(fs_struct[p_fs->drv].v_sem));
+
+	return(run);
+}
+
 INT32 FsCreateDir(struct inode *inode, UINT8 *path, FILE_ID_T *fid)
 {
 	INT32 err;
@@ -399,6 +414,7 @@ EXPORT_SYMBOL(FsSetAttr);
 EXPORT_SYMBOL(FsReadStat);
 EXPORT_SYMBOL(FsWriteStat);
 EXPORT_SYMBOL(FsMapCluster);
+EXPORT_SYMBOL(FsGetClusterRun);
 EXPORT_SYMBOL(FsCreateDir);
 EXPORT_SYMBOL(FsReadDir);
 EXPORT_SYMBOL(FsRemoveDir);
@@ -110,6 +110,14 @@ extern "C" {
 		UINT8       flags;
 	} CHAIN_T;
 
+#define EXTENT_CACHE_SIZE       8
+
+	typedef struct {
+		UINT32      fclu;
+		UINT32      dclu;
+		UINT32      len;
+	} EXTENT_T;
+
 	typedef struct {
 		CHAIN_T     dir;
 		INT32       entry;
@@ -121,6 +129,8 @@ extern "C" {
 		INT64       rwoffset;
 		INT32       hint_last_off;
 		UINT32      hint_last_clu;
+		INT32       num_extents;
+		EXTENT_T    extents[EXTENT_CACHE_SIZE];
 	} FILE_ID_T;
 
 	typedef struct {
@@ -153,6 +163,7 @@ extern "C" {
 	INT32 FsReadStat(struct inode *inode, DIR_ENTRY_T *info);
 	INT32 FsWriteStat(struct inode *inode, DIR_ENTRY_T *info);
 	INT32 FsMapCluster(struct inode *inode, INT32 clu_offset, UINT32 *clu);
+	INT32 FsGetClusterRun(struct inode *inode, INT32 clu_offset, UINT32 clu, INT32 max_clusters);
 
 	INT32 FsCreateDir(struct inode *inode, UINT8 *path, FILE_ID_T *fid);
 	INT32 FsReadDir(struct inode *inode, DIR_ENTRY_T *dir_entry);
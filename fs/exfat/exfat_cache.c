@@ -16,6 +16,10 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+
 #include "exfat_config.h"
 #include "exfat_global.h"
 #include "exfat_data.h"
@@ -49,15 +53,73 @@ static void push_to_lru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 static void move_to_mru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 static void move_to_lru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 
+/*
+ * Number of cache entries for a volume: one entry per @bytes_per_entry
+ * of device, kept between the historical default and @max, and never
+ * pinning more than 1/1024th of RAM in buffer heads.  Each entry holds
+ * one device sector, which is also the block size ffsMountVol() sets.
+ */
+static UINT32 buf_cache_entries(struct super_block *sb, UINT32 min,
+				UINT32 max, UINT64 bytes_per_entry)
+{
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+	UINT64 dev_bytes, ram_entries, nr;
+
+	dev_bytes = i_size_read(sb->s_bdev->bd_inode);
+	nr = div64_u64(dev_bytes, bytes_per_entry);
+
+	ram_entries = ((UINT64) totalram_pages << PAGE_SHIFT) >> CACHE_RAM_SHIFT;
+	ram_entries >>= p_bd->sector_size_bits;
+
+	if (nr > ram_entries)
+		nr = ram_entries;
+	if (nr > max)
+		nr = max;
+	if (nr < min)
+		nr = min;
+
+	return (UINT32) nr;
+}
+
+static UINT32 buf_cache_hash_entries(UINT32 nr, UINT32 min)
+{
+	nr = roundup_pow_of_two(nr >> 1);
+	return (nr < min) ? min : nr;
+}
+
 INT32 buf_init(struct super_block *sb)
 {
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
 	INT32 i;
 
+	/* the sector size is needed to size the caches */
+	if (bdev_open(sb))
+		return FFS_MEDIAERR;
+
+	p_fs->FAT_cache_size = buf_cache_entries(sb, FAT_CACHE_SIZE,
+			FAT_CACHE_MAX_SIZE, CACHE_BYTES_PER_ENTRY);
+	p_fs->FAT_cache_hash_size = buf_cache_hash_entries(p_fs->FAT_cache_size,
+			FAT_CACHE_HASH_SIZE);
+	p_fs->buf_cache_size = buf_cache_entries(sb, BUF_CACHE_SIZE,
+			BUF_CACHE_MAX_SIZE, (UINT64) CACHE_BYTES_PER_ENTRY << 1);
+	p_fs->buf_cache_hash_size = buf_cache_hash_entries(p_fs->buf_cache_size,
+			BUF_CACHE_HASH_SIZE);
+
+	p_fs->FAT_cache_array = vmalloc(p_fs->FAT_cache_size * sizeof(BUF_CACHE_T));
+	p_fs->FAT_cache_hash_list = vmalloc(p_fs->FAT_cache_hash_size * sizeof(BUF_CACHE_T));
+	p_fs->buf_cache_array = vmalloc(p_fs->buf_cache_size * sizeof(BUF_CACHE_T));
+	p_fs->buf_cache_hash_list = vmalloc(p_fs->buf_cache_hash_size * sizeof(BUF_CACHE_T));
+
+	if (!p_fs->FAT_cache_array || !p_fs->FAT_cache_hash_list ||
+		!p_fs->buf_cache_array || !p_fs->buf_cache_hash_list) {
+		buf_shutdown(sb);
+		return(FFS_MEMORYERR);
+	}
+
 	p_fs->FAT_cache_lru_list.next = p_fs->FAT_cache_lru_list.prev = &p_fs->FAT_cache_lru_list;
 
-	for (i = 0; i < FAT_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->FAT_cache_size; i++) {
 		p_fs->FAT_cache_array[i].drv = -1;
 		p_fs->FAT_cache_array[i].sec = ~0;
 		p_fs->FAT_cache_array[i].flag = 0;
@@ -68,7 +130,7 @@ INT32 buf_init(struct super_block *sb)
 
 	p_fs->buf_cache_lru_list.next = p_fs->buf_cache_lru_list.prev = &p_fs->buf_cache_lru_list;
 
-	for (i = 0; i < BUF_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->buf_cache_size; i++) {
 		p_fs->buf_cache_array[i].drv = -1;
 		p_fs->buf_cache_array[i].sec = ~0;
 		p_fs->buf_cache_array[i].flag = 0;
@@ -77,23 +139,23 @@ INT32 buf_init(struct super_block *sb)
 		push_to_mru(&(p_fs->buf_cache_array[i]), &p_fs->buf_cache_lru_list);
 	}
 
-	for (i = 0; i < FAT_CACHE_HASH_SIZE; i++) {
+	for (i = 0; i < p_fs->FAT_cache_hash_size; i++) {
 		p_fs->FAT_cache_hash_list[i].drv = -1;
 		p_fs->FAT_cache_hash_list[i].sec = ~0;
 		p_fs->FAT_cache_hash_list[i].hash_next = p_fs->FAT_cache_hash_list[i].hash_prev = &(p_fs->FAT_cache_hash_list[i]);
 	}
 
-	for (i = 0; i < FAT_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->FAT_cache_size; i++) {
 		FAT_cache_insert_hash(sb, &(p_fs->FAT_cache_array[i]));
 	}
 
-	for (i = 0; i < BUF_CACHE_HASH_SIZE; i++) {
+	for (i = 0; i < p_fs->buf_cache_hash_size; i++) {
 		p_fs->buf_cache_hash_list[i].drv = -1;
 		p_fs->buf_cache_hash_list[i].sec = ~0;
 		p_fs->buf_cache_hash_list[i].hash_next = p_fs->buf_cache_hash_list[i].hash_prev = &(p_fs->buf_cache_hash_list[i]);
 	}
 
-	for (i = 0; i < BUF_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->buf_cache_size; i++) {
 		buf_cache_insert_hash(sb, &(p_fs->buf_cache_array[i]));
 	}
 
@@ -102,6 +164,16 @@ INT32 buf_init(struct super_block *sb)
 
 INT32 buf_shutdown(struct super_block *sb)
 {
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	vfree(p_fs->FAT_cache_array);
+	vfree(p_fs->FAT_cache_hash_list);
+	vfree(p_fs->buf_cache_array);
+	vfree(p_fs->buf_cache_hash_list);
+
+	p_fs->FAT_cache_array = p_fs->FAT_cache_hash_list = NULL;
+	p_fs->buf_cache_array = p_fs->buf_cache_hash_list = NULL;
+
 	return(FFS_SUCCESS);
 }
 
@@ -445,7 +517,7 @@ static BUF_CACHE_T *FAT_cache_find(struct super_block *sb, UINT32 sec)
 	BUF_CACHE_T *bp, *hp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (FAT_CACHE_HASH_SIZE - 1);
+	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (p_fs->FAT_cache_hash_size - 1);
 
 	hp = &(p_fs->FAT_cache_hash_list[off]);
 	for (bp = hp->hash_next; bp != hp; bp = bp->hash_next) {
@@ -476,7 +548,7 @@ static void FAT_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp)
 	FS_INFO_T *p_fs;
 
 	p_fs = &(EXFAT_SB(sb)->fs_info);
-	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (FAT_CACHE_HASH_SIZE-1);
+	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (p_fs->FAT_cache_hash_size - 1);
 
 	hp = &(p_fs->FAT_cache_hash_list[off]);
 	bp->hash_next = hp->hash_next;
@@ -652,7 +724,7 @@ static BUF_CACHE_T *buf_cache_find(struct super_block *sb, UINT32 sec)
 	BUF_CACHE_T *bp, *hp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (BUF_CACHE_HASH_SIZE - 1);
+	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (p_fs->buf_cache_hash_size - 1);
 
 	hp = &(p_fs->buf_cache_hash_list[off]);
 	for (bp = hp->hash_next; bp != hp; bp = bp->hash_next) {
@@ -683,7 +755,7 @@ static void buf_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp)
 	FS_INFO_T *p_fs;
 
 	p_fs = &(EXFAT_SB(sb)->fs_info);
-	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (BUF_CACHE_HASH_SIZE-1);
+	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (p_fs->buf_cache_hash_size - 1);
 
 	hp = &(p_fs->buf_cache_hash_list[off]);
 	bp->hash_next = hp->hash_next;
@@ -1064,7 +1064,8 @@ const struct inode_operations exfat_file_inode_operations = {
 };
 
 static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
-					  unsigned long *mapped_blocks, int *create)
+					  unsigned long *mapped_blocks, unsigned long max_blocks,
+					  int *create)
 {
 	struct super_block *sb = inode->i_sb;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
@@ -1073,7 +1074,7 @@ static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 	const unsigned long blocksize = sb->s_blocksize;
 	const unsigned char blocksize_bits = sb->s_blocksize_bits;
 	sector_t last_block;
-	int err, clu_offset, sec_offset;
+	int err, clu_offset, sec_offset, max_clu, run;
 	unsigned int cluster;
 
 	*phys = 0;
@@ -1111,6 +1112,18 @@ static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 	} else if (cluster != CLUSTER_32(~0)) {
 		*phys = START_SECTOR(cluster) + sec_offset;
 		*mapped_blocks = p_fs->sectors_per_clu - sec_offset;
+
+		/*
+		 * For blocks that already exist, map the whole run of
+		 * contiguous clusters the caller can use, so readahead and
+		 * writeback build one bio per run rather than per cluster.
+		 */
+		if (!*create && (max_blocks > *mapped_blocks)) {
+			max_clu = ((max_blocks - *mapped_blocks + p_fs->sectors_per_clu - 1)
+					   >> p_fs->sectors_per_clu_bits) + 1;
+			run = FsGetClusterRun(inode, clu_offset, cluster, max_clu);
+			*mapped_blocks += (unsigned long) (run - 1) << p_fs->sectors_per_clu_bits;
+		}
 	}
 
 	return 0;
@@ -1127,7 +1140,7 @@ static int exfat_get_block(struct inode *inode, sector_t iblock,
 
 	__lock_super(sb);
 
-	err = exfat_bmap(inode, iblock, &phys, &mapped_blocks, &create);
+	err = exfat_bmap(inode, iblock, &phys, &mapped_blocks, max_blocks, &create);
 	if (err) {
 		__unlock_super(sb);
 		return err;
@@ -1805,6 +1818,7 @@ static int exfat_read_root(struct inode *inode)
 	EXFAT_I(inode)->fid.type = TYPE_DIR;
 	EXFAT_I(inode)->fid.rwoffset = 0;
 	EXFAT_I(inode)->fid.hint_last_off = -1;
+	EXFAT_I(inode)->fid.num_extents = 0;
 
 	EXFAT_I(inode)->target = NULL;
 
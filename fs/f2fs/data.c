@@ -264,42 +264,232 @@ int f2fs_reserve_block(struct dnode_of_data *dn, pgoff_t index)
 	return err;
 }
 
+static struct kmem_cache *extent_node_slab;
+
+/*
+ * Extent cache
+ *
+ * fi->ext keeps the largest extent of the inode, which is also stored in
+ * its on-disk inode, and fi->ext_tree caches the other mapped ranges that
+ * were looked up or written. Both are protected by fi->ext.ext_lock.
+ * Writers change block addresses with the dnode page locked and update the
+ * cache before releasing it, and so do readers inserting what they found,
+ * so the cache never holds an address older than the node page.
+ */
+
+/* return the extent holding fofs, or the first one after it */
+static struct extent_node *__lookup_extent_node(struct f2fs_inode_info *fi,
+							unsigned int fofs)
+{
+	struct rb_node *node = fi->ext_tree.rb_node;
+	struct extent_node *en, *next = NULL;
+
+	while (node) {
+		en = rb_entry(node, struct extent_node, rb_node);
+
+		if (fofs < en->fofs) {
+			next = en;
+			node = node->rb_left;
+		} else if (fofs >= en->fofs + en->len) {
+			node = node->rb_right;
+		} else {
+			return en;
+		}
+	}
+	return next;
+}
+
+static struct extent_node *__insert_extent_node(struct f2fs_sb_info *sbi,
+		struct f2fs_inode_info *fi, unsigned int fofs, u32 blk_addr,
+		unsigned int len)
+{
+	struct rb_node **p = &fi->ext_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct extent_node *en;
+
+	/* we are under ext_lock, so do not sleep; the cache is optional */
+	en = kmem_cache_alloc(extent_node_slab, GFP_ATOMIC);
+	if (!en)
+		return NULL;
+
+	en->fi = fi;
+	en->fofs = fofs;
+	en->blk_addr = blk_addr;
+	en->len = len;
+
+	while (*p) {
+		parent = *p;
+		if (fofs < rb_entry(parent, struct extent_node, rb_node)->fofs)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	if (RB_EMPTY_ROOT(&fi->ext_tree))
+		atomic_inc(&sbi->total_ext_tree);
+	rb_link_node(&en->rb_node, parent, p);
+	rb_insert_color(&en->rb_node, &fi->ext_tree);
+
+	spin_lock(&sbi->extent_lock);
+	list_add_tail(&en->list, &sbi->extent_list);
+	spin_unlock(&sbi->extent_lock);
+	atomic_inc(&sbi->total_ext_node);
+	return en;
+}
+
+/* the caller should have unlinked en from extent_list */
+static void __release_extent_node(struct f2fs_sb_info *sbi,
+		struct f2fs_inode_info *fi, struct extent_node *en)
+{
+	rb_erase(&en->rb_node, &fi->ext_tree);
+	if (RB_EMPTY_ROOT(&fi->ext_tree))
+		atomic_dec(&sbi->total_ext_tree);
+	atomic_dec(&sbi->total_ext_node);
+	kmem_cache_free(extent_node_slab, en);
+}
+
+static void __remove_extent_node(struct f2fs_sb_info *sbi,
+		struct f2fs_inode_info *fi, struct extent_node *en)
+{
+	spin_lock(&sbi->extent_lock);
+	list_del(&en->list);
+	spin_unlock(&sbi->extent_lock);
+	__release_extent_node(sbi, fi, en);
+}
+
+/* drop [fofs, fofs + len) from the rbtree, splitting extents if needed */
+static void __drop_extent_range(struct f2fs_sb_info *sbi,
+		struct f2fs_inode_info *fi, unsigned int fofs, unsigned int len)
+{
+	unsigned int end = fofs + len;
+	struct extent_node *en;
+	struct rb_node *next;
+
+	en = __lookup_extent_node(fi, fofs);
+	while (en && en->fofs < end) {
+		unsigned int en_end = en->fofs + en->len;
+
+		next = rb_next(&en->rb_node);
+
+		if (en->fofs < fofs) {
+			/* keep the front, and the tail if the range is inside */
+			if (en_end > end)
+				__insert_extent_node(sbi, fi, end,
+					en->blk_addr + end - en->fofs,
+					en_end - end);
+			en->len = fofs - en->fofs;
+		} else if (en_end > end) {
+			en->blk_addr += end - en->fofs;
+			en->len = en_end - end;
+			en->fofs = end;
+		} else {
+			__remove_extent_node(sbi, fi, en);
+		}
+
+		en = next ? rb_entry(next, struct extent_node, rb_node) : NULL;
+	}
+}
+
+/* cache a mapped range that is not in the rbtree, merging neighbours */
+static struct extent_node *__add_extent_range(struct f2fs_sb_info *sbi,
+		struct f2fs_inode_info *fi, unsigned int fofs, u32 blk_addr,
+		unsigned int len)
+{
+	struct extent_node *prev, *next;
+	struct rb_node *node;
+
+	next = __lookup_extent_node(fi, fofs);
+	node = next ? rb_prev(&next->rb_node) : rb_last(&fi->ext_tree);
+	prev = node ? rb_entry(node, struct extent_node, rb_node) : NULL;
+
+	if (prev && prev->fofs + prev->len == fofs &&
+			prev->blk_addr + prev->len == blk_addr) {
+		prev->len += len;
+		if (next && fofs + len == next->fofs &&
+				blk_addr + len == next->blk_addr) {
+			prev->len += next->len;
+			__remove_extent_node(sbi, fi, next);
+		}
+		next = prev;
+	} else if (next && fofs + len == next->fofs &&
+			blk_addr + len == next->blk_addr) {
+		next->fofs = fofs;
+		next->blk_addr = blk_addr;
+		next->len += len;
+	} else {
+		return __insert_extent_node(sbi, fi, fofs, blk_addr, len);
+	}
+
+	spin_lock(&sbi->extent_lock);
+	list_move_tail(&next->list, &sbi->extent_list);
+	spin_unlock(&sbi->extent_lock);
+	return next;
+}
+
+/* cache a range found by walking the node pages, see get_data_block() */
+static void cache_extent_range(struct inode *inode, pgoff_t fofs,
+					block_t blk_addr, unsigned int len)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+
+	if (!len)
+		return;
+
+	write_lock(&fi->ext.ext_lock);
+	__drop_extent_range(sbi, fi, fofs, len);
+	__add_extent_range(sbi, fi, fofs, blk_addr, len);
+	write_unlock(&fi->ext.ext_lock);
+}
+
+static void map_extent_bh(struct inode *inode, pgoff_t pgofs,
+		pgoff_t start_fofs, block_t start_blkaddr, unsigned int len,
+		struct buffer_head *bh_result)
+{
+	unsigned int blkbits = inode->i_sb->s_blocksize_bits;
+	size_t count;
+
+	clear_buffer_new(bh_result);
+	map_bh(bh_result, inode->i_sb, start_blkaddr + pgofs - start_fofs);
+	count = start_fofs + len - pgofs;
+	if (count < (UINT_MAX >> blkbits))
+		bh_result->b_size = (count << blkbits);
+	else
+		bh_result->b_size = UINT_MAX;
+}
+
 static int check_extent_cache(struct inode *inode, pgoff_t pgofs,
 					struct buffer_head *bh_result)
 {
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
 	struct f2fs_inode_info *fi = F2FS_I(inode);
-	pgoff_t start_fofs, end_fofs;
-	block_t start_blkaddr;
-
-	if (is_inode_flag_set(fi, FI_NO_EXTENT))
-		return 0;
+	struct extent_node *en;
 
 	read_lock(&fi->ext.ext_lock);
-	if (fi->ext.len == 0) {
+	if (fi->ext.len == 0 && RB_EMPTY_ROOT(&fi->ext_tree)) {
 		read_unlock(&fi->ext.ext_lock);
 		return 0;
 	}
 
 	stat_inc_total_hit(inode->i_sb);
 
-	start_fofs = fi->ext.fofs;
-	end_fofs = fi->ext.fofs + fi->ext.len - 1;
-	start_blkaddr = fi->ext.blk_addr;
-
-	if (pgofs >= start_fofs && pgofs <= end_fofs) {
-		unsigned int blkbits = inode->i_sb->s_blocksize_bits;
-		size_t count;
-
-		clear_buffer_new(bh_result);
-		map_bh(bh_result, inode->i_sb,
-				start_blkaddr + pgofs - start_fofs);
-		count = end_fofs - pgofs + 1;
-		if (count < (UINT_MAX >> blkbits))
-			bh_result->b_size = (count << blkbits);
-		else
-			bh_result->b_size = UINT_MAX;
+	if (pgofs >= fi->ext.fofs && pgofs < fi->ext.fofs + fi->ext.len) {
+		map_extent_bh(inode, pgofs, fi->ext.fofs, fi->ext.blk_addr,
+						fi->ext.len, bh_result);
+		stat_inc_read_hit(inode->i_sb);
+		read_unlock(&fi->ext.ext_lock);
+		return 1;
+	}
 
+	en = __lookup_extent_node(fi, pgofs);
+	if (en && pgofs >= en->fofs) {
+		map_extent_bh(inode, pgofs, en->fofs, en->blk_addr,
+						en->len, bh_result);
+		spin_lock(&sbi->extent_lock);
+		list_move_tail(&en->list, &sbi->extent_list);
+		spin_unlock(&sbi->extent_lock);
 		stat_inc_read_hit(inode->i_sb);
+		stat_inc_rbtree_hit(inode->i_sb);
 		read_unlock(&fi->ext.ext_lock);
 		return 1;
 	}
@@ -307,12 +497,20 @@ static int check_extent_cache(struct inode *inode, pgoff_t pgofs,
 	return 0;
 }
 
-void update_extent_cache(block_t blk_addr, struct dnode_of_data *dn)
+/*
+ * Point the extent cache of dn's offset at blk_addr.  Any cached mapping
+ * of the offset is always dropped or split; only with @cache is the new
+ * address inserted as well.
+ */
+static void __update_extent_cache(struct dnode_of_data *dn, block_t blk_addr,
+								bool cache)
 {
+	struct f2fs_sb_info *sbi = F2FS_SB(dn->inode->i_sb);
 	struct f2fs_inode_info *fi = F2FS_I(dn->inode);
+	struct extent_node *en = NULL;
 	pgoff_t fofs, start_fofs, end_fofs;
-	block_t start_blkaddr, end_blkaddr;
-	int need_update = true;
+	block_t start_blkaddr;
+	int need_update = false;
 
 	f2fs_bug_on(blk_addr == NEW_ADDR);
 	fofs = start_bidx_of_node(ofs_of_node(dn->node_page), fi) +
@@ -321,47 +519,18 @@ void update_extent_cache(block_t blk_addr, struct dnode_of_data *dn)
 	/* Update the page address in the parent node */
 	__set_data_blkaddr(dn, blk_addr);
 
-	if (is_inode_flag_set(fi, FI_NO_EXTENT))
-		return;
-
 	write_lock(&fi->ext.ext_lock);
 
+	__drop_extent_range(sbi, fi, fofs, 1);
+	if (cache && blk_addr != NULL_ADDR)
+		en = __add_extent_range(sbi, fi, fofs, blk_addr, 1);
+
 	start_fofs = fi->ext.fofs;
 	end_fofs = fi->ext.fofs + fi->ext.len - 1;
 	start_blkaddr = fi->ext.blk_addr;
-	end_blkaddr = fi->ext.blk_addr + fi->ext.len - 1;
-
-	/* Drop and initialize the matched extent */
-	if (fi->ext.len == 1 && fofs == start_fofs)
-		fi->ext.len = 0;
-
-	/* Initial extent */
-	if (fi->ext.len == 0) {
-		if (blk_addr != NULL_ADDR) {
-			fi->ext.fofs = fofs;
-			fi->ext.blk_addr = blk_addr;
-			fi->ext.len = 1;
-		}
-		goto end_update;
-	}
-
-	/* Front merge */
-	if (fofs == start_fofs - 1 && blk_addr == start_blkaddr - 1) {
-		fi->ext.fofs--;
-		fi->ext.blk_addr--;
-		fi->ext.len++;
-		goto end_update;
-	}
 
-	/* Back merge */
-	if (fofs == end_fofs + 1 && blk_addr == end_blkaddr + 1) {
-		fi->ext.len++;
-		goto end_update;
-	}
-
-	/* Split the existing extent */
-	if (fi->ext.len > 1 &&
-		fofs >= start_fofs && fofs <= end_fofs) {
+	/* Split the largest extent, keeping its bigger part */
+	if (fi->ext.len && fofs >= start_fofs && fofs <= end_fofs) {
 		if ((end_fofs - fofs) < (fi->ext.len >> 1)) {
 			fi->ext.len = fofs - start_fofs;
 		} else {
@@ -370,23 +539,109 @@ void update_extent_cache(block_t blk_addr, struct dnode_of_data *dn)
 					fofs - start_fofs + 1;
 			fi->ext.len -= fofs - start_fofs + 1;
 		}
-	} else {
-		need_update = false;
+		if (fi->ext.len < F2FS_MIN_EXTENT_LEN)
+			fi->ext.len = 0;
+		need_update = true;
 	}
 
-	/* Finally, if the extent is very fragmented, let's drop the cache. */
-	if (fi->ext.len < F2FS_MIN_EXTENT_LEN) {
-		fi->ext.len = 0;
-		set_inode_flag(fi, FI_NO_EXTENT);
+	/* A cached extent may now be the largest one worth keeping on disk */
+	if (en && en->len >= F2FS_MIN_EXTENT_LEN && en->len > fi->ext.len) {
+		fi->ext.fofs = en->fofs;
+		fi->ext.blk_addr = en->blk_addr;
+		fi->ext.len = en->len;
 		need_update = true;
 	}
-end_update:
+
 	write_unlock(&fi->ext.ext_lock);
 	if (need_update)
 		sync_inode_page(dn);
 	return;
 }
 
+void update_extent_cache(block_t blk_addr, struct dnode_of_data *dn)
+{
+	__update_extent_cache(dn, blk_addr, true);
+}
+
+void f2fs_destroy_extent_tree(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct rb_node *node;
+
+	write_lock(&fi->ext.ext_lock);
+	while ((node = rb_first(&fi->ext_tree)))
+		__remove_extent_node(sbi, fi,
+				rb_entry(node, struct extent_node, rb_node));
+	write_unlock(&fi->ext.ext_lock);
+}
+
+/*
+ * Free the least recently used extent nodes. Locks are taken in the
+ * reverse order of the lookup path, so busy inodes are simply skipped.
+ */
+static int f2fs_shrink_extent_cache(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	struct f2fs_sb_info *sbi = container_of(shrink, struct f2fs_sb_info,
+							extent_shrinker);
+	int nr_to_scan = sc->nr_to_scan;
+	struct extent_node *en, *tmp;
+	int freed = 0;
+
+	if (!nr_to_scan)
+		return atomic_read(&sbi->total_ext_node);
+
+	spin_lock(&sbi->extent_lock);
+	list_for_each_entry_safe(en, tmp, &sbi->extent_list, list) {
+		struct f2fs_inode_info *fi = en->fi;
+
+		if (nr_to_scan-- <= 0)
+			break;
+		if (!write_trylock(&fi->ext.ext_lock))
+			continue;
+		list_del(&en->list);
+		__release_extent_node(sbi, fi, en);
+		write_unlock(&fi->ext.ext_lock);
+		freed++;
+	}
+	spin_unlock(&sbi->extent_lock);
+
+	stat_add_shrunk_ext(sbi, freed);
+	return atomic_read(&sbi->total_ext_node);
+}
+
+void f2fs_init_extent_cache(struct f2fs_sb_info *sbi)
+{
+	INIT_LIST_HEAD(&sbi->extent_list);
+	spin_lock_init(&sbi->extent_lock);
+	atomic_set(&sbi->total_ext_node, 0);
+	atomic_set(&sbi->total_ext_tree, 0);
+
+	sbi->extent_shrinker.shrink = f2fs_shrink_extent_cache;
+	sbi->extent_shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&sbi->extent_shrinker);
+}
+
+void f2fs_exit_extent_cache(struct f2fs_sb_info *sbi)
+{
+	unregister_shrinker(&sbi->extent_shrinker);
+}
+
+int __init create_extent_cache(void)
+{
+	extent_node_slab = f2fs_kmem_cache_create("f2fs_extent_node",
+					sizeof(struct extent_node), NULL);
+	if (!extent_node_slab)
+		return -ENOMEM;
+	return 0;
+}
+
+void destroy_extent_cache(void)
+{
+	kmem_cache_destroy(extent_node_slab);
+}
+
 struct page *find_data_page(struct inode *inode, pgoff_t index, bool sync)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
@@ -588,9 +843,10 @@ static int __allocate_data_block(struct dnode_of_data *dn)
 	allocate_data_block(sbi, NULL, NULL_ADDR, &new_blkaddr, &sum, type);
 
 	/* direct IO doesn't use extent cache to maximize the performance */
-	set_inode_flag(F2FS_I(dn->inode), FI_NO_EXTENT);
-	update_extent_cache(new_blkaddr, dn);
-	clear_inode_flag(F2FS_I(dn->inode), FI_NO_EXTENT);
+	__update_extent_cache(dn, new_blkaddr, false);
+
+	/* the dnode changed, fdatasync must not take its fast path */
+	set_inode_flag(F2FS_I(dn->inode), FI_APPEND_WRITE);
 
 	dn->data_blkaddr = new_blkaddr;
 	return 0;
@@ -612,7 +868,8 @@ static int get_data_block(struct inode *inode, sector_t iblock,
 	unsigned maxblocks = bh_result->b_size >> blkbits;
 	struct dnode_of_data dn;
 	int mode = create ? ALLOC_NODE : LOOKUP_NODE_RA;
-	pgoff_t pgofs, end_offset;
+	pgoff_t pgofs, end_offset, ext_fofs = 0;
+	block_t ext_blkaddr = NULL_ADDR;
 	int err = 0, ofs = 1;
 	bool allocated = false;
 
@@ -638,6 +895,10 @@ static int get_data_block(struct inode *inode, sector_t iblock,
 
 	if (dn.data_blkaddr != NULL_ADDR) {
 		map_bh(bh_result, inode->i_sb, dn.data_blkaddr);
+		if (!create) {
+			ext_fofs = pgofs;
+			ext_blkaddr = dn.data_blkaddr;
+		}
 	} else if (create) {
 		err = __allocate_data_block(&dn);
 		if (err)
@@ -659,6 +920,12 @@ get_next:
 		if (allocated)
 			sync_inode_page(&dn);
 		allocated = false;
+		if (ext_blkaddr != NULL_ADDR) {
+			cache_extent_range(inode, ext_fofs, ext_blkaddr,
+							pgofs - ext_fofs);
+			ext_blkaddr += pgofs - ext_fofs;
+			ext_fofs = pgofs;
+		}
 		f2fs_put_dnode(&dn);
 
 		set_new_dnode(&dn, inode, NULL, NULL, 0);
@@ -696,6 +963,10 @@ get_next:
 sync_out:
 	if (allocated)
 		sync_inode_page(&dn);
+	/* cache what we mapped while this dnode still pins the addresses */
+	if (ext_blkaddr != NULL_ADDR)
+		cache_extent_range(inode, ext_fofs, ext_blkaddr,
+						pgofs - ext_fofs);
 put_out:
 	f2fs_put_dnode(&dn);
 unlock_out:
@@ -760,10 +1031,13 @@ int do_write_data_page(struct page *page, struct f2fs_io_info *fio)
 			!is_cold_data(page) &&
 			need_inplace_update(inode))) {
 		rewrite_data_page(page, old_blkaddr, fio);
+		set_inode_flag(F2FS_I(inode), FI_UPDATE_WRITE);
 	} else {
 		write_data_page(page, &dn, &new_blkaddr, fio);
 		update_extent_cache(new_blkaddr, &dn);
+		set_inode_flag(F2FS_I(inode), FI_APPEND_WRITE);
 	}
+	F2FS_I(inode)->sync_pages++;
 out_writepage:
 	f2fs_put_dnode(&dn);
 	return err;
@@ -818,6 +1092,7 @@ write:
 
 		if (f2fs_has_inline_data(inode) || f2fs_may_inline(inode)) {
 			err = f2fs_write_inline_data(inode, page, offset);
+			set_inode_flag(F2FS_I(inode), FI_APPEND_WRITE);
 			f2fs_unlock_op(sbi);
 			goto out;
 		} else {
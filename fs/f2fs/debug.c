@@ -35,6 +35,10 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	/* valid check of the segment numbers */
 	si->hit_ext = sbi->read_hit_ext;
 	si->total_ext = sbi->total_hit_ext;
+	si->hit_rbtree = sbi->read_hit_rbtree;
+	si->ext_node = atomic_read(&sbi->total_ext_node);
+	si->ext_tree = atomic_read(&sbi->total_ext_tree);
+	si->shrunk_ext = sbi->shrunk_ext_node;
 	si->ndirty_node = get_pages(sbi, F2FS_DIRTY_NODES);
 	si->ndirty_dent = get_pages(sbi, F2FS_DIRTY_DENTS);
 	si->ndirty_dirs = sbi->n_dirty_dirs;
@@ -172,6 +176,8 @@ get_cache:
 	si->cache_mem += npages << PAGE_CACHE_SHIFT;
 	si->cache_mem += sbi->n_orphans * sizeof(struct orphan_inode_entry);
 	si->cache_mem += sbi->n_dirty_dirs * sizeof(struct dir_inode_entry);
+	si->cache_mem += atomic_read(&sbi->total_ext_node) *
+						sizeof(struct extent_node);
 }
 
 static int stat_show(struct seq_file *s, void *v)
@@ -245,6 +251,11 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "  - node blocks : %d\n", si->node_blks);
 		seq_printf(s, "\nExtent Hit Ratio: %d / %d\n",
 			   si->hit_ext, si->total_ext);
+		seq_printf(s, "  - largest: %d, rbtree: %d, miss: %d\n",
+			   si->hit_ext - si->hit_rbtree, si->hit_rbtree,
+			   si->total_ext - si->hit_ext);
+		seq_printf(s, "  - cached: %d extents in %d inodes (shrunk: %d)\n",
+			   si->ext_node, si->ext_tree, si->shrunk_ext);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - nodes: %4d in %4d\n",
 			   si->ndirty_node, si->node_pages);
@@ -175,6 +175,20 @@ struct extent_info {
 	unsigned int len;	/* length of the extent */
 };
 
+/*
+ * Besides the largest extent kept in the inode, each inode caches the
+ * mapped ranges it has looked up or written in an rbtree of extent_nodes.
+ * Nodes are linked to a per-sb LRU list so that they can be reclaimed.
+ */
+struct extent_node {
+	struct rb_node rb_node;		/* rb node located in rb-tree */
+	struct list_head list;		/* node in global extent list of sbi */
+	struct f2fs_inode_info *fi;	/* inode owning this extent */
+	unsigned int fofs;		/* start offset in a file */
+	u32 blk_addr;			/* start block address of the extent */
+	unsigned int len;		/* length of the extent */
+};
+
 /*
  * i_advise uses FADVISE_XXX_BIT. We can add additional hints later.
  */
@@ -197,6 +211,11 @@ struct f2fs_inode_info {
 	nid_t i_xattr_nid;		/* node id that contains xattrs */
 	unsigned long long xattr_ver;	/* cp version of xattr modification */
 	struct extent_info ext;		/* in-memory extent cache entry */
+	struct rb_root ext_tree;	/* cached extents, under ext.ext_lock */
+
+	/* write pattern detection for the fsync in-place-update policy */
+	unsigned int sync_pages;	/* data pages written since last fsync */
+	unsigned char small_fsyncs;	/* recent fsyncs of few pages in a row */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -443,6 +462,13 @@ struct f2fs_sb_info {
 	/* maximum # of trials to find a victim segment for SSR and GC */
 	unsigned int max_victim_search;
 
+	/* for extent cache */
+	struct list_head extent_list;		/* LRU list of extent nodes */
+	spinlock_t extent_lock;			/* lock for extent_list */
+	atomic_t total_ext_node;		/* # of cached extent nodes */
+	atomic_t total_ext_tree;		/* # of inodes having extents */
+	struct shrinker extent_shrinker;	/* reclaims extent nodes */
+
 	/*
 	 * for stat information.
 	 * one is for the LFS mode, and the other is for the SSR mode.
@@ -452,6 +478,8 @@ struct f2fs_sb_info {
 	unsigned int segment_count[2];		/* # of allocated segments */
 	unsigned int block_count[2];		/* # of allocated blocks */
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
+	int read_hit_rbtree;			/* hits served by the rbtree */
+	int shrunk_ext_node;			/* # of reclaimed extent nodes */
 	int inline_inode;			/* # of inline_data inodes */
 	int bg_gc;				/* background gc calls */
 	unsigned int n_dirty_dirs;		/* # of dir inodes */
@@ -915,9 +943,11 @@ enum {
 	FI_NO_ALLOC,		/* should not allocate any blocks */
 	FI_UPDATE_DIR,		/* should update inode block for consistency */
 	FI_DELAY_IPUT,		/* used for the recovery */
-	FI_NO_EXTENT,		/* not to use the extent cache */
 	FI_INLINE_XATTR,	/* used for inline xattr */
 	FI_INLINE_DATA,		/* used for inline data*/
+	FI_APPEND_WRITE,	/* data went to new blocks since last fsync */
+	FI_UPDATE_WRITE,	/* data was updated in place since last fsync */
+	FI_DIRTY_DATASYNC,	/* inode change that fdatasync must write */
 };
 
 static inline void set_inode_flag(struct f2fs_inode_info *fi, int flag)
@@ -1172,6 +1202,11 @@ void f2fs_submit_page_mbio(struct f2fs_sb_info *, struct page *, block_t,
 int reserve_new_block(struct dnode_of_data *);
 int f2fs_reserve_block(struct dnode_of_data *, pgoff_t);
 void update_extent_cache(block_t, struct dnode_of_data *);
+void f2fs_destroy_extent_tree(struct inode *);
+void f2fs_init_extent_cache(struct f2fs_sb_info *);
+void f2fs_exit_extent_cache(struct f2fs_sb_info *);
+int __init create_extent_cache(void);
+void destroy_extent_cache(void);
 struct page *find_data_page(struct inode *, pgoff_t, bool);
 struct page *get_lock_data_page(struct inode *, pgoff_t);
 struct page *get_new_data_page(struct inode *, struct page *, pgoff_t, bool);
@@ -1204,7 +1239,8 @@ struct f2fs_stat_info {
 	struct mutex stat_lock;
 	int all_area_segs, sit_area_segs, nat_area_segs, ssa_area_segs;
 	int main_area_segs, main_area_sections, main_area_zones;
-	int hit_ext, total_ext;
+	int hit_ext, total_ext, hit_rbtree;
+	int ext_node, ext_tree, shrunk_ext;
 	int ndirty_node, ndirty_dent, ndirty_dirs, ndirty_meta;
 	int nats, sits, fnids;
 	int total_count, utilization;
@@ -1237,6 +1273,8 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_dec_dirty_dir(sbi)		((sbi)->n_dirty_dirs--)
 #define stat_inc_total_hit(sb)		((F2FS_SB(sb))->total_hit_ext++)
 #define stat_inc_read_hit(sb)		((F2FS_SB(sb))->read_hit_ext++)
+#define stat_inc_rbtree_hit(sb)		((F2FS_SB(sb))->read_hit_rbtree++)
+#define stat_add_shrunk_ext(sbi, n)	((sbi)->shrunk_ext_node += (n))
 #define stat_inc_inline_inode(inode)					\
 	do {								\
 		if (f2fs_has_inline_data(inode))			\
@@ -1291,6 +1329,8 @@ void f2fs_destroy_root_stats(void);
 #define stat_dec_dirty_dir(sbi)
 #define stat_inc_total_hit(sb)
 #define stat_inc_read_hit(sb)
+#define stat_inc_rbtree_hit(sb)
+#define stat_add_shrunk_ext(sbi, n)
 #define stat_inc_inline_inode(inode)
 #define stat_dec_inline_inode(inode)
 #define stat_inc_seg_type(sbi, curseg)
@@ -119,9 +119,11 @@ static int get_parent_ino(struct inode *inode, nid_t *pino)
 int f2fs_sync_file(struct file *file, int datasync)
 {
 	struct inode *inode = file->f_mapping->host;
+	struct f2fs_inode_info *fi = F2FS_I(inode);
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
 	int ret = 0;
 	bool need_cp = false;
+	bool append, update, dirty_datasync;
 	struct writeback_control wbc = {
 		.sync_mode = WB_SYNC_NONE,
 		.nr_to_write = LONG_MAX,
@@ -131,6 +133,9 @@ int f2fs_sync_file(struct file *file, int datasync)
 	if (unlikely(f2fs_readonly(inode->i_sb)))
 		return 0;
 
+	/* the data pages were written back already, see vfs_fsync_range() */
+	update_fsync_pattern(inode);
+
 	/* guarantee free sections for fsync */
 	f2fs_balance_fs(sbi);
 
@@ -149,6 +154,32 @@ int f2fs_sync_file(struct file *file, int datasync)
 	else if (F2FS_I(inode)->xattr_ver == cur_cp_version(F2FS_CKPT(sbi)))
 		need_cp = true;
 
+	/*
+	 * Flags are cleared before syncing so that writes racing with us
+	 * are caught by the next fsync, and restored if we fail.
+	 */
+	append = is_inode_flag_set(fi, FI_APPEND_WRITE);
+	update = is_inode_flag_set(fi, FI_UPDATE_WRITE);
+	dirty_datasync = is_inode_flag_set(fi, FI_DIRTY_DATASYNC);
+	clear_inode_flag(fi, FI_APPEND_WRITE);
+	clear_inode_flag(fi, FI_UPDATE_WRITE);
+	clear_inode_flag(fi, FI_DIRTY_DATASYNC);
+
+	/*
+	 * fdatasync() after in-place updates only: no node block changed,
+	 * so there is nothing to roll forward and a cache flush suffices.
+	 * Every path that changes a block address in a dnode sets
+	 * FI_APPEND_WRITE or FI_DIRTY_DATASYNC: do_write_data_page(),
+	 * __allocate_data_block(), reserve_new_block() through
+	 * mark_inode_dirty() and truncate_data_blocks_range().
+	 */
+	if (datasync && !need_cp && !append && !dirty_datasync) {
+		if (update)
+			ret = blkdev_issue_flush(inode->i_sb->s_bdev,
+							GFP_KERNEL, NULL);
+		goto out;
+	}
+
 	if (need_cp) {
 		nid_t pino;
 
@@ -179,6 +210,14 @@ int f2fs_sync_file(struct file *file, int datasync)
 		ret = blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
 	}
 out:
+	if (ret) {
+		if (append)
+			set_inode_flag(fi, FI_APPEND_WRITE);
+		if (update)
+			set_inode_flag(fi, FI_UPDATE_WRITE);
+		if (dirty_datasync)
+			set_inode_flag(fi, FI_DIRTY_DATASYNC);
+	}
 	return ret;
 }
 
@@ -210,6 +249,7 @@ int truncate_data_blocks_range(struct dnode_of_data *dn, int count)
 	}
 	if (nr_free) {
 		dec_valid_block_count(sbi, dn->inode, nr_free);
+		set_inode_flag(F2FS_I(dn->inode), FI_DIRTY_DATASYNC);
 		set_page_dirty(dn->node_page);
 		sync_inode_page(dn);
 	}
@@ -36,15 +36,20 @@ static int gc_thread_func(void *data)
 	wait_ms = gc_th->min_sleep_time;
 
 	do {
+		unsigned int nr_gc = 1;
+
 		if (try_to_freeze())
 			continue;
 		else
 			wait_event_interruptible_timeout(*wq,
-						kthread_should_stop(),
+						kthread_should_stop() ||
+						gc_th->gc_wake,
 						msecs_to_jiffies(wait_ms));
 		if (kthread_should_stop())
 			break;
 
+		gc_th->gc_wake = false;
+
 		if (sbi->sb->s_frozen >= SB_FREEZE_WRITE) {
 			wait_ms = increase_sleep_time(gc_th, wait_ms);
 			continue;
@@ -72,16 +77,32 @@ static int gc_thread_func(void *data)
 			continue;
 		}
 
-		if (has_enough_invalid_blocks(sbi))
+		if (has_enough_invalid_blocks(sbi)) {
 			wait_ms = decrease_sleep_time(gc_th, wait_ms);
-		else
+
+			/* nobody is waiting on us, clean up in larger steps */
+			if (gc_th->screen_off && gc_th->screen_off_batch) {
+				nr_gc = gc_th->screen_off_batch;
+				wait_ms = gc_th->min_sleep_time;
+			}
+		} else {
 			wait_ms = increase_sleep_time(gc_th, wait_ms);
+		}
 
-		stat_inc_bggc_count(sbi);
+		/*
+		 * f2fs_gc() releases gc_mutex, so retake it for every section
+		 * and stop as soon as any other I/O shows up.
+		 */
+		do {
+			stat_inc_bggc_count(sbi);
 
-		/* if return value is not zero, no victim was selected */
-		if (f2fs_gc(sbi))
-			wait_ms = gc_th->no_gc_sleep_time;
+			/* if return value is not zero, no victim was selected */
+			if (f2fs_gc(sbi)) {
+				wait_ms = gc_th->no_gc_sleep_time;
+				break;
+			}
+		} while (--nr_gc && !kthread_should_stop() && is_idle(sbi) &&
+					mutex_trylock(&sbi->gc_mutex));
 
 		/* balancing f2fs's metadata periodically */
 		f2fs_balance_fs_bg(sbi);
@@ -90,6 +111,26 @@ static int gc_thread_func(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void f2fs_gc_early_suspend(struct early_suspend *h)
+{
+	struct f2fs_gc_kthread *gc_th =
+		container_of(h, struct f2fs_gc_kthread, early_suspend);
+
+	gc_th->screen_off = true;
+	gc_th->gc_wake = true;
+	wake_up_interruptible_all(&gc_th->gc_wait_queue_head);
+}
+
+static void f2fs_gc_late_resume(struct early_suspend *h)
+{
+	struct f2fs_gc_kthread *gc_th =
+		container_of(h, struct f2fs_gc_kthread, early_suspend);
+
+	gc_th->screen_off = false;
+}
+#endif
+
 int start_gc_thread(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_gc_kthread *gc_th;
@@ -110,6 +151,10 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	gc_th->gc_idle = 0;
 
+	gc_th->screen_off_batch = DEF_GC_THREAD_SCREEN_OFF_BATCH;
+	gc_th->screen_off = false;
+	gc_th->gc_wake = false;
+
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
@@ -118,7 +163,15 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 		err = PTR_ERR(gc_th->f2fs_gc_task);
 		kfree(gc_th);
 		sbi->gc_thread = NULL;
+		goto out;
 	}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	gc_th->early_suspend.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1;
+	gc_th->early_suspend.suspend = f2fs_gc_early_suspend;
+	gc_th->early_suspend.resume = f2fs_gc_late_resume;
+	register_early_suspend(&gc_th->early_suspend);
+#endif
 out:
 	return err;
 }
@@ -128,6 +181,9 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	if (!gc_th)
 		return;
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	unregister_early_suspend(&gc_th->early_suspend);
+#endif
 	kthread_stop(gc_th->f2fs_gc_task);
 	kfree(gc_th);
 	sbi->gc_thread = NULL;
@@ -250,6 +306,77 @@ static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 		return get_cb_cost(sbi, segno);
 }
 
+/*
+ * The lowest cost-benefit cost a section with vblocks valid blocks can
+ * have, i.e. its cost when it is the oldest section.
+ */
+static unsigned int get_cb_cost_bound(struct f2fs_sb_info *sbi,
+						unsigned int vblocks)
+{
+	unsigned int u;
+
+	vblocks = vblocks / sbi->segs_per_sec;
+	u = (vblocks * 100) >> sbi->log_blocks_per_seg;
+
+	return UINT_MAX - ((100 * (100 - u) * 100) / (100 + u));
+}
+
+/*
+ * LFS victim selection walks the victim index from the emptiest
+ * sections up instead of scanning the dirty segmap. Greedy stops at the
+ * first usable section; cost-benefit stops once
+ * even the oldest section of the next bucket could not beat the best
+ * cost found so far.
+ */
+static void get_victim_from_index(struct f2fs_sb_info *sbi,
+			struct victim_sel_policy *p, int gc_type)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int bucket = 0;
+	int nsearched = 0;
+
+	while (1) {
+		struct victim_entry *ve;
+
+		bucket = find_next_bit(dirty_i->victim_bucket_map,
+					dirty_i->nr_victim_buckets, bucket);
+		if (bucket >= dirty_i->nr_victim_buckets)
+			break;
+
+		if (p->min_segno != NULL_SEGNO) {
+			if (p->gc_mode == GC_GREEDY)
+				break;
+			if (get_cb_cost_bound(sbi, bucket) >= p->min_cost)
+				break;
+		}
+
+		list_for_each_entry(ve, &dirty_i->victim_buckets[bucket], list) {
+			unsigned int secno = ve - dirty_i->victim_entries;
+			unsigned int segno = secno * sbi->segs_per_sec;
+			unsigned long cost;
+
+			if (sec_usage_check(sbi, secno))
+				continue;
+			if (gc_type == BG_GC &&
+					test_bit(secno, dirty_i->victim_secmap))
+				continue;
+
+			cost = get_gc_cost(sbi, segno, p);
+			if (p->min_cost > cost) {
+				p->min_segno = segno;
+				p->min_cost = cost;
+			}
+
+			/* the rest of a greedy bucket costs just the same */
+			if (p->gc_mode == GC_GREEDY && p->min_segno != NULL_SEGNO)
+				return;
+			if (++nsearched >= p->max_search)
+				return;
+		}
+		bucket++;
+	}
+}
+
 /*
  * This function is called from two paths.
  * One is garbage collection and the other is SSR segment selection.
@@ -280,6 +407,11 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	if (p.alloc_mode == LFS) {
+		get_victim_from_index(sbi, &p, gc_type);
+		goto out;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -320,6 +452,7 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			break;
 		}
 	}
+out:
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		if (p.alloc_mode == LFS) {
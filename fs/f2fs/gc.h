@@ -8,11 +8,13 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
+#include <linux/earlysuspend.h>
 
 #define GC_THREAD_MIN_WB_PAGES		1	/* Threshold to determine whether IO subsystem is idle */
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_SCREEN_OFF_BATCH	16	/* sections per wakeup */
 #define LIMIT_INVALID_BLOCK		40 	/* percentage over total user space */
 #define LIMIT_FREE_BLOCK		40 	/* percentage over invalid + free space */
 
@@ -30,6 +32,17 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/*
+	 * While the screen is off, collect up to screen_off_batch sections
+	 * per wakeup as long as the device stays idle.
+	 */
+	unsigned int screen_off_batch;
+	bool screen_off;
+	bool gc_wake;
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	struct early_suspend early_suspend;
+#endif
 };
 
 struct inode_entry {
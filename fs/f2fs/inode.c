@@ -279,5 +279,6 @@ void f2fs_evict_inode(struct inode *inode)
 	f2fs_unlock_op(sbi);
 
 no_delete:
+	f2fs_destroy_extent_tree(inode);
 	end_writeback(inode);
 }
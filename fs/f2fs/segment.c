@@ -194,6 +194,46 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *sbi)
 		f2fs_sync_fs(sbi->sb, true);
 }
 
+static void __del_victim_entry(struct dirty_seglist_info *dirty_i,
+					struct victim_entry *ve)
+{
+	list_del_init(&ve->list);
+	if (list_empty(&dirty_i->victim_buckets[ve->vblocks]))
+		clear_bit(ve->vblocks, dirty_i->victim_bucket_map);
+}
+
+/*
+ * Keep the section of segno in the victim index bucket matching its
+ * current valid blocks, or drop it once none of its segments is dirty.
+ * This should be called under seglist_lock.
+ */
+static void __update_victim_entry(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int secno = GET_SECNO(sbi, segno);
+	unsigned int start = secno * sbi->segs_per_sec;
+	unsigned int end = start + sbi->segs_per_sec;
+	struct victim_entry *ve = &dirty_i->victim_entries[secno];
+	unsigned int vblocks;
+
+	if (find_next_bit(dirty_i->dirty_segmap[DIRTY], end, start) >= end) {
+		if (!list_empty(&ve->list))
+			__del_victim_entry(dirty_i, ve);
+		return;
+	}
+
+	vblocks = get_valid_blocks(sbi, segno, sbi->segs_per_sec);
+	if (!list_empty(&ve->list)) {
+		if (ve->vblocks == vblocks)
+			return;
+		__del_victim_entry(dirty_i, ve);
+	}
+
+	ve->vblocks = vblocks;
+	list_add_tail(&ve->list, &dirty_i->victim_buckets[vblocks]);
+	set_bit(vblocks, dirty_i->victim_bucket_map);
+}
+
 static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		enum dirty_type dirty_type)
 {
@@ -212,6 +252,8 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 
 		if (!test_and_set_bit(segno, dirty_i->dirty_segmap[t]))
 			dirty_i->nr_dirty[t]++;
+
+		__update_victim_entry(sbi, segno);
 	}
 }
 
@@ -233,24 +275,32 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		if (get_valid_blocks(sbi, segno, sbi->segs_per_sec) == 0)
 			clear_bit(GET_SECNO(sbi, segno),
 						dirty_i->victim_secmap);
+
+		__update_victim_entry(sbi, segno);
 	}
 }
 
 /*
  * Should not occur error such as -ENOMEM.
  * Adding dirty entry into seglist is not critical operation.
- * If a given segment is one of current working segments, it won't be added.
+ * If a given segment is one of current working segments, it won't be added,
+ * but the victim index entry of its section is still kept up to date.
  */
 static void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	unsigned short valid_blocks;
 
-	if (segno == NULL_SEGNO || IS_CURSEG(sbi, segno))
+	if (segno == NULL_SEGNO)
 		return;
 
 	mutex_lock(&dirty_i->seglist_lock);
 
+	if (IS_CURSEG(sbi, segno)) {
+		__update_victim_entry(sbi, segno);
+		goto out;
+	}
+
 	valid_blocks = get_valid_blocks(sbi, segno, 0);
 
 	if (valid_blocks == 0) {
@@ -262,7 +312,7 @@ static void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
 		/* Recovery routine with SSR needs this */
 		__remove_dirty_segment(sbi, segno, DIRTY);
 	}
-
+out:
 	mutex_unlock(&dirty_i->seglist_lock);
 }
 
@@ -1722,10 +1772,40 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 	return 0;
 }
 
+static int init_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int nr_buckets = sbi->blocks_per_seg * sbi->segs_per_sec + 1;
+	unsigned int i;
+
+	dirty_i->victim_entries = vzalloc(TOTAL_SECS(sbi) *
+					sizeof(struct victim_entry));
+	if (!dirty_i->victim_entries)
+		return -ENOMEM;
+
+	dirty_i->victim_buckets = kmalloc(nr_buckets *
+					sizeof(struct list_head), GFP_KERNEL);
+	if (!dirty_i->victim_buckets)
+		return -ENOMEM;
+
+	dirty_i->victim_bucket_map = kzalloc(f2fs_bitmap_size(nr_buckets),
+								GFP_KERNEL);
+	if (!dirty_i->victim_bucket_map)
+		return -ENOMEM;
+
+	for (i = 0; i < TOTAL_SECS(sbi); i++)
+		INIT_LIST_HEAD(&dirty_i->victim_entries[i].list);
+	for (i = 0; i < nr_buckets; i++)
+		INIT_LIST_HEAD(&dirty_i->victim_buckets[i]);
+	dirty_i->nr_victim_buckets = nr_buckets;
+	return 0;
+}
+
 static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
 	unsigned int bitmap_size, i;
+	int err;
 
 	/* allocate memory for dirty segments list information */
 	dirty_i = kzalloc(sizeof(struct dirty_seglist_info), GFP_KERNEL);
@@ -1743,6 +1823,10 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	err = init_victim_index(sbi);
+	if (err)
+		return err;
+
 	init_dirty_segmap(sbi);
 	return init_victim_secmap(sbi);
 }
@@ -1798,7 +1882,7 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	sm_info->main_segments = le32_to_cpu(raw_super->segment_count_main);
 	sm_info->ssa_blkaddr = le32_to_cpu(raw_super->ssa_blkaddr);
 	sm_info->rec_prefree_segments = DEF_RECLAIM_PREFREE_SEGMENTS;
-	sm_info->ipu_policy = F2FS_IPU_DISABLE;
+	sm_info->ipu_policy = F2FS_IPU_FSYNC;
 	sm_info->min_ipu_util = DEF_MIN_IPU_UTIL;
 
 	INIT_LIST_HEAD(&sm_info->discard_list);
@@ -1844,6 +1928,15 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 	kfree(dirty_i->victim_secmap);
 }
 
+static void destroy_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+
+	kfree(dirty_i->victim_bucket_map);
+	kfree(dirty_i->victim_buckets);
+	vfree(dirty_i->victim_entries);
+}
+
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
@@ -1857,6 +1950,7 @@ static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 		discard_dirty_segmap(sbi, i);
 
 	destroy_victim_secmap(sbi);
+	destroy_victim_index(sbi);
 	SM_I(sbi)->dirty_info = NULL;
 	kfree(dirty_i);
 }
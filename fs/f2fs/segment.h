@@ -210,12 +210,28 @@ enum dirty_type {
 	NR_DIRTY_TYPE
 };
 
+/* a section in the victim index, see dirty_seglist_info */
+struct victim_entry {
+	struct list_head list;			/* link in victim_buckets */
+	unsigned int vblocks;			/* valid blocks when indexed */
+};
+
 struct dirty_seglist_info {
 	const struct victim_selection *v_ops;	/* victim selction operation */
 	unsigned long *dirty_segmap[NR_DIRTY_TYPE];
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+
+	/*
+	 * victim index: sections having DIRTY segments, bucketed by their
+	 * valid block count and kept up to date as segments get dirty, so
+	 * that LFS victim selection does not rescan the dirty segmap.
+	 */
+	struct victim_entry *victim_entries;	/* one per section */
+	struct list_head *victim_buckets;	/* indexed by valid blocks */
+	unsigned long *victim_bucket_map;	/* non-empty buckets */
+	unsigned int nr_victim_buckets;
 };
 
 /* victim selection function for cleaning and SSR */
@@ -485,7 +501,9 @@ static inline int utilization(struct f2fs_sb_info *sbi)
  * F2FS_IPU_UTIL - if FS utilization is over threashold,
  * F2FS_IPU_SSR_UTIL - if SSR mode is activated and FS utilization is over
  *                     threashold,
- * F2FS_IPUT_DISABLE - disable IPU. (=default option)
+ * F2FS_IPUT_DISABLE - disable IPU.
+ * F2FS_IPU_FSYNC - if the file is fsynced often with only a few dirty pages,
+ *                  e.g. a database file. (=default option)
  */
 #define DEF_MIN_IPU_UTIL	70
 
@@ -495,8 +513,32 @@ enum {
 	F2FS_IPU_UTIL,
 	F2FS_IPU_SSR_UTIL,
 	F2FS_IPU_DISABLE,
+	F2FS_IPU_FSYNC,
 };
 
+/*
+ * A file counts as fsync-heavy after FSYNC_HEAVY_STREAK fsyncs in a row
+ * each writing at most SMALL_FSYNC_PAGES data pages.
+ */
+#define SMALL_FSYNC_PAGES	16
+#define FSYNC_HEAVY_STREAK	3
+
+static inline bool is_fsync_heavy(struct inode *inode)
+{
+	return F2FS_I(inode)->small_fsyncs >= FSYNC_HEAVY_STREAK;
+}
+
+static inline void update_fsync_pattern(struct inode *inode)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+
+	if (fi->sync_pages > SMALL_FSYNC_PAGES)
+		fi->small_fsyncs = 0;
+	else if (fi->small_fsyncs < FSYNC_HEAVY_STREAK)
+		fi->small_fsyncs++;
+	fi->sync_pages = 0;
+}
+
 static inline bool need_inplace_update(struct inode *inode)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
@@ -522,6 +564,14 @@ static inline bool need_inplace_update(struct inode *inode)
 		break;
 	case F2FS_IPU_DISABLE:
 		break;
+	case F2FS_IPU_FSYNC:
+		/*
+		 * Updating in place keeps the node blocks untouched, so the
+		 * next fsync does not have to write them again.
+		 */
+		if (is_fsync_heavy(inode))
+			return true;
+		break;
 	}
 	return false;
 }
@@ -23,8 +23,16 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+#define FUSE_SUPER_MAGIC 0x65735546
+
+/** Default max number of pages that can be used in a single read request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Upper limit for the max_pages value negotiated in INIT (1MB requests) */
+#define FUSE_MAX_MAX_PAGES 256
+
+/** Number of page pointers embedded in struct fuse_req */
+#define FUSE_REQ_INLINE_PAGES 1
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -140,6 +148,9 @@ struct fuse_file {
 
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
+
+	/** Lower file that reads, writes and mmaps are passed to */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -290,7 +301,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the 'pages' array */
+	unsigned max_pages;
+
+	/** inline page vector */
+	struct page *inline_pages[FUSE_REQ_INLINE_PAGES];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -312,6 +329,47 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Lower file passed by the OPEN or CREATE reply */
+	struct file *passthrough_filp;
+};
+
+/**
+ * A per-CPU request queue
+ *
+ * Requests submitted on a CPU are queued here instead of the shared
+ * pending list while at least one device file is bound to the queue.
+ */
+struct fuse_queue {
+	/** Readers of the queue are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** Number of device files bound to this queue */
+	unsigned num_devs;
+};
+
+/**
+ * A Fuse device instance
+ *
+ * There is one for each open /dev/fuse file attached to a connection:
+ * the one passed to mount and any clones made with FUSE_DEV_IOC_CLONE.
+ * A reply must be written to the device the request was read from.
+ */
+struct fuse_dev {
+	/** The connection this device belongs to */
+	struct fuse_conn *fc;
+
+	/** Bound request queue, or NULL to read the shared queue */
+	struct fuse_queue *fq;
+
+	/** The list of requests being processed by this device */
+	struct list_head processing;
+
+	/** Entry on fc->devices */
+	struct list_head entry;
 };
 
 /**
@@ -346,14 +404,20 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq[2];
 
 	/** The list of pending requests */
 	struct list_head pending[2];
 
-	/** The list of requests being processed */
-	struct list_head processing;
+	/** Per-CPU request queues, allocated on the first bind */
+	struct fuse_queue *queues;
+
+	/** Device files attached to this connection */
+	struct list_head devices;
 
 	/** The list of requests under I/O */
 	struct list_head io;
@@ -477,6 +541,12 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Use writeback cache for buffered writes.  Only set in INIT */
+	unsigned writeback_cache:1;
+
+	/** Files may be opened in passthrough mode.  Only set in INIT */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -649,7 +719,9 @@ void fuse_ctl_cleanup(void);
  */
 struct fuse_req *fuse_request_alloc(void);
 
-struct fuse_req *fuse_request_alloc_nofs(void);
+struct fuse_req *fuse_request_alloc_pages(unsigned npages);
+
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages);
 
 /**
  * Free a request
@@ -661,6 +733,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for 'npages' pages, may fail with -ENOMEM
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -688,6 +765,9 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 /* Abort all requests */
 void fuse_abort_conn(struct fuse_conn *fc);
 
+/* Wake up readers waiting on any of the connection's queues */
+void fuse_wake_up_readers(struct fuse_conn *fc);
+
 /**
  * Invalidate inode attributes
  */
@@ -766,6 +846,30 @@ long fuse_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg,
 unsigned fuse_file_poll(struct file *file, poll_table *wait);
 int fuse_dev_release(struct inode *inode, struct file *file);
 
+/**
+ * Attach a new device instance to the connection
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+
+/**
+ * Detach and free a device instance that never got used
+ */
+void fuse_dev_free(struct fuse_dev *fud);
+
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+int fuse_flush_times(struct inode *inode, struct fuse_file *ff);
+int fuse_write_inode(struct inode *inode, struct writeback_control *wbc);
+
+/* passthrough.c */
+void fuse_passthrough_get_lower(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_setup(struct fuse_file *ff, struct file *file,
+			    struct file *lower);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,186 @@
+/*
+ * FUSE: Filesystem in Userspace - passthrough mode
+ *
+ * This program can be distributed under the terms of the GNU GPL.
+ * See the file COPYING.
+ *
+ * A filesystem that only relays data to a file on another filesystem
+ * can return that file's descriptor with FOPEN_PASSTHROUGH in the reply
+ * to OPEN or CREATE.  Reads, writes and mmaps on the FUSE file are then
+ * done directly on the lower file, while everything else (lookup,
+ * attributes, flush, release, locks) still goes to the filesystem.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+#include <linux/uio.h>
+
+/*
+ * Look up the lower file named in an OPEN or CREATE reply.  This runs
+ * in the context of the filesystem daemon writing the reply, so the
+ * descriptor is resolved in its file table.
+ */
+void fuse_passthrough_get_lower(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *lower;
+	struct inode *inode;
+
+	if (!fc->passthrough)
+		return;
+	if (req->in.h.opcode != FUSE_OPEN && req->in.h.opcode != FUSE_CREATE)
+		return;
+
+	/* fuse_open_out is the last argument of both replies */
+	outarg = req->out.args[req->out.numargs - 1].value;
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	lower = fget(outarg->passthrough_fd);
+	if (!lower)
+		return;
+
+	/* Don't stack FUSE on FUSE, that could recurse through the daemon */
+	inode = lower->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC) {
+		fput(lower);
+		return;
+	}
+
+	req->passthrough_filp = lower;
+}
+
+static bool fuse_passthrough_compatible(struct file *file, struct file *lower)
+{
+	const struct file_operations *fop = lower->f_op;
+
+	if (!fop)
+		return false;
+	if ((file->f_mode & FMODE_READ) &&
+	    (!(lower->f_mode & FMODE_READ) || !fop->aio_read))
+		return false;
+	if ((file->f_mode & FMODE_WRITE) &&
+	    (!(lower->f_mode & FMODE_WRITE) || !fop->aio_write))
+		return false;
+	if ((file->f_flags ^ lower->f_flags) & O_APPEND)
+		return false;
+
+	return true;
+}
+
+/*
+ * Attach the lower file taken from the open request, consuming the
+ * reference.  If the lower file can't serve the access mode of the
+ * open, fall back to regular I/O through the filesystem.
+ */
+void fuse_passthrough_setup(struct fuse_file *ff, struct file *file,
+			    struct file *lower)
+{
+	if (!lower)
+		return;
+
+	if (!fuse_passthrough_compatible(file, lower)) {
+		fput(lower);
+		return;
+	}
+
+	ff->passthrough_filp = lower;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_aio_rw(struct kiocb *iocb,
+				       const struct iovec *iov,
+				       unsigned long nr_segs, loff_t pos,
+				       int write)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = iov_length(iov, nr_segs);
+	kiocb.ki_nbytes = kiocb.ki_left;
+
+	if (write)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+
+	if (ret > 0) {
+		if (write)
+			fsnotify_modify(lower);
+		else
+			fsnotify_access(lower);
+	}
+
+	iocb->ki_pos = kiocb.ki_pos;
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_aio_rw(iocb, iov, nr_segs, pos, 0);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	ssize_t ret;
+
+	ret = fuse_passthrough_aio_rw(iocb, iov, nr_segs, pos, 1);
+	if (ret > 0)
+		fuse_write_update_size(inode, iocb->ki_pos);
+
+	/* the lower file changed size and times behind our back */
+	fuse_invalidate_attr(inode);
+
+	return ret;
+}
+
+/*
+ * Map the lower file directly.  The vma then belongs to the lower
+ * inode's address space, so faults never reach the FUSE page cache.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma->vm_file = lower;
+	get_file(lower);
+
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+
+	return ret;
+}
@@ -40,7 +40,7 @@ static int yaffs_checkpt_erase(struct yaffs_dev *dev)
 			yaffs_trace(YAFFS_TRACE_CHECKPOINT,
 			"erasing checkpt block %d", i);
 
-			dev->n_erasures++;
+			yaffs_count_erasure(dev, i);
 
 			if (dev->param.
 			    erase_fn(dev,
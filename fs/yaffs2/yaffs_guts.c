@@ -1560,24 +1560,32 @@ static struct yaffs_cache *yaffs_grab_chunk_cache(struct yaffs_dev *dev)
 }
 
 /* Find a cached chunk */
-static struct yaffs_cache *yaffs_find_chunk_cache(const struct yaffs_obj *obj,
-						  int chunk_id)
+static struct yaffs_cache *yaffs_lookup_chunk_cache(const struct yaffs_obj *obj,
+						    int chunk_id)
 {
 	struct yaffs_dev *dev = obj->my_dev;
 	int i;
 	if (dev->param.n_caches > 0) {
 		for (i = 0; i < dev->param.n_caches; i++) {
 			if (dev->cache[i].object == obj &&
-			    dev->cache[i].chunk_id == chunk_id) {
-				dev->cache_hits++;
-
+			    dev->cache[i].chunk_id == chunk_id)
 				return &dev->cache[i];
-			}
 		}
 	}
 	return NULL;
 }
 
+static struct yaffs_cache *yaffs_find_chunk_cache(const struct yaffs_obj *obj,
+						  int chunk_id)
+{
+	struct yaffs_cache *cache = yaffs_lookup_chunk_cache(obj, chunk_id);
+
+	if (cache)
+		obj->my_dev->cache_hits++;
+
+	return cache;
+}
+
 /* Mark the chunk for the least recently used algorithym */
 static void yaffs_use_cache(struct yaffs_dev *dev, struct yaffs_cache *cache,
 			    int is_write)
@@ -2327,9 +2335,22 @@ static int yaffs_init_blocks(struct yaffs_dev *dev)
 	}
 
 	if (dev->block_info && dev->chunk_bits) {
+		dev->block_erase_count =
+			kmalloc(n_blocks * sizeof(u32), GFP_NOFS);
+		if (!dev->block_erase_count) {
+			dev->block_erase_count =
+			    vmalloc(n_blocks * sizeof(u32));
+			dev->erase_count_alt = 1;
+		} else {
+			dev->erase_count_alt = 0;
+		}
+	}
+
+	if (dev->block_info && dev->chunk_bits && dev->block_erase_count) {
 		memset(dev->block_info, 0,
 		       n_blocks * sizeof(struct yaffs_block_info));
 		memset(dev->chunk_bits, 0, dev->chunk_bit_stride * n_blocks);
+		memset(dev->block_erase_count, 0, n_blocks * sizeof(u32));
 		return YAFFS_OK;
 	}
 
@@ -2353,6 +2374,62 @@ static void yaffs_deinit_blocks(struct yaffs_dev *dev)
 		kfree(dev->chunk_bits);
 	dev->chunk_bits_alt = 0;
 	dev->chunk_bits = NULL;
+
+	if (dev->erase_count_alt && dev->block_erase_count)
+		vfree(dev->block_erase_count);
+	else if (dev->block_erase_count)
+		kfree(dev->block_erase_count);
+	dev->erase_count_alt = 0;
+	dev->block_erase_count = NULL;
+}
+
+/*
+ * Erase counts are only kept in RAM, since mount; yaffs has no on-flash
+ * erase count.  They are used to steer gc away from worn blocks.
+ */
+void yaffs_count_erasure(struct yaffs_dev *dev, int block_no)
+{
+	dev->n_erasures++;
+
+	if (dev->block_erase_count &&
+	    block_no >= dev->internal_start_block &&
+	    block_no <= dev->internal_end_block)
+		dev->block_erase_count[block_no - dev->internal_start_block]++;
+}
+
+u32 yaffs_hist_bucket(u32 val)
+{
+	u32 bucket = fls(val);
+
+	return bucket < YAFFS_HIST_BUCKETS ? bucket : YAFFS_HIST_BUCKETS - 1;
+}
+
+/*
+ * Extra "pages in use" charged to a gc candidate that has been erased
+ * more than the average block, so that of two similarly dirty blocks the
+ * less worn one is collected.
+ */
+static int yaffs_gc_wear_cost(struct yaffs_dev *dev, int block_no)
+{
+	int n_blocks = dev->internal_end_block - dev->internal_start_block + 1;
+	u32 avg;
+	u32 count;
+	u32 cost;
+
+	if (!dev->param.gc_wear_weight || !dev->block_erase_count ||
+	    block_no < dev->internal_start_block)
+		return 0;
+
+	avg = dev->n_erasures / n_blocks;
+	count = dev->block_erase_count[block_no - dev->internal_start_block];
+	if (count <= avg)
+		return 0;
+
+	cost = (count - avg) * dev->param.gc_wear_weight;
+	if (cost > dev->param.chunks_per_block)
+		cost = dev->param.chunks_per_block;
+
+	return cost;
 }
 
 void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
@@ -2763,6 +2840,7 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 
 	if (!selected) {
 		int pages_used;
+		int wear_cost;
 		int n_blocks =
 		    dev->internal_end_block - dev->internal_start_block + 1;
 		if (aggressive) {
@@ -2804,10 +2882,18 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 
 			pages_used = bi->pages_in_use - bi->soft_del_pages;
 
+			/* Unless space is short, weigh in wear as well */
+			if (!aggressive)
+				wear_cost = yaffs_gc_wear_cost(dev,
+							dev->gc_block_finder) -
+				    yaffs_gc_wear_cost(dev, dev->gc_dirtiest);
+			else
+				wear_cost = 0;
+
 			if (bi->block_state == YAFFS_BLOCK_STATE_FULL &&
 			    pages_used < dev->param.chunks_per_block &&
 			    (dev->gc_dirtiest < 1
-			     || pages_used < dev->gc_pages_in_use)
+			     || pages_used + wear_cost < dev->gc_pages_in_use)
 			    && yaffs_block_ok_for_gc(dev, bi)) {
 				dev->gc_dirtiest = dev->gc_block_finder;
 				dev->gc_pages_in_use = pages_used;
@@ -2883,6 +2969,8 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 	int min_erased;
 	int erased_chunks;
 	int checkpt_block_adjust;
+	u64 gc_start;
+	u64 gc_us;
 
 	if (dev->param.gc_control && (dev->param.gc_control(dev) & 1) == 0)
 		return YAFFS_OK;
@@ -2950,7 +3038,12 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 				"yaffs: GC n_erased_blocks %d aggressive %d",
 				dev->n_erased_blocks, aggressive);
 
+			gc_start = Y_CLOCK_US();
 			gc_ok = yaffs_gc_block(dev, dev->gc_block, aggressive);
+			gc_us = Y_CLOCK_US() - gc_start;
+			dev->gc_latency_hist[background ? 1 : 0]
+			    [yaffs_hist_bucket(gc_us > 0xffffffff ?
+					       0xffffffff : (u32) gc_us)]++;
 		}
 
 		if (dev->n_erased_blocks < (dev->param.n_reserved_blocks)
@@ -3617,6 +3710,55 @@ int yaffs_file_rd(struct yaffs_obj *in, u8 * buffer, loff_t offset, int n_bytes)
 	return n_done;
 }
 
+/*
+ * Read as much of a range as can be served without going to the flash:
+ * chunks that are in the chunk cache, and holes.  Nothing here modifies
+ * device state other than the cache LRU stamp, so it may be called with
+ * the device lock held shared.  Returns the number of bytes read, which
+ * stops short at the first chunk that needs a flash read.
+ */
+int yaffs_file_rd_cached(struct yaffs_obj *in, u8 * buffer, loff_t offset,
+			 int n_bytes)
+{
+	int chunk;
+	u32 start;
+	int n_copy;
+	int n = n_bytes;
+	int n_done = 0;
+	struct yaffs_cache *cache;
+	struct yaffs_dev *dev = in->my_dev;
+
+	while (n > 0) {
+		yaffs_addr_to_chunk(dev, offset, &chunk, &start);
+		chunk++;
+
+		if ((start + n) < dev->data_bytes_per_chunk)
+			n_copy = n;
+		else
+			n_copy = dev->data_bytes_per_chunk - start;
+
+		cache = yaffs_lookup_chunk_cache(in, chunk);
+		if (cache) {
+			/* Racy but only an LRU hint; a lost update ages the entry */
+			cache->last_use = dev->cache_last_use;
+			memcpy(buffer, &cache->data[start], n_copy);
+		} else if (dev->chunk_grp_size == 1 &&
+			   yaffs_find_chunk_in_file(in, chunk, NULL) < 0) {
+			/* A hole reads as zeros, same as yaffs_rd_data_obj() */
+			memset(buffer, 0, n_copy);
+		} else {
+			break;
+		}
+
+		n -= n_copy;
+		offset += n_copy;
+		buffer += n_copy;
+		n_done += n_copy;
+	}
+
+	return n_done;
+}
+
 int yaffs_do_file_wr(struct yaffs_obj *in, const u8 * buffer, loff_t offset,
 		     int n_bytes, int write_trhrough)
 {
@@ -4958,6 +5100,7 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	}
 
 	dev->cache_hits = 0;
+	memset(dev->gc_latency_hist, 0, sizeof(dev->gc_latency_hist));
 
 	if (!init_failed) {
 		dev->gc_cleanup_list =
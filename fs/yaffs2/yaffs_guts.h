@@ -87,6 +87,9 @@
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
+/* Log2 buckets for the gc latency (microseconds) and erase count histograms */
+#define YAFFS_HIST_BUCKETS		16
+
 /* We limit the number attempts at sucessfully saving a chunk of data.
  * Small-page devices have 32 pages per block; large-page devices have 64.
  * Default to something in the order of 5 to 10 blocks worth of chunks.
@@ -574,6 +577,8 @@ struct yaffs_param {
 	int auto_unicode;
 #endif
 	int always_check_erased;	/* Force chunk erased check always on */
+
+	int gc_wear_weight;	/* GC victim penalty per erase above average, 0 = off */
 };
 
 struct yaffs_dev {
@@ -637,6 +642,8 @@ struct yaffs_dev {
 	u8 *chunk_bits;		/* bitmap of chunks in use */
 	unsigned block_info_alt:1;	/* was allocated using alternative strategy */
 	unsigned chunk_bits_alt:1;	/* was allocated using alternative strategy */
+	unsigned erase_count_alt:1;	/* was allocated using alternative strategy */
+	u32 *block_erase_count;	/* erasures per block since mount */
 	int chunk_bit_stride;	/* Number of bytes of chunk_bits per block.
 				 * Must be consistent with chunks_per_block.
 				 */
@@ -734,6 +741,7 @@ struct yaffs_dev {
 	u32 n_unmarked_deletions;
 	u32 refresh_count;
 	u32 cache_hits;
+	u32 gc_latency_hist[2][YAFFS_HIST_BUCKETS];	/* [0] inline, [1] background */
 
 };
 
@@ -801,6 +809,8 @@ int yaffs_get_obj_link_count(struct yaffs_obj *obj);
 /* File operations */
 int yaffs_file_rd(struct yaffs_obj *obj, u8 * buffer, loff_t offset,
 		  int n_bytes);
+int yaffs_file_rd_cached(struct yaffs_obj *obj, u8 * buffer, loff_t offset,
+			 int n_bytes);
 int yaffs_wr_file(struct yaffs_obj *obj, const u8 * buffer, loff_t offset,
 		  int n_bytes, int write_trhrough);
 int yaffs_resize_file(struct yaffs_obj *obj, loff_t new_size);
@@ -885,6 +895,8 @@ void yaffs_add_obj_to_dir(struct yaffs_obj *directory, struct yaffs_obj *obj);
 YCHAR *yaffs_clone_str(const YCHAR * str);
 void yaffs_link_fixup(struct yaffs_dev *dev, struct yaffs_obj *hard_list);
 void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no);
+void yaffs_count_erasure(struct yaffs_dev *dev, int block_no);
+u32 yaffs_hist_bucket(u32 val);
 int yaffs_update_oh(struct yaffs_obj *in, const YCHAR * name,
 		    int force, int is_shrink, int shadows,
 		    struct yaffs_xattr_mod *xop);
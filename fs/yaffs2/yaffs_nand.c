@@ -110,9 +110,9 @@ int yaffs_erase_block(struct yaffs_dev *dev, int flash_block)
 {
 	int result;
 
-	flash_block -= dev->block_offset;
+	yaffs_count_erasure(dev, flash_block);
 
-	dev->n_erasures++;
+	flash_block -= dev->block_offset;
 
 	result = dev->param.erase_fn(dev, flash_block);
 
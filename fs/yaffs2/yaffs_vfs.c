@@ -97,6 +97,8 @@ unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+unsigned int yaffs_bg_idle_ms = 1000;
+unsigned int yaffs_gc_wear_weight = 2;
 
 /* Module Parameters */
 module_param(yaffs_trace_mask, uint, 0644);
@@ -104,6 +106,8 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_bg_idle_ms, uint, 0644);
+module_param(yaffs_gc_wear_weight, uint, 0644);
 
 #define yaffs_inode_to_obj_lv(iptr) ((iptr)->i_private)
 #define yaffs_inode_to_obj(iptr) ((struct yaffs_obj *)(yaffs_inode_to_obj_lv(iptr)))
@@ -122,14 +126,32 @@ static unsigned yaffs_gc_control_callback(struct yaffs_dev *dev)
 static void yaffs_gross_lock(struct yaffs_dev *dev)
 {
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locking %p", current);
-	mutex_lock(&(yaffs_dev_to_lc(dev)->gross_lock));
+	down_write(&(yaffs_dev_to_lc(dev)->gross_lock));
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locked %p", current);
 }
 
 static void yaffs_gross_unlock(struct yaffs_dev *dev)
 {
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs unlocking %p", current);
-	mutex_unlock(&(yaffs_dev_to_lc(dev)->gross_lock));
+	up_write(&(yaffs_dev_to_lc(dev)->gross_lock));
+}
+
+/*
+ * Shared locking is only for paths that read device state without
+ * changing it (chunk cache hits, tnode lookups).  Anything that may touch
+ * the flash, allocate or collect garbage must use yaffs_gross_lock().
+ */
+static void yaffs_gross_lock_shared(struct yaffs_dev *dev)
+{
+	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locking shared %p", current);
+	down_read(&(yaffs_dev_to_lc(dev)->gross_lock));
+	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locked shared %p", current);
+}
+
+static void yaffs_gross_unlock_shared(struct yaffs_dev *dev)
+{
+	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs unlocking shared %p", current);
+	up_read(&(yaffs_dev_to_lc(dev)->gross_lock));
 }
 
 static void yaffs_fill_inode_from_obj(struct inode *inode,
@@ -1125,6 +1147,7 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 	struct yaffs_obj *obj;
 	unsigned char *pg_buf;
 	int ret;
+	int n_done;
 
 	struct yaffs_dev *dev;
 
@@ -1142,12 +1165,29 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 	pg_buf = kmap(pg);
 	/* FIXME: Can kmap fail? */
 
-	yaffs_gross_lock(dev);
+	/*
+	 * Serve what we can from the chunk cache with the lock shared, so
+	 * concurrent readers of cached data don't serialise, and take it
+	 * exclusively only for the part that has to come off the flash.
+	 */
+	yaffs_gross_lock_shared(dev);
 
-	ret = yaffs_file_rd(obj, pg_buf,
-			    pg->index << PAGE_CACHE_SHIFT, PAGE_CACHE_SIZE);
+	n_done = yaffs_file_rd_cached(obj, pg_buf,
+				      pg->index << PAGE_CACHE_SHIFT,
+				      PAGE_CACHE_SIZE);
 
-	yaffs_gross_unlock(dev);
+	yaffs_gross_unlock_shared(dev);
+
+	ret = 0;
+	if (n_done < PAGE_CACHE_SIZE) {
+		yaffs_gross_lock(dev);
+
+		ret = yaffs_file_rd(obj, pg_buf + n_done,
+				    (pg->index << PAGE_CACHE_SHIFT) + n_done,
+				    PAGE_CACHE_SIZE - n_done);
+
+		yaffs_gross_unlock(dev);
+	}
 
 	if (ret >= 0)
 		ret = 0;
@@ -1539,7 +1579,12 @@ static void yaffs_flush_super(struct super_block *sb, int do_checkpoint)
 		yaffs_checkpoint_save(dev);
 }
 
-static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev)
+/*
+ * When the device has been idle for a while, also collect while more than
+ * a quarter of the free space is scattered, so that space is ready before
+ * the next burst of writes instead of being reclaimed inline.
+ */
+static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev, int idle)
 {
 	unsigned erased_chunks =
 	    dev->n_erased_blocks * dev->param.chunks_per_block;
@@ -1554,7 +1599,7 @@ static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev)
 	else if (scattered < (dev->param.chunks_per_block * 2))
 		return 0;
 	else if (erased_chunks > dev->n_free_chunks / 2)
-		return 0;
+		return (idle && scattered > dev->n_free_chunks / 4) ? 1 : 0;
 	else if (erased_chunks > dev->n_free_chunks / 4)
 		return 1;
 	else
@@ -1566,7 +1611,7 @@ static int yaffs_do_sync_fs(struct super_block *sb, int request_checkpoint)
 
 	struct yaffs_dev *dev = yaffs_super_to_dev(sb);
 	unsigned int oneshot_checkpoint = (yaffs_auto_checkpoint & 4);
-	unsigned gc_urgent = yaffs_bg_gc_urgency(dev);
+	unsigned gc_urgent = yaffs_bg_gc_urgency(dev, 0);
 	int do_checkpoint;
 
 	yaffs_trace(YAFFS_TRACE_OS | YAFFS_TRACE_SYNC | YAFFS_TRACE_BACKGROUND,
@@ -1616,7 +1661,11 @@ static int yaffs_bg_thread_fn(void *data)
 	unsigned long next_dir_update = now;
 	unsigned long next_gc = now;
 	unsigned long expires;
+	unsigned long last_active = now;
 	unsigned int urgency;
+	u32 writes;
+	u32 last_writes = 0;
+	int idle;
 
 	int gc_result;
 	struct timer_list timer;
@@ -1638,6 +1687,16 @@ static int yaffs_bg_thread_fn(void *data)
 
 		now = jiffies;
 
+		/* Writes other than gc copies mean the device is in use */
+		writes = dev->n_page_writes - dev->n_gc_copies;
+		if (writes != last_writes) {
+			last_writes = writes;
+			last_active = now;
+		}
+		idle = yaffs_bg_idle_ms &&
+		    time_after(now, last_active +
+			       msecs_to_jiffies(yaffs_bg_idle_ms));
+
 		if (time_after(now, next_dir_update) && yaffs_bg_enable) {
 			yaffs_update_dirty_dirs(dev);
 			next_dir_update = now + HZ;
@@ -1645,7 +1704,7 @@ static int yaffs_bg_thread_fn(void *data)
 
 		if (time_after(now, next_gc) && yaffs_bg_enable) {
 			if (!dev->is_checkpointed) {
-				urgency = yaffs_bg_gc_urgency(dev);
+				urgency = yaffs_bg_gc_urgency(dev, idle);
 				gc_result = yaffs_bg_gc(dev, urgency);
 				if (urgency > 1)
 					next_gc = now + HZ / 20 + 1;
@@ -2275,6 +2334,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 
 	param->sb_dirty_fn = yaffs_touch_super;
 	param->gc_control = yaffs_gc_control_callback;
+	param->gc_wear_weight = yaffs_gc_wear_weight;
 
 	yaffs_dev_to_lc(dev)->super = sb;
 
@@ -2308,7 +2368,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	INIT_LIST_HEAD(&(yaffs_dev_to_lc(dev)->search_contexts));
 	param->remove_obj_fn = yaffs_remove_obj_callback;
 
-	mutex_init(&(yaffs_dev_to_lc(dev)->gross_lock));
+	init_rwsem(&(yaffs_dev_to_lc(dev)->gross_lock));
 
 	yaffs_gross_lock(dev);
 
@@ -2484,6 +2544,30 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	return buf;
 }
 
+static char *yaffs_dump_dev_part2(char *buf, struct yaffs_dev *dev)
+{
+	u32 erase_hist[YAFFS_HIST_BUCKETS];
+	int n_blocks = dev->internal_end_block - dev->internal_start_block + 1;
+	int i;
+
+	memset(erase_hist, 0, sizeof(erase_hist));
+	if (dev->block_erase_count)
+		for (i = 0; i < n_blocks; i++)
+			erase_hist[yaffs_hist_bucket(dev->block_erase_count[i])]++;
+
+	buf += sprintf(buf, "gc_wear_weight........ %d\n",
+			dev->param.gc_wear_weight);
+	buf += sprintf(buf, "\n");
+	buf += sprintf(buf, "%-10s %10s %10s %10s\n",
+			"<", "gc_us", "bg_gc_us", "erases");
+	for (i = 0; i < YAFFS_HIST_BUCKETS; i++)
+		buf += sprintf(buf, "%-10u %10u %10u %10u\n", 1U << i,
+				dev->gc_latency_hist[0][i],
+				dev->gc_latency_hist[1][i], erase_hist[i]);
+
+	return buf;
+}
+
 static int yaffs_proc_read(char *page,
 			   char **start,
 			   off_t offset, int count, int *eof, void *data)
@@ -2518,17 +2602,19 @@ static int yaffs_proc_read(char *page,
 				       context_list);
 			struct yaffs_dev *dev = dc->dev;
 
-			if (n < (step & ~1)) {
-				n += 2;
+			if (n < step - (step % 3)) {
+				n += 3;
 				continue;
 			}
-			if ((step & 1) == 0) {
+			if ((step % 3) == 0) {
 				buf +=
-				    sprintf(buf, "\nDevice %d \"%s\"\n", n,
+				    sprintf(buf, "\nDevice %d \"%s\"\n", n / 3,
 					    dev->param.name);
 				buf = yaffs_dump_dev_part0(buf, dev);
-			} else {
+			} else if ((step % 3) == 1) {
 				buf = yaffs_dump_dev_part1(buf, dev);
+			} else {
+				buf = yaffs_dump_dev_part2(buf, dev);
                         }
 
 			break;
@@ -163,6 +163,20 @@ static inline void cpu_hotplug_driver_unlock(void)
 #define unregister_hotcpu_notifier(nb)	({ (void)(nb); })
 #endif		/* CONFIG_HOTPLUG_CPU */
 
+/*
+ * While the hotplug manager (drivers/cpufreq/cpu-hotplug.c) is enabled
+ * it alone decides which cpus are online, governors with hotplug logic
+ * of their own only scale the frequency.
+ */
+#ifdef CONFIG_CPU_HOTPLUG_MGR
+extern bool cpu_hotplug_mgr_enabled(void);
+#else
+static inline bool cpu_hotplug_mgr_enabled(void)
+{
+	return false;
+}
+#endif
+
 #ifdef CONFIG_PM_SLEEP_SMP
 extern int suspend_cpu_hotplug;
 
@@ -103,6 +103,10 @@ struct cpufreq_policy {
 
 	struct cpufreq_real_policy	user_policy;
 
+	unsigned int		load;	/* in percent, the load the governor
+					 * based its last request on; only
+					 * used for statistics */
+
 	struct kobject		kobj;
 	struct completion	kobj_unregister;
 };
@@ -196,6 +200,57 @@ extern int __cpufreq_driver_getavg(struct cpufreq_policy *policy,
 int cpufreq_register_governor(struct cpufreq_governor *governor);
 void cpufreq_unregister_governor(struct cpufreq_governor *governor);
 
+/*
+ * Scheduler input for the 'sched' governor, called with the runqueue
+ * lock of @cpu held.  @util is the fair utilization in SCHED_LOAD_SCALE
+ * units; @running says whether rt tasks are keeping @cpu busy.
+ */
+#ifdef CONFIG_CPU_FREQ_GOV_SCHED
+extern void cpufreq_sched_update_util(int cpu, unsigned long util);
+extern void cpufreq_sched_update_rt(int cpu, bool running);
+#else
+static inline void cpufreq_sched_update_util(int cpu, unsigned long util)
+{
+}
+static inline void cpufreq_sched_update_rt(int cpu, bool running)
+{
+}
+#endif
+
+/*
+ * Boost service.  Latency sensitive events kick a client; while any
+ * client is boosted the policy minimum is raised to the highest boost
+ * frequency among the boosted clients, which every governor honours.
+ * Governors that want to react to the event itself can register a
+ * notifier, it is called with the client in atomic context.
+ */
+enum cpu_boost_client {
+	CPU_BOOST_INPUT,
+	CPU_BOOST_BINDER,
+	CPU_BOOST_FORK,
+	CPU_BOOST_EXEC,
+	CPU_BOOST_USER,
+	CPU_BOOST_CLIENTS,
+};
+
+#ifdef CONFIG_CPU_FREQ
+extern void cpu_boost_kick(enum cpu_boost_client client);
+extern int cpu_boost_register_notifier(struct notifier_block *nb);
+extern int cpu_boost_unregister_notifier(struct notifier_block *nb);
+#else
+static inline void cpu_boost_kick(enum cpu_boost_client client)
+{
+}
+static inline int cpu_boost_register_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int cpu_boost_unregister_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+#endif
+
 /*********************************************************************
  *                      CPUFREQ DRIVER INTERFACE                     *
  *********************************************************************/
@@ -364,6 +419,9 @@ extern struct cpufreq_governor cpufreq_gov_pegasusq;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_HOTPLUG)
 extern struct cpufreq_governor cpufreq_gov_hotplug;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_hotplug)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED)
+extern struct cpufreq_governor cpufreq_gov_sched;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_sched)
 #endif
 
 /*********************************************************************
@@ -39,6 +39,10 @@ struct cpuidle_state {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	/* woke before target_residency */
+	unsigned long long	too_deep;
+	/* a deeper allowed state would have broken even */
+	unsigned long long	too_shallow;
 
 	int (*enter)	(struct cpuidle_device *dev,
 			 struct cpuidle_state *state);
@@ -181,6 +185,12 @@ static inline void cpuidle_unregister_governor(struct cpuidle_governor *gov) { }
 
 #endif
 
+#ifdef CONFIG_CPU_IDLE_GOV_PREDICT
+extern void cpuidle_predict_irq(unsigned int irq);
+#else
+static inline void cpuidle_predict_irq(unsigned int irq) { }
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
@@ -173,6 +173,39 @@ struct sdio_func_tuple;
 
 #define SDIO_MAX_FUNCS		7
 
+/*
+ * Why mmc_blk_prep_packed_list() stopped adding requests to a packed group.
+ */
+enum mmc_packed_stop_reasons {
+	EXCEEDS_SEGMENTS = 0,	/* host max_segs reached */
+	EXCEEDS_SECTORS,	/* host max_blk_count reached */
+	WRONG_DATA_DIR,		/* next request goes the other way */
+	FLUSH_OR_DISCARD,	/* next request is a flush or discard */
+	EMPTY_QUEUE,		/* nothing more to pack */
+	REL_WRITE,		/* reliable write not allowed in a pack */
+	NOPACKED_PERIOD,	/* RT request disabled packing */
+	NON_SEQUENTIAL,		/* next request not contiguous */
+	MAX_PACKED_REACHED,	/* card's max_packed_{reads,writes} */
+	MAX_REASONS,
+};
+
+/* Packed groups larger than this are accounted in the last bucket */
+#define MMC_PACKED_STATS_MAX_NUM	64
+
+struct mmc_packed_stats {
+	spinlock_t	lock;
+	bool		enabled;
+	/* Number of packed groups issued, indexed by data direction and size */
+	u32		packing_events[2][MMC_PACKED_STATS_MAX_NUM + 1];
+	u32		pack_stop_reason[MAX_REASONS];
+	u32		packed_reqs[2];		/* requests sent inside a pack */
+	u32		single_reqs[2];		/* requests sent unpacked */
+	u32		packed_fail_retries;	/* retries from packed_fail_idx */
+	u32		packed_aborts;		/* packed groups failed with -EIO */
+	u32		wr_packing_disabled;	/* reads turned write packing off */
+	u32		wr_packing_enabled;	/* write streaks turned it on */
+};
+
 /*
  * MMC device
  */
@@ -240,6 +273,8 @@ struct mmc_card {
 	unsigned int		sd_bus_speed;	/* Bus Speed Mode set for the card */
 
 	struct dentry		*debugfs_root;
+
+	struct mmc_packed_stats	pack_stats;	/* packed command statistics */
 };
 
 /*
@@ -141,6 +141,9 @@ extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
+#ifdef CONFIG_SCHED_NR_RUNNING_AVG
+extern u64 sched_nr_running_sum(int cpu);
+#endif
 
 extern void calc_global_load(unsigned long ticks);
 
@@ -737,6 +740,13 @@ struct sched_info {
 	/* timestamps */
 	unsigned long long last_arrival,/* when we last ran on a cpu */
 			   last_queued;	/* when we were last queued to run */
+
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* wait accumulated on other cpus before migrating here */
+	unsigned long long hist_delay;
+	/* queued by a wakeup rather than a preemption */
+	unsigned int hist_wakeup;
+#endif
 };
 #endif /* defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT) */
 
@@ -1096,6 +1106,7 @@ struct sched_class {
 	void (*post_schedule) (struct rq *this_rq);
 	void (*task_waking) (struct task_struct *task);
 	void (*task_woken) (struct rq *this_rq, struct task_struct *task);
+	void (*migrate_task_rq) (struct task_struct *p, int next_cpu);
 
 	void (*set_cpus_allowed)(struct task_struct *p,
 				 const struct cpumask *newmask);
@@ -1125,6 +1136,19 @@ struct load_weight {
 	unsigned long weight, inv_weight;
 };
 
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+/*
+ * Decaying average of the time an entity has been runnable, in
+ * SCHED_LOAD_SCALE units: SCHED_LOAD_SCALE means always runnable.
+ */
+struct sched_avg {
+	u64			last_update;
+	u32			runnable_sum, period_sum;
+	unsigned long		util;
+	unsigned int		migrated;
+};
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 struct sched_statistics {
 	u64			wait_start;
@@ -1174,10 +1198,18 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+	/* wakeup urgency, does not affect the share of cpu time */
+	int			latency_nice;
+	long			latency_offset;	/* in vruntime ns */
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
 
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	struct sched_avg	avg;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct sched_entity	*parent;
 	/* rq on which this entity is (to be) queued: */
@@ -1594,6 +1626,14 @@ struct task_struct {
 #define MAX_PRIO		(MAX_RT_PRIO + 40)
 #define DEFAULT_PRIO		(MAX_RT_PRIO + 20)
 
+/*
+ * Latency nice values, like nice values, go from -20 (most latency
+ * sensitive) to 19.
+ */
+#define MIN_LATENCY_NICE	-20
+#define MAX_LATENCY_NICE	19
+#define LATENCY_NICE_WIDTH	20
+
 static inline int rt_prio(int prio)
 {
 	if (unlikely(prio < MAX_RT_PRIO))
@@ -1963,6 +2003,10 @@ extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
 extern unsigned int sysctl_sched_child_runs_first;
+#ifdef CONFIG_SCHED_PACK_SMALL_TASKS
+extern unsigned int sysctl_sched_pack_util;
+extern unsigned int sysctl_sched_pack_small_task;
+#endif
 
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
@@ -2036,6 +2080,7 @@ extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
 extern int task_nice(const struct task_struct *p);
 extern int can_nice(const struct task_struct *p, const int nice);
+extern int sched_set_latency_nice(struct task_struct *p, int latency_nice);
 extern int task_curr(const struct task_struct *p);
 extern int idle_cpu(int cpu);
 extern int sched_setscheduler(struct task_struct *, int,
@@ -2613,6 +2658,8 @@ extern void sched_move_task(struct task_struct *tsk);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
+extern int sched_group_set_latency_nice(struct task_group *tg,
+					int latency_nice);
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
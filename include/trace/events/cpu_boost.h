@@ -0,0 +1,53 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpu_boost
+
+#if !defined(_TRACE_CPU_BOOST_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPU_BOOST_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(cpu_boost,
+	    TP_PROTO(const char *client, unsigned int freq, unsigned int ms),
+	    TP_ARGS(client, freq, ms),
+	    TP_STRUCT__entry(
+		    __string(client, client)
+		    __field(unsigned int, freq)
+		    __field(unsigned int, ms)
+	    ),
+	    TP_fast_assign(
+		    __assign_str(client, client);
+		    __entry->freq = freq;
+		    __entry->ms = ms;
+	    ),
+	    TP_printk("client=%s freq=%u ms=%u", __get_str(client),
+		      __entry->freq, __entry->ms)
+);
+
+TRACE_EVENT(cpu_unboost,
+	    TP_PROTO(const char *client),
+	    TP_ARGS(client),
+	    TP_STRUCT__entry(
+		    __string(client, client)
+	    ),
+	    TP_fast_assign(
+		    __assign_str(client, client);
+	    ),
+	    TP_printk("client=%s", __get_str(client))
+);
+
+TRACE_EVENT(cpu_boost_floor,
+	    TP_PROTO(unsigned int freq),
+	    TP_ARGS(freq),
+	    TP_STRUCT__entry(
+		    __field(unsigned int, freq)
+	    ),
+	    TP_fast_assign(
+		    __entry->freq = freq;
+	    ),
+	    TP_printk("freq=%u", __entry->freq)
+);
+
+#endif /* _TRACE_CPU_BOOST_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
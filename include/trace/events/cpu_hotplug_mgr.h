@@ -0,0 +1,52 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpu_hotplug_mgr
+
+#if !defined(_TRACE_CPU_HOTPLUG_MGR_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPU_HOTPLUG_MGR_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(cpu_hotplug_mgr_decision,
+	    TP_PROTO(unsigned int online, unsigned int nr_avg,
+		     unsigned int max_load, unsigned int min_load,
+		     int change, const char *reason),
+	    TP_ARGS(online, nr_avg, max_load, min_load, change, reason),
+	    TP_STRUCT__entry(
+		    __field(unsigned int, online)
+		    __field(unsigned int, nr_avg)
+		    __field(unsigned int, max_load)
+		    __field(unsigned int, min_load)
+		    __field(int, change)
+		    __string(reason, reason)
+	    ),
+	    TP_fast_assign(
+		    __entry->online = online;
+		    __entry->nr_avg = nr_avg;
+		    __entry->max_load = max_load;
+		    __entry->min_load = min_load;
+		    __entry->change = change;
+		    __assign_str(reason, reason);
+	    ),
+	    TP_printk("online=%u nr_avg=%u max_load=%u min_load=%u change=%d reason=%s",
+		      __entry->online, __entry->nr_avg, __entry->max_load,
+		      __entry->min_load, __entry->change, __get_str(reason))
+);
+
+TRACE_EVENT(cpu_hotplug_mgr_up_latency,
+	    TP_PROTO(unsigned int cpu, unsigned int us),
+	    TP_ARGS(cpu, us),
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu)
+		    __field(unsigned int, us)
+	    ),
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->us = us;
+	    ),
+	    TP_printk("cpu=%u us=%u", __entry->cpu, __entry->us)
+);
+
+#endif /* _TRACE_CPU_HOTPLUG_MGR_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,49 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq
+
+#if !defined(_TRACE_CPUFREQ_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_H
+
+#include <linux/cpufreq.h>
+#include <linux/tracepoint.h>
+
+/*
+ * One call into the driver's target() hook: the governor's request, the
+ * load it was based on, the frequency the policy ended up at and how
+ * long the driver took.
+ */
+TRACE_EVENT(cpufreq_target,
+	    TP_PROTO(struct cpufreq_policy *policy, unsigned int target_freq,
+		     unsigned int relation, unsigned int old_freq, int ret,
+		     u64 latency_ns),
+	    TP_ARGS(policy, target_freq, relation, old_freq, ret, latency_ns),
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu)
+		    __field(unsigned int, load)
+		    __field(unsigned int, old)
+		    __field(unsigned int, requested)
+		    __field(unsigned int, relation)
+		    __field(unsigned int, granted)
+		    __field(int, ret)
+		    __field(u64, latency_ns)
+	    ),
+	    TP_fast_assign(
+		    __entry->cpu = policy->cpu;
+		    __entry->load = policy->load;
+		    __entry->old = old_freq;
+		    __entry->requested = target_freq;
+		    __entry->relation = relation;
+		    __entry->granted = policy->cur;
+		    __entry->ret = ret;
+		    __entry->latency_ns = latency_ns;
+	    ),
+	    TP_printk("cpu=%u load=%u old=%u requested=%u relation=%u granted=%u ret=%d latency=%llu ns",
+		      __entry->cpu, __entry->load, __entry->old,
+		      __entry->requested, __entry->relation, __entry->granted,
+		      __entry->ret, (unsigned long long)__entry->latency_ns)
+);
+
+#endif /* _TRACE_CPUFREQ_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
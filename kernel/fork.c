@@ -31,6 +31,7 @@
 #include <linux/nsproxy.h>
 #include <linux/capability.h>
 #include <linux/cpu.h>
+#include <linux/cpufreq.h>
 #include <linux/cgroup.h>
 #include <linux/security.h>
 #include <linux/hugetlb.h>
@@ -1544,6 +1545,11 @@ long do_fork(unsigned long clone_flags,
 
 		wake_up_new_task(p);
 
+		/* a new process, most likely about to exec an app */
+		if (!(clone_flags & CLONE_THREAD) &&
+		    !(current->flags & PF_KTHREAD))
+			cpu_boost_kick(CPU_BOOST_FORK);
+
 		tracehook_report_clone_complete(trace, regs,
 						clone_flags, nr, p);
 
@@ -11,6 +11,7 @@
  */
 
 #include <linux/irq.h>
+#include <linux/cpuidle.h>
 #include <linux/random.h>
 #include <linux/sched.h>
 #include <linux/interrupt.h>
@@ -121,6 +122,8 @@ handle_irq_event_percpu(struct irq_desc *desc, struct irqaction *action)
 	irqreturn_t retval = IRQ_NONE;
 	unsigned int flags = 0, irq = desc->irq_data.irq;
 
+	cpuidle_predict_irq(irq);
+
 	do {
 		irqreturn_t res;
 
@@ -72,6 +72,7 @@
 #include <linux/ftrace.h>
 #include <linux/slab.h>
 #include <linux/cpuacct.h>
+#include <linux/cpufreq.h>
 
 #include <asm/tlb.h>
 #include <asm/irq_regs.h>
@@ -241,6 +242,19 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
  */
 static DEFINE_MUTEX(sched_domains_mutex);
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Bucket 0 counts delays under 1024ns, bucket n delays from 2^(n+9)ns
+ * up to 2^(n+10)ns, the last one everything longer.
+ */
+#define SCHED_HIST_BUCKETS	20
+
+struct sched_latency_hist {
+	unsigned int wakeup[SCHED_HIST_BUCKETS];	/* woken up to running */
+	unsigned int runq[SCHED_HIST_BUCKETS];		/* any queued to running */
+};
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 
 #include <linux/cgroup.h>
@@ -253,6 +267,10 @@ static LIST_HEAD(task_groups);
 struct task_group {
 	struct cgroup_subsys_state css;
 	bool notify_on_migrate;
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* per cpu, includes the tasks of child groups; NULL for the root */
+	struct sched_latency_hist __percpu *lat_hist;
+#endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* schedulable entities of this group on each cpu */
@@ -261,6 +279,7 @@ struct task_group {
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
 	atomic_t load_weight;
+	int latency_nice;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -378,6 +397,15 @@ struct cfs_rq {
 	unsigned long load_contribution;
 #endif
 #endif
+
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	/*
+	 * Only used on the root cfs_rq: utilization of the cpu, and
+	 * utilization of tasks that migrated away since the last update.
+	 */
+	struct sched_avg avg;
+	atomic_long_t removed_util;
+#endif
 };
 
 /* Real-Time classes' related field in a runqueue: */
@@ -504,6 +532,12 @@ struct rq {
 
 	atomic_t nr_iowait;
 
+#ifdef CONFIG_SCHED_NR_RUNNING_AVG
+	/* integral of nr_running over rq->clock, see sched_nr_running_sum() */
+	u64 nr_running_sum;
+	u64 nr_running_stamp;
+#endif
+
 #ifdef CONFIG_SMP
 	struct root_domain *rd;
 	struct sched_domain *sd;
@@ -561,6 +595,16 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+#ifdef CONFIG_SCHED_PACK_SMALL_TASKS
+	/* small task packing stats */
+	unsigned int pack_wakeups;
+	unsigned int pack_lb_skipped;
+#endif
+#endif
+
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	struct sched_latency_hist lat_hist;
 #endif
 
 #ifdef CONFIG_SMP
@@ -1784,13 +1828,49 @@ static const struct sched_class rt_sched_class;
 
 #include "sched_stats.h"
 
+#ifdef CONFIG_SCHED_NR_RUNNING_AVG
+static void update_nr_running_sum(struct rq *rq)
+{
+	u64 delta = rq->clock - rq->nr_running_stamp;
+
+	rq->nr_running_sum += delta * rq->nr_running;
+	rq->nr_running_stamp = rq->clock;
+}
+
+/*
+ * Time integral of the number of runnable tasks on @cpu, in task * ns.
+ * Callers sample it periodically; the difference between two samples
+ * divided by the time between them is the average run queue depth.
+ */
+u64 sched_nr_running_sum(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	u64 sum;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_nr_running_sum(rq);
+	sum = rq->nr_running_sum;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return sum;
+}
+#else
+static inline void update_nr_running_sum(struct rq *rq)
+{
+}
+#endif
+
 static void inc_nr_running(struct rq *rq)
 {
+	update_nr_running_sum(rq);
 	rq->nr_running++;
 }
 
 static void dec_nr_running(struct rq *rq)
 {
+	update_nr_running_sum(rq);
 	rq->nr_running--;
 }
 
@@ -1816,6 +1896,8 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(p);
+	if (flags & ENQUEUE_WAKEUP)
+		sched_info_woken(p);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
 
@@ -2224,6 +2306,8 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	trace_sched_migrate_task(p, new_cpu);
 
 	if (task_cpu(p) != new_cpu) {
+		if (p->sched_class->migrate_task_rq)
+			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, 1, NULL, 0);
 	}
@@ -2855,6 +2939,10 @@ static void __sched_fork(struct task_struct *p)
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
 
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
+
 	INIT_LIST_HEAD(&p->rt.run_list);
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -2893,6 +2981,11 @@ void sched_fork(struct task_struct *p)
 			set_load_weight(p);
 		}
 
+		if (p->se.latency_nice < 0) {
+			p->se.latency_nice = 0;
+			p->se.latency_offset = 0;
+		}
+
 		/*
 		 * We don't need the reset flag anymore after the fork. It has
 		 * fulfilled its duty:
@@ -5094,6 +5187,58 @@ static bool check_same_owner(struct task_struct *p)
 	return match;
 }
 
+/*
+ * Latency nice tells CFS how early an entity wants to run once it is
+ * runnable, without changing the share of cpu it gets: a negative value
+ * lets it preempt the current task, and be picked as next buddy over
+ * the leftmost entity, while its vruntime is ahead of theirs by up to
+ * latency_offset.  Positive values do the opposite.  -20 is worth one
+ * full sched_latency period.
+ */
+static long latency_offset_of(int latency_nice)
+{
+	return -(long)latency_nice *
+		(long)(sysctl_sched_latency / LATENCY_NICE_WIDTH);
+}
+
+static void set_se_latency_nice(struct sched_entity *se, int latency_nice)
+{
+	se->latency_nice = latency_nice;
+	se->latency_offset = latency_offset_of(latency_nice);
+}
+
+/**
+ * sched_set_latency_nice - set the wakeup latency hint of a task
+ * @p: the task
+ * @latency_nice: -20 (most latency sensitive) to 19
+ *
+ * Lowering the value needs CAP_SYS_NICE, as does changing the value of
+ * a task owned by someone else.
+ */
+int sched_set_latency_nice(struct task_struct *p, int latency_nice)
+{
+	unsigned long flags;
+	struct rq *rq;
+	int retval;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	if (!capable(CAP_SYS_NICE) &&
+	    (latency_nice < p->se.latency_nice || !check_same_owner(p)))
+		return -EPERM;
+
+	retval = security_task_setscheduler(p);
+	if (retval)
+		return retval;
+
+	rq = task_rq_lock(p, &flags);
+	set_se_latency_nice(&p->se, latency_nice);
+	task_rq_unlock(rq, p, &flags);
+
+	return 0;
+}
+
 static int __sched_setscheduler(struct task_struct *p, int policy,
 				const struct sched_param *param, bool user)
 {
@@ -8572,6 +8717,9 @@ static void free_sched_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	free_percpu(tg->lat_hist);
+#endif
 	kfree(tg);
 }
 
@@ -8591,6 +8739,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	tg->lat_hist = alloc_percpu(struct sched_latency_hist);
+	if (!tg->lat_hist)
+		goto err;
+#endif
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	list_add_rcu(&tg->list, &task_groups);
 
@@ -8720,6 +8874,32 @@ unsigned long sched_group_shares(struct task_group *tg)
 {
 	return tg->shares;
 }
+
+/* sets the hint of the group's entities in their parent runqueues */
+int sched_group_set_latency_nice(struct task_group *tg, int latency_nice)
+{
+	unsigned long flags;
+	int i;
+
+	if (!tg->se[0])
+		return -EINVAL;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	mutex_lock(&shares_mutex);
+	tg->latency_nice = latency_nice;
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		set_se_latency_nice(tg->se[i], latency_nice);
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+	mutex_unlock(&shares_mutex);
+
+	return 0;
+}
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9106,6 +9286,20 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) scale_load_down(tg->shares);
 }
+
+static int cpu_latency_nice_write_s64(struct cgroup *cgrp,
+				      struct cftype *cft, s64 val)
+{
+	if (val < MIN_LATENCY_NICE || val > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	return sched_group_set_latency_nice(cgroup_tg(cgrp), val);
+}
+
+static s64 cpu_latency_nice_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_nice;
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9132,18 +9326,57 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static int cpu_latency_hist_read(struct cgroup *cgrp, struct cftype *cft,
+				 struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct sched_latency_hist sum, *h;
+	int cpu, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		/* the root group is everything */
+		if (tg->lat_hist)
+			h = per_cpu_ptr(tg->lat_hist, cpu);
+		else
+			h = &cpu_rq(cpu)->lat_hist;
+
+		for (i = 0; i < SCHED_HIST_BUCKETS; i++) {
+			sum.wakeup[i] += h->wakeup[i];
+			sum.runq[i] += h->runq[i];
+		}
+	}
+
+	sched_hist_show_buckets(m);
+	sched_hist_show(m, "", &sum);
+	return 0;
+}
+#endif
+
 static struct cftype cpu_files[] = {
 	{
 		.name = "notify_on_migrate",
 		.read_u64 = cpu_notify_on_migrate_read_u64,
 		.write_u64 = cpu_notify_on_migrate_write_u64,
 	},
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	{
+		.name = "latency_hist",
+		.read_seq_string = cpu_latency_hist_read,
+	},
+#endif
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
 		.name = "shares",
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_nice",
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -202,6 +202,11 @@ void print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq)
 			cfs_rq->nr_spread_over);
 	SEQ_printf(m, "  .%-30s: %ld\n", "nr_running", cfs_rq->nr_running);
 	SEQ_printf(m, "  .%-30s: %ld\n", "load", cfs_rq->load.weight);
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	if (cfs_rq == &cpu_rq(cpu)->cfs)
+		SEQ_printf(m, "  .%-30s: %lu\n", "util_avg",
+				cfs_rq->avg.util);
+#endif
 #ifdef CONFIG_FAIR_GROUP_SCHED
 #ifdef CONFIG_SMP
 	SEQ_printf(m, "  .%-30s: %Ld.%06ld\n", "load_avg",
@@ -295,6 +300,10 @@ static void print_cpu(struct seq_file *m, int cpu)
 
 	P(ttwu_count);
 	P(ttwu_local);
+#ifdef CONFIG_SCHED_PACK_SMALL_TASKS
+	P(pack_wakeups);
+	P(pack_lb_skipped);
+#endif
 
 #undef P
 #undef P64
@@ -482,6 +491,10 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 		   "nr_involuntary_switches", (long long)p->nivcsw);
 
 	P(se.load.weight);
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	P(se.avg.util);
+#endif
+	P(se.latency_nice);
 	P(policy);
 	P(prio);
 #undef PN
@@ -861,6 +861,219 @@ static inline void update_entity_shares_tick(struct cfs_rq *cfs_rq)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+/*
+ * Per-entity utilization tracking.
+ *
+ * Runnable time is accumulated in ~1ms periods (1024us) and the sums
+ * decay by y every period, with y^32 = 1/2, so a signal follows the
+ * last few hundred milliseconds weighted towards the most recent.
+ * Tasks track the time they were queued, the root cfs_rq tracks the
+ * time the cpu had fair tasks to run.  The cpu signal is kept in step
+ * with migrations by moving a task's utilization along with it, and
+ * is handed to the cpufreq governor at enqueue, dequeue and tick.
+ */
+#define UTIL_AVG_PERIOD		32
+#define UTIL_AVG_MAX		47742	/* maximum possible period_sum */
+#define UTIL_AVG_MAX_N		345	/* periods needed to reach it */
+
+/* y^n, scaled by 2^32, for n < UTIL_AVG_PERIOD */
+static const u32 util_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+	0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+	0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+	0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+	0x9837f050, 0x94f4efa8, 0x91c3d373, 0x8ea4398a, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/* sum of 1024 * y^k for 1 <= k <= n, for n <= UTIL_AVG_PERIOD */
+static const u32 util_avg_yN_sum[] = {
+	    0, 1002, 1982, 2941, 3880, 4798, 5697, 6576, 7437, 8279, 9103,
+	 9909,10698,11470,12226,12966,13690,14398,15091,15769,16433,17082,
+	17718,18340,18949,19545,20128,20698,21256,21802,22336,22859,23371,
+};
+
+static u64 util_decay(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > UTIL_AVG_PERIOD * 63))
+		return 0;
+
+	local_n = n;
+	if (unlikely(local_n >= UTIL_AVG_PERIOD)) {
+		val >>= local_n / UTIL_AVG_PERIOD;
+		local_n %= UTIL_AVG_PERIOD;
+	}
+
+	val *= util_avg_yN_inv[local_n];
+	return val >> 32;
+}
+
+/* contribution of n full periods of runnable time */
+static u32 util_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= UTIL_AVG_PERIOD))
+		return util_avg_yN_sum[n];
+	else if (unlikely(n >= UTIL_AVG_MAX_N))
+		return UTIL_AVG_MAX;
+
+	do {
+		contrib /= 2;
+		contrib += util_avg_yN_sum[UTIL_AVG_PERIOD];
+		n -= UTIL_AVG_PERIOD;
+	} while (n > UTIL_AVG_PERIOD);
+
+	contrib = util_decay(contrib, n);
+	return contrib + util_avg_yN_sum[n];
+}
+
+static void __update_util_avg(u64 now, struct sched_avg *sa, int runnable)
+{
+	u64 delta, periods;
+	u32 delta_w;
+
+	delta = now - sa->last_update;
+	if ((s64)delta < 0) {
+		sa->last_update = now;
+		return;
+	}
+
+	/* account in ~1us units, sub-microsecond deltas wait */
+	delta >>= 10;
+	if (!delta)
+		return;
+	sa->last_update = now;
+
+	delta_w = sa->period_sum % 1024;
+	if (delta + delta_w >= 1024) {
+		/* complete the current period, then decay */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_sum += delta_w;
+		sa->period_sum += delta_w;
+		delta -= delta_w;
+
+		periods = delta >> 10;
+		delta &= 1023;
+
+		sa->runnable_sum = util_decay(sa->runnable_sum, periods + 1);
+		sa->period_sum = util_decay(sa->period_sum, periods + 1);
+
+		delta_w = util_contrib(periods);
+		if (runnable)
+			sa->runnable_sum += delta_w;
+		sa->period_sum += delta_w;
+	}
+
+	if (runnable)
+		sa->runnable_sum += delta;
+	sa->period_sum += delta;
+
+	sa->util = (sa->runnable_sum << SCHED_LOAD_SHIFT) /
+			(sa->period_sum + 1);
+}
+
+/* add or remove @util worth of runnable time from @sa */
+static void util_avg_adjust(struct sched_avg *sa, long util)
+{
+	s64 runnable = sa->runnable_sum;
+
+	runnable += ((s64)util * sa->period_sum) >> SCHED_LOAD_SHIFT;
+	sa->runnable_sum = clamp_t(s64, runnable, 0, sa->period_sum);
+	sa->util = (sa->runnable_sum << SCHED_LOAD_SHIFT) /
+			(sa->period_sum + 1);
+}
+
+static void update_cpu_util(struct rq *rq, int runnable)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	long removed;
+
+	if (atomic_long_read(&cfs_rq->removed_util)) {
+		removed = atomic_long_xchg(&cfs_rq->removed_util, 0);
+		util_avg_adjust(&cfs_rq->avg, -removed);
+	}
+
+	__update_util_avg(rq->clock_task, &cfs_rq->avg, runnable);
+}
+
+static void enqueue_task_util(struct rq *rq, struct task_struct *p)
+{
+	struct sched_avg *sa = &p->se.avg;
+
+	update_cpu_util(rq, rq->cfs.nr_running > 0);
+
+	/*
+	 * A migrated task was brought up to date against its old cpu's
+	 * clock, which this cpu's clock_task knows nothing about; restart
+	 * from here and take its utilization along to this cpu.
+	 */
+	if (sa->migrated) {
+		sa->migrated = 0;
+		sa->last_update = rq->clock_task;
+		util_avg_adjust(&rq->cfs.avg, sa->util);
+	} else {
+		__update_util_avg(rq->clock_task, sa, 0);
+	}
+
+	cpufreq_sched_update_util(cpu_of(rq), rq->cfs.avg.util);
+}
+
+static void dequeue_task_util(struct rq *rq, struct task_struct *p)
+{
+	update_cpu_util(rq, 1);
+	__update_util_avg(rq->clock_task, &p->se.avg, 1);
+
+	cpufreq_sched_update_util(cpu_of(rq), rq->cfs.avg.util);
+}
+
+static void tick_task_util(struct rq *rq, struct task_struct *curr)
+{
+	update_cpu_util(rq, 1);
+	__update_util_avg(rq->clock_task, &curr->se.avg, 1);
+
+	cpufreq_sched_update_util(cpu_of(rq), rq->cfs.avg.util);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Called from set_task_cpu() with either p->pi_lock or the old rq lock
+ * held, but not necessarily the latter: leave the old cpu's share to be
+ * subtracted at its next update.
+ */
+static void migrate_task_rq_fair(struct task_struct *p, int next_cpu)
+{
+	struct sched_avg *sa = &p->se.avg;
+	struct rq *rq = task_rq(p);
+
+	if (!p->se.on_rq)
+		__update_util_avg(rq->clock_task, sa, 0);
+
+	if (sa->util)
+		atomic_long_add(sa->util, &rq->cfs.removed_util);
+	sa->migrated = 1;
+}
+#endif
+#else /* CONFIG_SCHED_UTIL_TRACKING */
+static inline void enqueue_task_util(struct rq *rq, struct task_struct *p)
+{
+}
+
+static inline void dequeue_task_util(struct rq *rq, struct task_struct *p)
+{
+}
+
+static inline void tick_task_util(struct rq *rq, struct task_struct *curr)
+{
+}
+#endif /* CONFIG_SCHED_UTIL_TRACKING */
+
 static void enqueue_sleeper(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 #ifdef CONFIG_SCHEDSTATS
@@ -1326,6 +1539,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	enqueue_task_util(rq, p);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -1357,6 +1572,8 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct sched_entity *se = &p->se;
 	int task_sleep = flags & DEQUEUE_SLEEP;
 
+	dequeue_task_util(rq, p);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -1622,6 +1839,106 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+#ifdef CONFIG_SCHED_PACK_SMALL_TASKS
+/*
+ * Small task packing.
+ *
+ * While the fair tasks of all active cpus together keep less than
+ * sysctl_sched_pack_util percent of a single cpu busy, waking tasks
+ * that are themselves below sysctl_sched_pack_small_task percent go to
+ * the first active cpu, and the other cpus neither pull work when they
+ * are idle nor get kicked to balance on behalf of the busy one.  That
+ * leaves them idle long enough for cluster wide low power states, which
+ * on OMAP4 need every cpu but the first to be idle.  As soon as the
+ * total goes over the threshold the regular balancing spreads tasks
+ * again, and so does rt work or a queue building up on the first cpu.
+ * Setting sched_pack_util to 0 turns packing off.
+ */
+unsigned int sysctl_sched_pack_util = 50;
+unsigned int sysctl_sched_pack_small_task = 20;
+
+static int pack_fits(const struct cpumask *span, unsigned long extra)
+{
+	unsigned long util = extra;
+	int i;
+
+	if (!sysctl_sched_pack_util)
+		return 0;
+
+	for_each_cpu_and(i, span, cpu_active_mask)
+		util += cpu_rq(i)->cfs.avg.util;
+
+	return util * 100 <= sysctl_sched_pack_util * SCHED_LOAD_SCALE;
+}
+
+/*
+ * Fair utilization doesn't see rt tasks or irq time, so a pack cpu that
+ * runs them, has lost capacity to them (cpu_power, see scale_rt_power())
+ * or already has tasks waiting can't take more work on its own.
+ */
+static int pack_cpu_busy(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	return rq->rt.rt_nr_running || rq->nr_running > 1 ||
+		rq->cpu_power * 10 < SCHED_POWER_SCALE * 9;
+}
+
+/* the cpu @p should wake on to keep the others idle, or -1 */
+static int pack_wake_cpu(struct task_struct *p, int prev_cpu)
+{
+	int pack_cpu = cpumask_first(cpu_active_mask);
+	unsigned long util = p->se.avg.util;
+
+	if (util * 100 > sysctl_sched_pack_small_task * SCHED_LOAD_SCALE)
+		return -1;
+	if (!cpumask_test_cpu(pack_cpu, tsk_cpus_allowed(p)))
+		return -1;
+	if (pack_cpu_busy(pack_cpu))
+		return -1;
+	if (!pack_fits(cpu_active_mask, util))
+		return -1;
+
+	if (prev_cpu != pack_cpu)
+		schedstat_inc(this_rq(), pack_wakeups);
+	return pack_cpu;
+}
+
+/* whether an idle @cpu should leave the tasks of @sd where they are */
+static int pack_keep_idle(int cpu, struct sched_domain *sd)
+{
+	struct cpumask *span = sched_domain_span(sd);
+	int pack_cpu = cpumask_first_and(span, cpu_active_mask);
+
+	return cpu != pack_cpu && pack_cpu < nr_cpu_ids &&
+		!pack_cpu_busy(pack_cpu) && pack_fits(span, 0);
+}
+
+/* whether the idle cpus are being kept idle on purpose */
+static int pack_no_kick(void)
+{
+	int pack_cpu = cpumask_first(cpu_active_mask);
+
+	return pack_cpu < nr_cpu_ids && !pack_cpu_busy(pack_cpu) &&
+		pack_fits(cpu_active_mask, 0);
+}
+#else
+static inline int pack_wake_cpu(struct task_struct *p, int prev_cpu)
+{
+	return -1;
+}
+
+static inline int pack_keep_idle(int cpu, struct sched_domain *sd)
+{
+	return 0;
+}
+
+static inline int pack_no_kick(void)
+{
+	return 0;
+}
+#endif /* CONFIG_SCHED_PACK_SMALL_TASKS */
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
@@ -1697,6 +2014,10 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	int sync = wake_flags & WF_SYNC;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
+		new_cpu = pack_wake_cpu(p, prev_cpu);
+		if (new_cpu >= 0)
+			return new_cpu;
+
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
 			want_affine = 1;
 		new_cpu = prev_cpu;
@@ -1844,6 +2165,9 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	/* latency nice moves the entities, see sched_set_latency_nice() */
+	vdiff += se->latency_offset - curr->latency_offset;
+
 	if (vdiff <= 0)
 		return -1;
 
@@ -1897,6 +2221,16 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 		next_buddy_marked = 1;
 	}
 
+	/*
+	 * A latency sensitive task that does not get to preempt should
+	 * still run before the leftmost task if that is not too unfair.
+	 */
+	if (pse->latency_offset > 0 && !next_buddy_marked &&
+	    !(wake_flags & WF_FORK)) {
+		set_next_buddy(pse);
+		next_buddy_marked = 1;
+	}
+
 	/*
 	 * We can come here with TIF_NEED_RESCHED already set from new task
 	 * wake up path.
@@ -3346,6 +3680,11 @@ static int load_balance(int this_cpu, struct rq *this_rq,
 
 	schedstat_inc(sd, lb_count[idle]);
 
+	if (idle != CPU_NOT_IDLE && pack_keep_idle(this_cpu, sd)) {
+		schedstat_inc(this_rq, pack_lb_skipped);
+		goto out_balanced;
+	}
+
 redo:
 	group = find_busiest_group(sd, this_cpu, &imbalance, idle,
 				   cpus, balance);
@@ -4030,6 +4369,10 @@ static inline int nohz_kick_needed(struct rq *rq, int cpu)
 	if (rq->idle_at_tick)
 		return 0;
 
+	/* the idle cpus are being kept idle on purpose */
+	if (pack_no_kick())
+		return 0;
+
 	first_pick_cpu = atomic_read(&nohz.first_pick_cpu);
 	second_pick_cpu = atomic_read(&nohz.second_pick_cpu);
 
@@ -4129,6 +4472,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	tick_task_util(rq, curr);
 }
 
 /*
@@ -4171,6 +4516,14 @@ static void task_fork_fair(struct task_struct *p)
 
 	se->vruntime -= cfs_rq->min_vruntime;
 
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	/*
+	 * Start with an empty history rather than a fully decayed one, so
+	 * a new task's utilization follows whatever it does first.
+	 */
+	se->avg.last_update = rq->clock_task;
+#endif
+
 	raw_spin_unlock_irqrestore(&rq->lock, flags);
 }
 
@@ -4313,6 +4666,9 @@ static const struct sched_class fair_sched_class = {
 	.rq_offline		= rq_offline_fair,
 
 	.task_waking		= task_waking_fair,
+#ifdef CONFIG_SCHED_UTIL_TRACKING
+	.migrate_task_rq	= migrate_task_rq_fair,
+#endif
 #endif
 
 	.set_curr_task          = set_curr_task_fair,
@@ -959,6 +959,9 @@ static void dequeue_task_rt(struct rq *rq, struct task_struct *p, int flags)
 	dequeue_rt_entity(rt_se);
 
 	dequeue_pushable_task(rq, p);
+
+	if (!rq->rt.rt_nr_running)
+		cpufreq_sched_update_rt(cpu_of(rq), false);
 }
 
 /*
@@ -1779,6 +1782,7 @@ static void watchdog(struct rq *rq, struct task_struct *p)
 static void task_tick_rt(struct rq *rq, struct task_struct *p, int queued)
 {
 	update_curr_rt(rq);
+	cpufreq_sched_update_rt(cpu_of(rq), true);
 
 	watchdog(rq, p);
 
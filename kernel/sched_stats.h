@@ -148,6 +148,121 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 # define schedstat_set(var, val)	do { } while (0)
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/* lower bound of every bucket */
+static void sched_hist_show_buckets(struct seq_file *m)
+{
+	int i;
+
+	seq_printf(m, "ns 0");
+	for (i = 1; i < SCHED_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", 1U << (i + 9));
+	seq_printf(m, "\n");
+}
+
+static void sched_hist_show(struct seq_file *m, const char *prefix,
+			    struct sched_latency_hist *h)
+{
+	int i;
+
+	seq_printf(m, "%swakeup", prefix);
+	for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", h->wakeup[i]);
+	seq_printf(m, "\n%srunq", prefix);
+	for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", h->runq[i]);
+	seq_printf(m, "\n");
+}
+
+static int show_sched_latency(struct seq_file *m, void *v)
+{
+	char prefix[16];
+	int cpu;
+
+	sched_hist_show_buckets(m);
+	for_each_online_cpu(cpu) {
+		snprintf(prefix, sizeof(prefix), "cpu%d ", cpu);
+		sched_hist_show(m, prefix, &cpu_rq(cpu)->lat_hist);
+	}
+	return 0;
+}
+
+static int sched_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_sched_latency, NULL);
+}
+
+static const struct file_operations proc_sched_latency_operations = {
+	.open    = sched_latency_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init proc_sched_latency_init(void)
+{
+	proc_create("sched_latency", 0, NULL, &proc_sched_latency_operations);
+	return 0;
+}
+module_init(proc_sched_latency_init);
+
+static inline void
+__sched_hist_add(struct sched_latency_hist *h, int bucket, int wakeup)
+{
+	h->runq[bucket]++;
+	if (wakeup)
+		h->wakeup[bucket]++;
+}
+
+/*
+ * Expects runqueue lock to be held, and to run on the cpu of the
+ * runqueue so the per cpu group histograms need no atomics.
+ */
+static inline void
+sched_hist_arrive(struct task_struct *t, unsigned long long delta)
+{
+	struct rq *rq = task_rq(t);
+	int wakeup = t->sched_info.hist_wakeup;
+	int bucket;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+#endif
+
+	delta += t->sched_info.hist_delay;
+	t->sched_info.hist_delay = 0;
+	t->sched_info.hist_wakeup = 0;
+
+	bucket = min_t(int, fls64(delta >> 10), SCHED_HIST_BUCKETS - 1);
+	__sched_hist_add(&rq->lat_hist, bucket, wakeup);
+#ifdef CONFIG_CGROUP_SCHED
+	for (tg = task_group(t); tg->lat_hist; tg = tg->parent)
+		__sched_hist_add(per_cpu_ptr(tg->lat_hist, cpu_of(rq)),
+				 bucket, wakeup);
+#endif
+}
+
+/* a migrating task takes the wait it had so far along */
+static inline void
+sched_hist_dequeued(struct task_struct *t, unsigned long long delta)
+{
+	t->sched_info.hist_delay += delta;
+}
+
+static inline void sched_info_woken(struct task_struct *t)
+{
+	t->sched_info.hist_wakeup = 1;
+}
+#else
+static inline void
+sched_hist_arrive(struct task_struct *t, unsigned long long delta)
+{}
+static inline void
+sched_hist_dequeued(struct task_struct *t, unsigned long long delta)
+{}
+static inline void sched_info_woken(struct task_struct *t)
+{}
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 static inline void sched_info_reset_dequeued(struct task_struct *t)
 {
@@ -171,6 +286,7 @@ static inline void sched_info_dequeued(struct task_struct *t)
 	t->sched_info.run_delay += delta;
 
 	rq_sched_info_dequeued(task_rq(t), delta);
+	sched_hist_dequeued(t, delta);
 }
 
 /*
@@ -190,6 +306,7 @@ static void sched_info_arrive(struct task_struct *t)
 	t->sched_info.pcount++;
 
 	rq_sched_info_arrive(task_rq(t), delta);
+	sched_hist_arrive(t, delta);
 }
 
 /*
@@ -0,0 +1,1466 @@
+/*
+ * govreplay -- replay recorded per-CPU load traces through the
+ * decision logic of the cpufreq governors and report the resulting
+ * frequency residency, estimated energy and missed deadlines.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The governors' sampling functions are transcribed from
+ * drivers/cpufreq/ with their default tunables.  Everything the kernel
+ * versions get from the rest of the system (idle time, the run queue
+ * length, the frequency table, hotplug) is provided by a simple model
+ * of an OMAP4 MPU: the OPP table from arch/arm/mach-omap2/opp4xxx_data.c
+ * shared by all CPUs, a fixed simulation tick, and FIFO jobs built from
+ * the trace.  When the transcribed code changes in the kernel, the
+ * matching function here has to follow.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+typedef unsigned long long u64;
+
+#define MAX_CPUS		4
+#define MAX_JOBS		1024
+
+#define USEC_PER_MSEC		1000ULL
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+
+#define CPUFREQ_RELATION_L	0	/* lowest frequency at or above target */
+#define CPUFREQ_RELATION_H	1	/* highest frequency at or below target */
+
+struct opp {
+	unsigned int freq;	/* kHz */
+	unsigned int volt;	/* uV */
+};
+
+/* MPU OPPs of the OMAP4430, enabled by default */
+static struct opp omap4430_opps[] = {
+	{  300000,  925000 },	/* OPP50 */
+	{  600000, 1100000 },	/* OPP100 */
+	{  800000, 1213000 },	/* OPPTURBO */
+	{ 1008000, 1274000 },	/* OPPNITRO */
+};
+
+/* ... and with CONFIG_OMAP4430_TOP_CPU */
+static struct opp omap4430_top_opps[] = {
+	{  300000,  925000 },	/* OPP50 */
+	{  600000, 1100000 },	/* OPP100 */
+	{  800000, 1213000 },	/* OPPTURBO */
+	{ 1008000, 1274000 },	/* OPPNITRO */
+	{ 1200000, 1325000 },	/* OPPNITRO2 */
+	{ 1350000, 1360000 },	/* OPPNITROSB */
+	{ 1420000, 1375000 },	/* OPPNITROSB2 */
+	{ 1480000, 1410000 },	/* OPPSUPERSB */
+};
+
+static struct opp *opps = omap4430_opps;
+static int nr_opps = sizeof(omap4430_opps) / sizeof(omap4430_opps[0]);
+static int top_cpu;		/* set with -T */
+static int reverse_table;	/* set with -r */
+
+/*
+ * The frequency table as a cpufreq driver would hand it to the
+ * governors.  omap2plus-cpufreq builds it in ascending order; -r
+ * reverses it, which is what governors written for Exynos expect.
+ */
+static unsigned int freq_table[16];
+
+struct policy {
+	unsigned int min;
+	unsigned int max;
+	unsigned int cur;
+};
+
+static struct policy policy;
+
+struct job {
+	u64 cycles;		/* still to run */
+	u64 deadline;		/* us */
+	int missed;
+};
+
+/* One runnable thread per trace column, fed by the trace. */
+struct thread {
+	struct job jobs[MAX_JOBS];
+	int head;
+	int nr;
+};
+
+struct cpu {
+	int online;
+	u64 idle_us;		/* what get_cpu_idle_time_us() would report */
+	u64 busy_frac_us;	/* busy time within the current tick */
+	u64 online_us;
+};
+
+static struct thread threads[MAX_CPUS];
+static struct cpu cpus[MAX_CPUS];
+static int nr_cpus;
+static u64 now;			/* us */
+
+static unsigned int tick_us = 1000;		/* set with -t */
+static unsigned int deadline_us;		/* set with -d */
+static double ceff_pf = 350.0;			/* set with -c */
+static double leak_ma = 30.0;			/* set with -l */
+static int verbose;				/* set with -v */
+
+/* results */
+static u64 opp_residency_us[16];
+static u64 online_residency_us[MAX_CPUS + 1];
+static double energy_dyn_uj;
+static double energy_leak_uj;
+static unsigned int nr_transitions;
+static unsigned int nr_hotplugs;
+static unsigned long nr_jobs;
+static unsigned long nr_missed;
+static u64 max_lateness_us;
+
+/*
+ * Run queue average, as rq_work_fn() in pegasusq and lulzactiveq
+ * computes it: nr_running() * 100 sampled every RQ_AVG_TIMER_RATE ms
+ * and averaged over time until the governor reads and clears it.
+ */
+#define RQ_AVG_TIMER_RATE	10
+
+static struct {
+	u64 nr_run_avg;
+	u64 total_time;
+	u64 last_time;
+	u64 next;
+} rq_data;
+
+static int nr_running(void)
+{
+	int i, nr = 0;
+
+	for (i = 0; i < nr_cpus; i++)
+		nr += threads[i].nr;
+	return nr;
+}
+
+static void rq_work_fn(void)
+{
+	u64 nr_run, time_diff;
+
+	if (rq_data.last_time == 0)
+		rq_data.last_time = now;
+	if (rq_data.nr_run_avg == 0)
+		rq_data.total_time = 0;
+
+	nr_run = nr_running() * 100;
+	time_diff = (now - rq_data.last_time) / USEC_PER_MSEC;
+
+	if (time_diff != 0 && rq_data.total_time != 0) {
+		nr_run = (nr_run * time_diff) +
+			(rq_data.nr_run_avg * rq_data.total_time);
+		nr_run /= rq_data.total_time + time_diff;
+	}
+	rq_data.nr_run_avg = nr_run;
+	rq_data.total_time += time_diff;
+	rq_data.last_time = now;
+}
+
+static unsigned int get_nr_run_avg(void)
+{
+	unsigned int nr_run_avg = rq_data.nr_run_avg;
+
+	rq_data.nr_run_avg = 0;
+	return nr_run_avg;
+}
+
+static u64 get_cpu_idle_time_us(int cpu, u64 *wall)
+{
+	if (wall)
+		*wall = now;
+	return cpus[cpu].idle_us;
+}
+
+static int num_online_cpus(void)
+{
+	int i, online = 0;
+
+	for (i = 0; i < nr_cpus; i++)
+		online += cpus[i].online;
+	return online;
+}
+
+static void cpu_up(int cpu)
+{
+	if (cpus[cpu].online)
+		return;
+	cpus[cpu].online = 1;
+	nr_hotplugs++;
+	if (verbose)
+		printf("%10llu: cpu%d up\n", now, cpu);
+}
+
+static void cpu_down(int cpu)
+{
+	if (!cpus[cpu].online || cpu == 0)
+		return;
+	cpus[cpu].online = 0;
+	nr_hotplugs++;
+	if (verbose)
+		printf("%10llu: cpu%d down\n", now, cpu);
+}
+
+/* cpufreq_frequency_table_target() restricted to the policy limits */
+static int freq_table_target(unsigned int target, int relation,
+			     unsigned int *index)
+{
+	int i, optimal = -1, suboptimal = -1;
+
+	for (i = 0; i < nr_opps; i++) {
+		unsigned int freq = freq_table[i];
+
+		if (freq < policy.min || freq > policy.max)
+			continue;
+		if (relation == CPUFREQ_RELATION_H) {
+			if (freq <= target) {
+				if (optimal < 0 || freq >= freq_table[optimal])
+					optimal = i;
+			} else if (suboptimal < 0 ||
+				   freq <= freq_table[suboptimal]) {
+				suboptimal = i;
+			}
+		} else {
+			if (freq >= target) {
+				if (optimal < 0 || freq <= freq_table[optimal])
+					optimal = i;
+			} else if (suboptimal < 0 ||
+				   freq >= freq_table[suboptimal]) {
+				suboptimal = i;
+			}
+		}
+	}
+	if (optimal < 0)
+		optimal = suboptimal;
+	if (optimal < 0)
+		return -1;
+	*index = optimal;
+	return 0;
+}
+
+/* __cpufreq_driver_target() */
+static void driver_target(unsigned int target, int relation)
+{
+	unsigned int index;
+
+	if (target > policy.max)
+		target = policy.max;
+	if (target < policy.min)
+		target = policy.min;
+	if (freq_table_target(target, relation, &index))
+		return;
+	if (freq_table[index] == policy.cur)
+		return;
+	if (verbose)
+		printf("%10llu: %u -> %u kHz\n", now, policy.cur,
+		       freq_table[index]);
+	policy.cur = freq_table[index];
+	nr_transitions++;
+}
+
+/*
+ * interactive -- cpufreq_interactive_timer() and the up/down workers
+ */
+static unsigned int go_hispeed_load;
+static unsigned int hispeed_freq;
+static u64 min_sample_time;
+static u64 timer_rate = 20 * USEC_PER_MSEC;
+static u64 above_hispeed_delay_val = 20 * USEC_PER_MSEC;
+static int boost_val;
+
+struct interactive_cpuinfo {
+	u64 time_in_idle;
+	u64 idle_exit_time;
+	u64 timer_run_time;
+	u64 target_set_time;
+	u64 target_set_time_in_idle;
+	u64 hispeed_validate_time;
+	u64 floor_validate_time;
+	unsigned int target_freq;
+	unsigned int floor_freq;
+};
+
+static struct interactive_cpuinfo icpu[MAX_CPUS];
+static u64 interactive_next;
+
+static void interactive_start(void)
+{
+	int i;
+
+	go_hispeed_load = top_cpu ? 85 : 95;
+	min_sample_time = (top_cpu ? 30 : 80) * USEC_PER_MSEC;
+	hispeed_freq = policy.max;
+
+	for (i = 0; i < nr_cpus; i++) {
+		struct interactive_cpuinfo *pcpu = &icpu[i];
+
+		pcpu->target_freq = policy.cur;
+		pcpu->floor_freq = pcpu->target_freq;
+		pcpu->floor_validate_time = now;
+		pcpu->hispeed_validate_time = now;
+		pcpu->target_set_time_in_idle =
+			get_cpu_idle_time_us(i, &pcpu->target_set_time);
+		pcpu->time_in_idle =
+			get_cpu_idle_time_us(i, &pcpu->idle_exit_time);
+	}
+	interactive_next = now + timer_rate;
+}
+
+/* returns 1 if the CPU's target changed */
+static int cpufreq_interactive_timer(int cpu)
+{
+	struct interactive_cpuinfo *pcpu = &icpu[cpu];
+	unsigned int delta_idle, delta_time;
+	int cpu_load, load_since_change;
+	unsigned int new_freq, index;
+	u64 now_idle;
+	int changed = 0;
+
+	now_idle = get_cpu_idle_time_us(cpu, &pcpu->timer_run_time);
+
+	delta_idle = now_idle - pcpu->time_in_idle;
+	delta_time = pcpu->timer_run_time - pcpu->idle_exit_time;
+
+	if (delta_time < 1000)
+		goto rearm;
+
+	if (delta_idle > delta_time)
+		cpu_load = 0;
+	else
+		cpu_load = 100 * (delta_time - delta_idle) / delta_time;
+
+	delta_idle = now_idle - pcpu->target_set_time_in_idle;
+	delta_time = pcpu->timer_run_time - pcpu->target_set_time;
+
+	if ((delta_time == 0) || (delta_idle > delta_time))
+		load_since_change = 0;
+	else
+		load_since_change =
+			100 * (delta_time - delta_idle) / delta_time;
+
+	if (load_since_change > cpu_load)
+		cpu_load = load_since_change;
+
+	if (cpu_load >= go_hispeed_load || boost_val) {
+		if (pcpu->target_freq <= policy.min) {
+			new_freq = hispeed_freq;
+		} else {
+			new_freq = policy.max * cpu_load / 100;
+
+			if (new_freq < hispeed_freq)
+				new_freq = hispeed_freq;
+
+			if (pcpu->target_freq == hispeed_freq &&
+			    new_freq > hispeed_freq &&
+			    pcpu->timer_run_time - pcpu->hispeed_validate_time
+			    < above_hispeed_delay_val)
+				goto rearm;
+		}
+	} else {
+		new_freq = policy.cur * cpu_load / 100;
+	}
+
+	if (new_freq <= hispeed_freq)
+		pcpu->hispeed_validate_time = pcpu->timer_run_time;
+
+	if (freq_table_target(new_freq, CPUFREQ_RELATION_H, &index))
+		goto rearm;
+
+	new_freq = freq_table[index];
+
+	if (new_freq < pcpu->floor_freq) {
+		if (pcpu->timer_run_time - pcpu->floor_validate_time
+		    < min_sample_time)
+			goto rearm;
+	}
+
+	pcpu->floor_freq = new_freq;
+	pcpu->floor_validate_time = pcpu->timer_run_time;
+
+	if (pcpu->target_freq == new_freq)
+		goto rearm;
+
+	pcpu->target_set_time_in_idle = now_idle;
+	pcpu->target_set_time = pcpu->timer_run_time;
+	pcpu->target_freq = new_freq;
+	changed = 1;
+
+rearm:
+	/*
+	 * The kernel parks the timer at max speed until the next idle
+	 * exit; with the load model here that is at most a tick away, so
+	 * just rearm.
+	 */
+	pcpu->time_in_idle = get_cpu_idle_time_us(cpu, &pcpu->idle_exit_time);
+	return changed;
+}
+
+static void interactive_tick(void)
+{
+	unsigned int max_freq = 0;
+	int i, changed = 0;
+
+	if (now < interactive_next)
+		return;
+	interactive_next = now + timer_rate;
+
+	for (i = 0; i < nr_cpus; i++)
+		changed |= cpufreq_interactive_timer(i);
+	if (!changed)
+		return;
+
+	/* cpufreq_interactive_up_task() / cpufreq_interactive_freq_down() */
+	for (i = 0; i < nr_cpus; i++)
+		max_freq = max(max_freq, icpu[i].target_freq);
+	if (max_freq != policy.cur)
+		driver_target(max_freq, CPUFREQ_RELATION_H);
+}
+
+/*
+ * pegasusq -- pq_check_cpu(), check_up() and check_down()
+ */
+#define MAX_HOTPLUG_RATE		40
+#define DEF_FREQ_STEP_DEC		13
+#define DEF_UP_THRESHOLD_DIFF		5
+
+#define HOTPLUG_DOWN_INDEX		0
+#define HOTPLUG_UP_INDEX		1
+
+struct cpu_usage {
+	unsigned int freq;
+	unsigned int avg_load;
+	int rq_avg;
+};
+
+static struct {
+	struct cpu_usage usage[MAX_HOTPLUG_RATE];
+	int num_hist;
+} hotplug_history;
+
+static struct {
+	unsigned int sampling_rate;
+	unsigned int up_threshold;
+	unsigned int down_differential;
+	unsigned int sampling_down_factor;
+	unsigned int freq_step;
+	unsigned int cpu_up_rate;
+	unsigned int cpu_down_rate;
+	unsigned int up_nr_cpus;
+	unsigned int up_threshold_at_min_freq;
+	unsigned int freq_for_responsiveness;
+} pq_tuners = {
+	.sampling_rate = 40000,
+	.up_threshold = 80,
+	.down_differential = 5,
+	.sampling_down_factor = 2,
+	.freq_step = 40,
+	.cpu_up_rate = 10,
+	.cpu_down_rate = 20,
+	.up_nr_cpus = 1,
+	.up_threshold_at_min_freq = 40,
+	.freq_for_responsiveness = 300000,
+};
+
+static int pq_hotplug_rq[4][2] = {
+	{0, 200}, {150, 250}, {300, 350}, {400, 0}
+};
+
+static int pq_hotplug_freq[4][2] = {
+	{0,       600000},
+	{400000,  800000},
+	{600000, 1000008},
+	{800000, 0}
+};
+
+static u64 prev_cpu_idle[MAX_CPUS];
+static u64 prev_cpu_wall[MAX_CPUS];
+static unsigned int rate_mult;
+static u64 pq_next;
+
+/* cpu_up_work() and cpu_down_work() without hotplug locks */
+static void hotplug_up(unsigned int nr_up)
+{
+	int cpu;
+
+	if (num_online_cpus() == 1) {
+		cpu_up(nr_cpus - 1);
+		nr_up -= 1;
+	}
+	for (cpu = 1; cpu < nr_cpus && nr_up; cpu++) {
+		if (cpus[cpu].online)
+			continue;
+		cpu_up(cpu);
+		nr_up--;
+	}
+}
+
+static void hotplug_down(void)
+{
+	int cpu;
+
+	for (cpu = 1; cpu < nr_cpus; cpu++) {
+		if (cpus[cpu].online) {
+			cpu_down(cpu);
+			break;
+		}
+	}
+}
+
+static int pq_check_up(void)
+{
+	int num_hist = hotplug_history.num_hist;
+	struct cpu_usage *usage;
+	int i;
+	int up_rate = pq_tuners.cpu_up_rate;
+	int up_freq, up_rq;
+	int min_freq = INT_MAX;
+	int min_rq_avg = INT_MAX;
+	int min_avg_load = INT_MAX;
+	int online = num_online_cpus();
+
+	up_freq = pq_hotplug_freq[online - 1][HOTPLUG_UP_INDEX];
+	up_rq = pq_hotplug_rq[online - 1][HOTPLUG_UP_INDEX];
+
+	if (online == nr_cpus)
+		return 0;
+
+	if (num_hist == 0 || num_hist % up_rate)
+		return 0;
+
+	for (i = num_hist - 1; i >= num_hist - up_rate; --i) {
+		usage = &hotplug_history.usage[i];
+
+		min_freq = min(min_freq, (int)usage->freq);
+		min_rq_avg = min(min_rq_avg, usage->rq_avg);
+		min_avg_load = min(min_avg_load, (int)usage->avg_load);
+	}
+
+	if (min_freq >= up_freq && min_rq_avg > up_rq) {
+		if (online >= 2) {
+			if (min_avg_load < 65)
+				return 0;
+		}
+		hotplug_history.num_hist = 0;
+		return 1;
+	}
+	return 0;
+}
+
+static int pq_check_down(void)
+{
+	int num_hist = hotplug_history.num_hist;
+	struct cpu_usage *usage;
+	int i;
+	int down_rate = pq_tuners.cpu_down_rate;
+	int down_freq, down_rq;
+	int max_freq = 0;
+	int max_rq_avg = 0;
+	int max_avg_load = 0;
+	int online = num_online_cpus();
+
+	down_freq = pq_hotplug_freq[online - 1][HOTPLUG_DOWN_INDEX];
+	down_rq = pq_hotplug_rq[online - 1][HOTPLUG_DOWN_INDEX];
+
+	if (online == 1)
+		return 0;
+
+	if (num_hist == 0 || num_hist % down_rate)
+		return 0;
+
+	for (i = num_hist - 1; i >= num_hist - down_rate; --i) {
+		usage = &hotplug_history.usage[i];
+
+		max_freq = max(max_freq, (int)usage->freq);
+		max_rq_avg = max(max_rq_avg, usage->rq_avg);
+		max_avg_load = max(max_avg_load, (int)usage->avg_load);
+	}
+
+	if ((max_freq <= down_freq && max_rq_avg <= down_rq)
+		|| (online >= 3 && max_avg_load < 30)) {
+		hotplug_history.num_hist = 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* dbs_check_cpu() from cpufreq_governor.c, for the online CPUs */
+static unsigned int cpu_load(int cpu)
+{
+	u64 cur_wall_time, cur_idle_time;
+	unsigned int wall_time, idle_time;
+
+	cur_idle_time = get_cpu_idle_time_us(cpu, &cur_wall_time);
+
+	wall_time = cur_wall_time - prev_cpu_wall[cpu];
+	prev_cpu_wall[cpu] = cur_wall_time;
+	idle_time = cur_idle_time - prev_cpu_idle[cpu];
+	prev_cpu_idle[cpu] = cur_idle_time;
+
+	if (!wall_time || wall_time < idle_time)
+		return 0;
+	return 100 * (wall_time - idle_time) / wall_time;
+}
+
+static void pegasusq_start(void)
+{
+	int i;
+
+	for (i = 0; i < nr_cpus; i++)
+		prev_cpu_idle[i] = get_cpu_idle_time_us(i, &prev_cpu_wall[i]);
+	hotplug_history.num_hist = 0;
+	rate_mult = 1;
+	pq_next = now + pq_tuners.sampling_rate;
+}
+
+static void pq_check_cpu(void)
+{
+	unsigned int max_load_freq;
+	int num_hist = hotplug_history.num_hist;
+	int max_hotplug_rate = max(pq_tuners.cpu_up_rate,
+				   pq_tuners.cpu_down_rate);
+	int up_threshold;
+	unsigned int total_load = 0;
+	int j;
+
+	hotplug_history.usage[num_hist].freq = policy.cur;
+	hotplug_history.usage[num_hist].rq_avg = get_nr_run_avg();
+	++hotplug_history.num_hist;
+
+	max_load_freq = 0;
+	for (j = 0; j < nr_cpus; j++) {
+		unsigned int load, load_freq;
+
+		if (!cpus[j].online)
+			continue;
+		load = cpu_load(j);
+		total_load += load;
+		load_freq = load * policy.cur;
+		if (load_freq > max_load_freq)
+			max_load_freq = load_freq;
+	}
+	hotplug_history.usage[num_hist].avg_load =
+		total_load / num_online_cpus();
+
+	if (pq_check_up())
+		hotplug_up(pq_tuners.up_nr_cpus);
+	else if (pq_check_down())
+		hotplug_down();
+	if (hotplug_history.num_hist == max_hotplug_rate)
+		hotplug_history.num_hist = 0;
+
+	if (policy.cur < pq_tuners.freq_for_responsiveness)
+		up_threshold = pq_tuners.up_threshold_at_min_freq;
+	else
+		up_threshold = pq_tuners.up_threshold;
+
+	if (max_load_freq > up_threshold * policy.cur) {
+		int inc = policy.max * (pq_tuners.freq_step
+					- DEF_FREQ_STEP_DEC * 2) / 100;
+		int target;
+
+		if (max_load_freq > (up_threshold + DEF_UP_THRESHOLD_DIFF * 2)
+			* policy.cur)
+			inc = policy.max * pq_tuners.freq_step / 100;
+		else if (max_load_freq > (up_threshold + DEF_UP_THRESHOLD_DIFF)
+			* policy.cur)
+			inc = policy.max * (pq_tuners.freq_step
+					- DEF_FREQ_STEP_DEC) / 100;
+
+		target = min(policy.max, policy.cur + inc);
+
+		if (policy.cur < policy.max && target == policy.max)
+			rate_mult = pq_tuners.sampling_down_factor;
+		/* dbs_freq_increase() */
+		if (policy.cur != policy.max)
+			driver_target(target, CPUFREQ_RELATION_L);
+		return;
+	}
+
+	if (policy.cur == policy.min)
+		return;
+
+	if (max_load_freq <
+	    (pq_tuners.up_threshold - pq_tuners.down_differential) *
+	    policy.cur) {
+		unsigned int freq_next;
+		unsigned int down_thres;
+
+		freq_next = max_load_freq /
+			(pq_tuners.up_threshold -
+			 pq_tuners.down_differential);
+
+		rate_mult = 1;
+
+		if (freq_next < policy.min)
+			freq_next = policy.min;
+
+		down_thres = pq_tuners.up_threshold_at_min_freq
+			- pq_tuners.down_differential;
+
+		if (freq_next < pq_tuners.freq_for_responsiveness
+			&& (max_load_freq / freq_next) > down_thres)
+			freq_next = pq_tuners.freq_for_responsiveness;
+
+		if (policy.cur == freq_next)
+			return;
+
+		driver_target(freq_next, CPUFREQ_RELATION_L);
+	}
+}
+
+static void pegasusq_tick(void)
+{
+	if (now < pq_next)
+		return;
+	pq_check_cpu();
+	pq_next = now + (u64)pq_tuners.sampling_rate * rate_mult;
+}
+
+/*
+ * lulzactiveq -- cpufreq_lulzactive_timer() and its hotplug sampling
+ */
+static unsigned long up_sample_time = 40 * USEC_PER_MSEC;
+static unsigned long down_sample_time = 20 * USEC_PER_MSEC;
+static unsigned long inc_cpu_load = 80;
+static unsigned long dec_cpu_load = 60;
+static unsigned long pump_up_step = 2;
+static unsigned long pump_down_step = 1;
+static unsigned long lulz_timer_rate = 20 * USEC_PER_MSEC;
+
+static struct {
+	unsigned int hotplug_sampling_rate;
+	unsigned int cpu_up_rate;
+	unsigned int cpu_down_rate;
+	unsigned int up_nr_cpus;
+} lq_tuners = {
+	.hotplug_sampling_rate = 40000,
+	.cpu_up_rate = 13,
+	.cpu_down_rate = 13,
+	.up_nr_cpus = 1,
+};
+
+static int lq_hotplug_rq[4][2] = {
+	{0, 350}, {290, 350}, {290, 400}, {350, 0}
+};
+
+static int lq_hotplug_freq[4][2] = {
+	{0, 600000},
+	{400000, 700000},
+	{500000, 800000},
+	{600000, 0}
+};
+
+struct lulzactive_cpuinfo {
+	u64 time_in_idle;
+	u64 idle_exit_time;
+	u64 timer_run_time;
+	u64 freq_change_time;
+	u64 freq_change_time_in_idle;
+	u64 freq_change_up_time;
+	u64 freq_change_down_time;
+	unsigned int target_freq;
+};
+
+static struct lulzactive_cpuinfo lcpu[MAX_CPUS];
+static u64 lulz_next, lq_hotplug_next;
+static unsigned int lulz_index_clamped;
+
+static void lulzactiveq_start(void)
+{
+	int i;
+
+	for (i = 0; i < nr_cpus; i++) {
+		struct lulzactive_cpuinfo *pcpu = &lcpu[i];
+
+		pcpu->target_freq = policy.cur;
+		pcpu->freq_change_time_in_idle =
+			get_cpu_idle_time_us(i, &pcpu->freq_change_time);
+		pcpu->freq_change_up_time = pcpu->freq_change_time;
+		pcpu->freq_change_down_time = pcpu->freq_change_time;
+		pcpu->time_in_idle =
+			get_cpu_idle_time_us(i, &pcpu->idle_exit_time);
+	}
+	hispeed_freq = policy.max;
+	hotplug_history.num_hist = 0;
+	lulz_next = now + lulz_timer_rate;
+	lq_hotplug_next = now + lq_tuners.hotplug_sampling_rate;
+}
+
+/*
+ * The kernel keeps the table index in an unsigned int, so pumping past
+ * either end of the table reads outside it.  Clamp instead and count
+ * how often that happened.
+ */
+static unsigned int lulz_pump(unsigned int index, long step)
+{
+	long i = (long)index + step;
+
+	if (i < 0 || i >= nr_opps) {
+		lulz_index_clamped++;
+		i = i < 0 ? 0 : nr_opps - 1;
+	}
+	return i;
+}
+
+/* returns 1 for a raised target, -1 for a lowered one */
+static int cpufreq_lulzactive_timer(int cpu)
+{
+	struct lulzactive_cpuinfo *pcpu = &lcpu[cpu];
+	unsigned int delta_idle, delta_time;
+	int cpu_load, load_since_change;
+	unsigned int new_freq, index;
+	u64 now_idle;
+	int ret = 0;
+
+	if (dec_cpu_load > inc_cpu_load)
+		dec_cpu_load = inc_cpu_load;
+
+	now_idle = get_cpu_idle_time_us(cpu, &pcpu->timer_run_time);
+
+	delta_idle = now_idle - pcpu->time_in_idle;
+	delta_time = pcpu->timer_run_time - pcpu->idle_exit_time;
+
+	if (delta_time < 1000)
+		goto rearm;
+
+	if (delta_idle > delta_time)
+		cpu_load = 0;
+	else
+		cpu_load = 100 * (delta_time - delta_idle) / delta_time;
+
+	delta_idle = now_idle - pcpu->freq_change_time_in_idle;
+	delta_time = pcpu->timer_run_time - pcpu->freq_change_time;
+
+	if ((delta_time == 0) || (delta_idle > delta_time))
+		load_since_change = 0;
+	else
+		load_since_change =
+			100 * (delta_time - delta_idle) / delta_time;
+
+	if (load_since_change > cpu_load)
+		cpu_load = load_since_change;
+
+	if (cpu_load >= inc_cpu_load) {
+		if (pump_up_step) {
+			if (policy.cur < policy.max) {
+				if (freq_table_target(policy.cur,
+						      CPUFREQ_RELATION_H,
+						      &index))
+					goto rearm;
+				index = lulz_pump(index, -(long)pump_up_step);
+				new_freq = freq_table[index];
+			} else {
+				new_freq = policy.max;
+			}
+		} else {
+			if (policy.cur == policy.min)
+				new_freq = hispeed_freq;
+			else
+				new_freq = policy.max * cpu_load / 100;
+		}
+	} else if (cpu_load <= dec_cpu_load) {
+		if (pump_down_step) {
+			if (freq_table_target(policy.cur, CPUFREQ_RELATION_H,
+					      &index))
+				goto rearm;
+			index = lulz_pump(index, pump_down_step);
+			new_freq = (policy.cur > policy.min) ?
+				freq_table[index] : policy.min;
+		} else {
+			new_freq = policy.cur * cpu_load / 100;
+		}
+	} else {
+		new_freq = policy.cur;
+		pcpu->freq_change_time_in_idle =
+			get_cpu_idle_time_us(cpu, &pcpu->freq_change_time);
+	}
+
+	if (freq_table_target(new_freq, CPUFREQ_RELATION_H, &index))
+		goto rearm;
+	new_freq = freq_table[index];
+
+	if (pcpu->target_freq == new_freq)
+		goto rearm;
+
+	if (new_freq < pcpu->target_freq) {
+		if (pcpu->timer_run_time - pcpu->freq_change_down_time
+		    < down_sample_time)
+			goto rearm;
+	} else {
+		if (pcpu->timer_run_time - pcpu->freq_change_up_time
+		    < up_sample_time)
+			goto rearm;
+	}
+
+	ret = new_freq < pcpu->target_freq ? -1 : 1;
+	pcpu->target_freq = new_freq;
+
+rearm:
+	pcpu->time_in_idle = get_cpu_idle_time_us(cpu, &pcpu->idle_exit_time);
+	return ret;
+}
+
+static int lq_check_up(void)
+{
+	int num_hist = hotplug_history.num_hist;
+	struct cpu_usage *usage;
+	int i;
+	int up_rate = lq_tuners.cpu_up_rate;
+	int up_freq, up_rq;
+	int avg_freq = 0, avg_rq = 0;
+	int online = num_online_cpus();
+
+	up_freq = lq_hotplug_freq[online - 1][HOTPLUG_UP_INDEX];
+	up_rq = lq_hotplug_rq[online - 1][HOTPLUG_UP_INDEX];
+
+	if (online == nr_cpus)
+		return 0;
+
+	if (num_hist % up_rate)
+		return 0;
+	if (num_hist == 0)
+		num_hist = MAX_HOTPLUG_RATE;
+
+	for (i = num_hist - 1; i >= num_hist - up_rate; --i) {
+		usage = &hotplug_history.usage[i];
+
+		avg_rq += usage->rq_avg;
+		avg_freq += usage->freq;
+	}
+	avg_rq /= up_rate;
+	avg_freq /= up_rate;
+
+	return avg_freq >= up_freq && avg_rq > up_rq;
+}
+
+static int lq_check_down(void)
+{
+	int num_hist = hotplug_history.num_hist;
+	struct cpu_usage *usage;
+	int i;
+	int down_rate = lq_tuners.cpu_down_rate;
+	int down_freq, down_rq;
+	int avg_freq = 0, avg_rq = 0;
+	int online = num_online_cpus();
+
+	down_freq = lq_hotplug_freq[online - 1][HOTPLUG_DOWN_INDEX];
+	down_rq = lq_hotplug_rq[online - 1][HOTPLUG_DOWN_INDEX];
+
+	if (online == 1)
+		return 0;
+
+	if (num_hist % down_rate)
+		return 0;
+	if (num_hist == 0)
+		num_hist = MAX_HOTPLUG_RATE;
+
+	for (i = num_hist - 1; i >= num_hist - down_rate; --i) {
+		usage = &hotplug_history.usage[i];
+
+		avg_rq += usage->rq_avg;
+		avg_freq += usage->freq;
+	}
+	avg_rq /= down_rate;
+	avg_freq /= down_rate;
+
+	return avg_freq <= down_freq && avg_rq <= down_rq;
+}
+
+static void lulzactiveq_tick(void)
+{
+	unsigned int max_freq = 0;
+	int i, changed = 0;
+
+	if (now >= lq_hotplug_next) {
+		int num_hist = hotplug_history.num_hist;
+
+		lq_hotplug_next = now + lq_tuners.hotplug_sampling_rate;
+
+		hotplug_history.usage[num_hist].freq = policy.cur;
+		hotplug_history.usage[num_hist].rq_avg = get_nr_run_avg();
+		++hotplug_history.num_hist;
+
+		if (lq_check_up())
+			hotplug_up(lq_tuners.up_nr_cpus);
+		else if (lq_check_down())
+			hotplug_down();
+		if (hotplug_history.num_hist == MAX_HOTPLUG_RATE)
+			hotplug_history.num_hist = 0;
+	}
+
+	if (now < lulz_next)
+		return;
+	lulz_next = now + lulz_timer_rate;
+
+	for (i = 0; i < nr_cpus; i++) {
+		int ret;
+
+		if (!cpus[i].online)
+			continue;
+		ret = cpufreq_lulzactive_timer(i);
+		if (ret)
+			changed = 1;
+		if (ret > 0)
+			lcpu[i].freq_change_up_time = now;
+		else if (ret < 0)
+			lcpu[i].freq_change_down_time = now;
+		if (ret)
+			lcpu[i].freq_change_time_in_idle =
+				get_cpu_idle_time_us(i,
+						&lcpu[i].freq_change_time);
+	}
+	if (!changed)
+		return;
+
+	/* cpufreq_lulzactive_up_task() / cpufreq_lulzactive_freq_down() */
+	for (i = 0; i < nr_cpus; i++)
+		if (cpus[i].online)
+			max_freq = max(max_freq, lcpu[i].target_freq);
+	if (max_freq != policy.cur)
+		driver_target(max_freq, CPUFREQ_RELATION_H);
+}
+
+/*
+ * performance and powersave, for reference
+ */
+static void performance_start(void)
+{
+	driver_target(policy.max, CPUFREQ_RELATION_H);
+}
+
+static void powersave_start(void)
+{
+	driver_target(policy.min, CPUFREQ_RELATION_L);
+}
+
+static void nop_tick(void)
+{
+}
+
+struct governor {
+	const char *name;
+	void (*start)(void);
+	void (*tick)(void);
+	int hotplug;		/* starts with only CPU0 online */
+};
+
+static struct governor governors[] = {
+	{ "interactive", interactive_start, interactive_tick, 0 },
+	{ "pegasusq", pegasusq_start, pegasusq_tick, 1 },
+	{ "lulzactiveq", lulzactiveq_start, lulzactiveq_tick, 1 },
+	{ "performance", performance_start, nop_tick, 0 },
+	{ "powersave", powersave_start, nop_tick, 0 },
+};
+
+#define NR_GOVERNORS	(sizeof(governors) / sizeof(governors[0]))
+
+/*
+ * The trace: one line per sample,
+ *
+ *	<time_us> <freq_khz> <load_cpu0> [<load_cpu1> ...]
+ *
+ * where load is the busy percentage of each CPU since the previous line
+ * at the frequency the CPU was running, i.e. what /proc/stat and
+ * scaling_cur_freq give when recorded on a device.  Lines starting
+ * with '#' are ignored.
+ */
+struct sample {
+	u64 time;
+	unsigned int freq;
+	unsigned int load[MAX_CPUS];
+};
+
+static struct sample *trace;
+static int nr_samples;
+
+static void read_trace(FILE *fp)
+{
+	char line[256];
+	int alloc = 0;
+	int lineno = 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		struct sample *s;
+		char *p = line, *end;
+		int n;
+
+		lineno++;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+
+		if (nr_samples == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			trace = realloc(trace, alloc * sizeof(*trace));
+			if (!trace) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		s = &trace[nr_samples];
+		memset(s, 0, sizeof(*s));
+
+		s->time = strtoull(p, &end, 0);
+		if (end == p)
+			goto bad;
+		p = end;
+		s->freq = strtoul(p, &end, 0);
+		if (end == p || !s->freq)
+			goto bad;
+		p = end;
+		for (n = 0; n < MAX_CPUS; n++) {
+			s->load[n] = strtoul(p, &end, 0);
+			if (end == p)
+				break;
+			if (s->load[n] > 100)
+				goto bad;
+			p = end;
+		}
+		if (!n)
+			goto bad;
+		if (!nr_cpus)
+			nr_cpus = n;
+		if (nr_samples && s->time <= trace[nr_samples - 1].time)
+			goto bad;
+		nr_samples++;
+		continue;
+bad:
+		fprintf(stderr, "trace line %d: malformed\n", lineno);
+		exit(1);
+	}
+	if (nr_samples < 2) {
+		fprintf(stderr, "trace needs at least two samples\n");
+		exit(1);
+	}
+}
+
+static void queue_job(struct thread *t, u64 cycles, u64 deadline)
+{
+	struct job *job;
+
+	if (!cycles)
+		return;
+	nr_jobs++;
+	if (t->nr == MAX_JOBS) {
+		/* hopelessly behind, fold into the newest job */
+		job = &t->jobs[(t->head + t->nr - 1) % MAX_JOBS];
+		job->cycles += cycles;
+		return;
+	}
+	job = &t->jobs[(t->head + t->nr) % MAX_JOBS];
+	job->cycles = cycles;
+	job->deadline = deadline;
+	job->missed = 0;
+	t->nr++;
+}
+
+/* Run a thread for up to @budget cycles, returns the cycles used. */
+static u64 run_thread(struct thread *t, u64 budget, u64 end)
+{
+	u64 used = 0;
+
+	while (t->nr && used < budget) {
+		struct job *job = &t->jobs[t->head];
+		u64 run = min(job->cycles, budget - used);
+
+		job->cycles -= run;
+		used += run;
+		if (job->cycles)
+			break;
+		if (end > job->deadline)
+			max_lateness_us = max(max_lateness_us,
+					      end - job->deadline);
+		t->head = (t->head + 1) % MAX_JOBS;
+		t->nr--;
+	}
+	return used;
+}
+
+/*
+ * Run the threads for one tick.  A thread runs on its own CPU, or on
+ * CPU0 while that is offline; a CPU shared by several threads splits
+ * its cycles evenly between them.
+ */
+static void run_tick(void)
+{
+	u64 capacity = (u64)policy.cur * tick_us / 1000;
+	int cpu, i;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		struct thread *runnable[MAX_CPUS];
+		u64 left = capacity;
+		int nr = 0, pass;
+
+		if (!cpus[cpu].online)
+			continue;
+		for (i = 0; i < nr_cpus; i++) {
+			int home = cpus[i].online ? i : 0;
+
+			if (home == cpu && threads[i].nr)
+				runnable[nr++] = &threads[i];
+		}
+		/* hand out what the shorter jobs leave over */
+		for (pass = 0; pass < nr && left; pass++) {
+			u64 share = left / nr ? left / nr : left;
+
+			for (i = 0; i < nr && left; i++)
+				left -= run_thread(runnable[i],
+						   min(share, left),
+						   now + tick_us);
+		}
+		cpus[cpu].busy_frac_us = (capacity - left) * tick_us / capacity;
+	}
+
+	for (i = 0; i < nr_cpus; i++) {
+		struct thread *t = &threads[i];
+		int j;
+
+		for (j = 0; j < t->nr; j++) {
+			struct job *job = &t->jobs[(t->head + j) % MAX_JOBS];
+
+			if (job->deadline > now + tick_us)
+				break;
+			if (!job->missed) {
+				job->missed = 1;
+				nr_missed++;
+			}
+		}
+	}
+}
+
+static int opp_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < nr_opps; i++)
+		if (opps[i].freq == freq)
+			return i;
+	return 0;
+}
+
+static void account_tick(void)
+{
+	struct opp *opp = &opps[opp_index(policy.cur)];
+	double volt = opp->volt / 1000000.0;
+	int cpu;
+
+	opp_residency_us[opp - opps] += tick_us;
+	online_residency_us[num_online_cpus()] += tick_us;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		struct cpu *c = &cpus[cpu];
+
+		if (!c->online) {
+			/* offline CPUs are power gated */
+			c->idle_us += tick_us;
+			continue;
+		}
+		c->online_us += tick_us;
+		c->idle_us += tick_us - c->busy_frac_us;
+
+		/* pF * V^2 * kHz * us = 1e-9 uJ */
+		energy_dyn_uj += ceff_pf * volt * volt * opp->freq *
+			c->busy_frac_us * 1e-9;
+		/* mA * V * us = 1e-3 uJ */
+		energy_leak_uj += leak_ma * volt * tick_us * 1e-3;
+		c->busy_frac_us = 0;
+	}
+}
+
+static void simulate(struct governor *gov)
+{
+	int i, s = 0;
+
+	memset(cpus, 0, sizeof(cpus));
+	memset(threads, 0, sizeof(threads));
+	memset(&rq_data, 0, sizeof(rq_data));
+	for (i = 0; i < nr_cpus; i++)
+		cpus[i].online = !gov->hotplug || i == 0;
+
+	policy.min = freq_table[0];
+	policy.max = freq_table[0];
+	for (i = 0; i < nr_opps; i++) {
+		policy.min = min(policy.min, freq_table[i]);
+		policy.max = max(policy.max, freq_table[i]);
+	}
+	policy.cur = policy.max;
+
+	now = trace[0].time;
+	gov->start();
+
+	while (now < trace[nr_samples - 1].time) {
+		/* release the work of every interval that starts now */
+		while (s < nr_samples - 1 && trace[s].time <= now) {
+			struct sample *cur = &trace[s];
+			u64 len = trace[s + 1].time - cur->time;
+			u64 deadline = cur->time + (deadline_us ? deadline_us : len);
+
+			for (i = 0; i < nr_cpus; i++)
+				queue_job(&threads[i],
+					  (u64)cur->load[i] * len * cur->freq /
+					  100000, deadline);
+			s++;
+		}
+
+		if (now >= rq_data.next) {
+			rq_work_fn();
+			rq_data.next = now + RQ_AVG_TIMER_RATE * USEC_PER_MSEC;
+		}
+
+		run_tick();
+		account_tick();
+		now += tick_us;
+		gov->tick();
+	}
+}
+
+static void report(struct governor *gov)
+{
+	u64 total = trace[nr_samples - 1].time - trace[0].time;
+	int i;
+
+	printf("%s:\n", gov->name);
+	for (i = 0; i < nr_opps; i++)
+		printf("  %7u kHz %7u uV %6.2f%%\n", opps[i].freq,
+		       opps[i].volt, 100.0 * opp_residency_us[i] / total);
+	for (i = 1; i <= nr_cpus; i++)
+		printf("  %d online %21.2f%%\n", i,
+		       100.0 * online_residency_us[i] / total);
+	printf("  energy %.1f mJ (dynamic %.1f mJ, leakage %.1f mJ)\n",
+	       (energy_dyn_uj + energy_leak_uj) / 1000,
+	       energy_dyn_uj / 1000, energy_leak_uj / 1000);
+	printf("  transitions %u, hotplugs %u\n", nr_transitions, nr_hotplugs);
+	printf("  missed deadlines %lu of %lu jobs, worst lateness %llu us\n",
+	       nr_missed, nr_jobs, max_lateness_us);
+	if (lulz_index_clamped)
+		printf("  table index clamped %u times\n", lulz_index_clamped);
+}
+
+static void reset_stats(void)
+{
+	memset(opp_residency_us, 0, sizeof(opp_residency_us));
+	memset(online_residency_us, 0, sizeof(online_residency_us));
+	energy_dyn_uj = energy_leak_uj = 0;
+	nr_transitions = nr_hotplugs = 0;
+	nr_jobs = nr_missed = 0;
+	max_lateness_us = 0;
+	lulz_index_clamped = 0;
+}
+
+static void usage(void)
+{
+	unsigned int i;
+
+	fprintf(stderr, "usage: govreplay [-Trv] [-g governor] [-n cpus] "
+		"[-t tick_us] [-d deadline_us]\n"
+		"                 [-c ceff_pf] [-l leak_ma] [trace]\n"
+		"governors:");
+	for (i = 0; i < NR_GOVERNORS; i++)
+		fprintf(stderr, " %s", governors[i].name);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *gov_name = NULL;
+	unsigned int i;
+	int opt, found = 0;
+	FILE *fp = stdin;
+
+	while ((opt = getopt(argc, argv, "Trvg:n:t:d:c:l:")) != -1) {
+		switch (opt) {
+		case 'T':
+			top_cpu = 1;
+			break;
+		case 'r':
+			reverse_table = 1;
+			break;
+		case 'v':
+			verbose++;
+			break;
+		case 'g':
+			gov_name = optarg;
+			break;
+		case 'n':
+			nr_cpus = atoi(optarg);
+			if (nr_cpus < 1 || nr_cpus > MAX_CPUS)
+				usage();
+			break;
+		case 't':
+			tick_us = atoi(optarg);
+			if (!tick_us)
+				usage();
+			break;
+		case 'd':
+			deadline_us = atoi(optarg);
+			break;
+		case 'c':
+			ceff_pf = atof(optarg);
+			break;
+		case 'l':
+			leak_ma = atof(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind < argc - 1)
+		usage();
+	if (optind == argc - 1) {
+		fp = fopen(argv[optind], "r");
+		if (!fp) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	if (top_cpu) {
+		opps = omap4430_top_opps;
+		nr_opps = sizeof(omap4430_top_opps) /
+			sizeof(omap4430_top_opps[0]);
+	}
+	for (i = 0; i < (unsigned int)nr_opps; i++)
+		freq_table[i] = opps[reverse_table ? nr_opps - 1 - i : i].freq;
+
+	read_trace(fp);
+	if (fp != stdin)
+		fclose(fp);
+
+	for (i = 0; i < NR_GOVERNORS; i++) {
+		if (gov_name && strcmp(gov_name, governors[i].name))
+			continue;
+		found = 1;
+		reset_stats();
+		simulate(&governors[i]);
+		report(&governors[i]);
+	}
+	if (!found)
+		usage();
+
+	return 0;
+}